@@ -6,7 +6,17 @@
 // :Copyright: © 2015-2026 Lele Gaifax
 //
 
+#include <errno.h>
 #include <locale.h>
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include <Python.h>
 #include <datetime.h>
@@ -14,9 +24,13 @@
 
 #include <algorithm>
 #include <cmath>
+#include <new>
 #include <string>
+#include <system_error>
+#include <thread>
 #include <vector>
 
+#include "rapidjson/memorystream.h"
 #include "rapidjson/reader.h"
 #include "rapidjson/schema.h"
 #include "rapidjson/stringbuffer.h"
@@ -47,9 +61,16 @@ static PyObject* decimal_type = NULL;
 static PyObject* timezone_type = NULL;
 static PyObject* timezone_utc = NULL;
 static PyObject* uuid_type = NULL;
+static PyObject* safe_uuid_unknown = NULL;
+static PyObject* fileio_type = NULL;
+static PyObject* buffered_io_base_type = NULL;
+static PyObject* raw_io_base_type = NULL;
 static PyObject* validation_error = NULL;
 static PyObject* decode_error = NULL;
 
+// Random seed of the hash used by the keys cache, set once at module initialization
+static uint64_t key_hash_seed = 0;
+
 
 /* These are the names of often used methods or literal values, interned in the module
    initialization function, to avoid repeated creation/destruction of PyUnicode values
@@ -60,6 +81,8 @@ static PyObject* decode_error = NULL;
 
 static PyObject* astimezone_name = NULL;
 static PyObject* hex_name = NULL;
+static PyObject* int_name = NULL;
+static PyObject* is_safe_name = NULL;
 static PyObject* timestamp_name = NULL;
 static PyObject* total_seconds_name = NULL;
 static PyObject* utcoffset_name = NULL;
@@ -71,6 +94,7 @@ static PyObject* default_name = NULL;
 static PyObject* end_array_name = NULL;
 static PyObject* string_name = NULL;
 static PyObject* read_name = NULL;
+static PyObject* readinto_name = NULL;
 static PyObject* write_name = NULL;
 static PyObject* encoding_name = NULL;
 
@@ -78,14 +102,84 @@ static PyObject* minus_inf_string_value = NULL;
 static PyObject* nan_string_value = NULL;
 static PyObject* plus_inf_string_value = NULL;
 
+static PyObject* null_event_name = NULL;
+static PyObject* boolean_event_name = NULL;
+static PyObject* number_event_name = NULL;
+static PyObject* string_event_name = NULL;
+static PyObject* map_key_event_name = NULL;
+static PyObject* start_map_event_name = NULL;
+static PyObject* end_map_event_name = NULL;
+static PyObject* start_array_event_name = NULL;
+static PyObject* end_array_event_name = NULL;
+
+
+/* Create a dictionary able to hold the given number of items without resizing. There is
+   no public API for that, and the private _PyDict_NewPresized() is not usable anymore
+   since Python 3.14: there dictionaries are created empty, and grow as usual. */
+
+static inline PyObject*
+dict_new_presized(Py_ssize_t size)
+{
+#if PY_VERSION_HEX < 0x030E0000
+    return _PyDict_NewPresized(size);
+#else
+    (void) size;
+    return PyDict_New();
+#endif
+}
+
+
+/* Create an int from the unsigned 128-bit value given as two 64-bit halves. */
+
+static inline PyObject*
+long_from_uint128(uint64_t high, uint64_t low)
+{
+    unsigned char bytes[16];
+
+    for (int i = 7; i >= 0; i--) {
+        bytes[i] = (unsigned char) high;
+        bytes[i + 8] = (unsigned char) low;
+        high >>= 8;
+        low >>= 8;
+    }
+
+#if PY_VERSION_HEX < 0x030D0000
+    return _PyLong_FromByteArray(bytes, sizeof(bytes), 0, 0);
+#else
+    return PyLong_FromUnsignedNativeBytes(bytes, sizeof(bytes),
+                                          Py_ASNATIVEBYTES_BIG_ENDIAN);
+#endif
+}
+
+
+/* Hash a buffer with the randomized function Python uses for str and bytes, public only
+   since Python 3.14. */
+
+static inline Py_hash_t
+hash_buffer(const void* data, Py_ssize_t length)
+{
+#if PY_VERSION_HEX < 0x030E0000
+    return _Py_HashBytes(data, length);
+#else
+    return Py_HashBuffer(data, length);
+#endif
+}
+
 
 struct HandlerContext {
+    // The container returned by Decoder.start_object(), or NULL when the values are
+    // collected on the handler's value stack and the container is built at its end
     PyObject* object;
-    const char* key;
-    SizeType keyLength;
+    PyObject* key;
+    // Where the values of this container begin on the handler's value stack
+    size_t valuesStart;
+    // When decoding a selection, the node matching this container, the one matching
+    // the value of the current key and the position of the next item of an array
+    unsigned selectNode;
+    unsigned valueNode;
+    size_t index;
     bool isObject;
     bool keyValuePairs;
-    bool copiedKey;
 };
 
 
@@ -138,6 +232,67 @@ days_per_month(int year, int month) {
 }
 
 
+/* Shift the given local date and time by the given offset, in seconds and less than a
+   day, to UTC: return false when the result falls outside the supported years. */
+
+static bool
+shift_to_utc(int& year, int& month, int& day, int& hours, int& mins, int tzoff)
+{
+    int minutes = hours * 60 + mins - tzoff / 60;
+
+    if (minutes < 0) {
+        minutes += 24 * 60;
+        if (--day == 0) {
+            if (--month == 0) {
+                month = 12;
+                year--;
+            }
+            day = days_per_month(year, month);
+        }
+    } else if (minutes >= 24 * 60) {
+        minutes -= 24 * 60;
+        if (++day > days_per_month(year, month)) {
+            day = 1;
+            if (++month > 12) {
+                month = 1;
+                year++;
+            }
+        }
+    }
+
+    hours = minutes / 60;
+    mins = minutes % 60;
+
+    return year >= 1 && year <= 9999;
+}
+
+
+/* The timezone instances of the offsets found in ISO 8601 literals, created on first use:
+   these are whole minutes and less than a day, so they are indexed by minutes. */
+
+static PyObject* timezones_by_offset[2 * 24 * 60 - 1];
+
+
+/* Return a borrowed reference to the timezone for the given offset in seconds. */
+
+static PyObject*
+timezone_from_offset(int tzoff)
+{
+    PyObject*& tz = timezones_by_offset[tzoff / 60 + 24 * 60 - 1];
+
+    if (tz == NULL) {
+        PyObject* offset = PyDateTimeAPI->Delta_FromDelta(0, tzoff, 0, 1,
+                                                          PyDateTimeAPI->DeltaType);
+        if (offset == NULL)
+            return NULL;
+        tz = PyObject_CallFunctionObjArgs(timezone_type, offset, NULL);
+        Py_DECREF(offset);
+    }
+
+    return tz;
+}
+
+
 enum UuidMode {
     UM_NONE = 0,
     UM_CANONICAL = 1<<0, // 4-dashed 32 hex chars: xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx
@@ -166,7 +321,10 @@ enum ParseMode {
     PM_NONE = 0,
     PM_COMMENTS = 1<<0,         // Allow one-line // ... and multi-line /* ... */ comments
     PM_TRAILING_COMMAS = 1<<1,  // allow trailing commas at the end of objects and arrays
-    PM_MAX = 1<<2
+    PM_FULL_PRECISION = 1<<2,   // Parse numbers in NM_NATIVE mode with full precision
+    PM_VALIDATE_ENCODING = 1<<3, // Validate the UTF-8 encoding of streams
+    PM_STOP_WHEN_DONE = 1<<4,   // Stop after the first value, ignoring what follows
+    PM_MAX = 1<<5
 };
 
 
@@ -200,21 +358,31 @@ enum MappingMode {
 //////////////////////////
 
 
+static PyObject* unicode_from_utf8(const char* str, size_t length);
+
+
+struct Selection;
 static PyObject* do_decode(PyObject* decoder,
-                           const char* jsonStr, Py_ssize_t jsonStrlen,
-                           PyObject* jsonStream, size_t chunkSize,
+                           const char* jsonStr, Py_ssize_t jsonStrlen, bool fromBuffer,
+                           bool destructive, PyObject* jsonStream, size_t chunkSize,
                            PyObject* objectHook,
                            unsigned numberMode, unsigned datetimeMode,
-                           unsigned uuidMode, unsigned parseMode);
+                           unsigned uuidMode, unsigned parseMode, bool releaseGil,
+                           const Selection* selection);
 static PyObject* decoder_call(PyObject* self, PyObject* args, PyObject* kwargs);
 static PyObject* decoder_new(PyTypeObject* type, PyObject* args, PyObject* kwargs);
+static PyObject* decoder_iter(PyObject* self, PyObject* args, PyObject* kwargs);
+static PyObject* decoder_loads_many(PyObject* self, PyObject* jsons);
+static PyObject* decoder_load_file(PyObject* self, PyObject* path);
 
 
 static PyObject* do_encode(PyObject* value, PyObject* defaultFn, bool ensureAscii,
-                           unsigned writeMode, char indentChar, unsigned indentCount,
-                           unsigned numberMode, unsigned datetimeMode,
-                           unsigned uuidMode, unsigned bytesMode,
-                           unsigned iterableMode, unsigned mappingMode);
+                           bool returnBytes, unsigned writeMode, char indentChar,
+                           unsigned indentCount, unsigned numberMode,
+                           unsigned datetimeMode, unsigned uuidMode,
+                           unsigned bytesMode, unsigned iterableMode,
+                           unsigned mappingMode, StringBuffer* buffer,
+                           size_t capacity);
 static PyObject* do_stream_encode(PyObject* value, PyObject* stream, size_t chunkSize,
                                   PyObject* defaultFn, bool ensureAscii,
                                   unsigned writeMode, char indentChar,
@@ -223,7 +391,11 @@ static PyObject* do_stream_encode(PyObject* value, PyObject* stream, size_t chun
                                   unsigned bytesMode, unsigned iterableMode,
                                   unsigned mappingMode);
 static PyObject* encoder_call(PyObject* self, PyObject* args, PyObject* kwargs);
+static PyObject* encoder_encode_bytes(PyObject* self, PyObject* value);
+static PyObject* encoder_dump_into(PyObject* self, PyObject* args, PyObject* kwargs);
+static PyObject* encoder_sizeof(PyObject* self, PyObject* Py_UNUSED(ignored));
 static PyObject* encoder_new(PyTypeObject* type, PyObject* args, PyObject* kwargs);
+static void encoder_dealloc(PyObject* self);
 
 
 static PyObject* validator_call(PyObject* self, PyObject* args, PyObject* kwargs);
@@ -236,6 +408,12 @@ static PyObject* validator_new(PyTypeObject* type, PyObject* args, PyObject* kwa
 ///////////////////////////////////////////////////
 
 
+/* The input stream is consumed in chunks, using the cheapest way it allows: a plain
+   io.FileIO is read thru its file descriptor with the GIL released, other binary streams
+   that do not override read() fill a single preallocated buffer by means of their
+   readinto() method, and only the remaining ones, text streams in particular, are asked
+   to read() each chunk. */
+
 class PyReadStreamWrapper {
 public:
     typedef char Ch;
@@ -244,18 +422,43 @@ public:
         : stream(stream) {
         Py_INCREF(stream);
         chunkSize = PyLong_FromUnsignedLong(size);
+        readBuffer = NULL;
+        fd = -1;
         buffer = NULL;
         chunk = NULL;
         chunkLen = 0;
         pos = 0;
         offset = 0;
         eof = false;
+
+        if (Py_TYPE(stream) == (PyTypeObject*) fileio_type) {
+            fd = PyObject_AsFileDescriptor(stream);
+            if (fd < 0)
+                PyErr_Clear();
+        } else if (IsBinary(stream)
+                   && HasBuiltinRead(stream)
+                   && PyObject_HasAttr(stream, readinto_name))
+            readBuffer = PyByteArray_FromStringAndSize(NULL, size);
+
+        if (fd >= 0 && readBuffer == NULL)
+            readBuffer = PyByteArray_FromStringAndSize(NULL, size);
+
+        if (readBuffer == NULL) {
+            fd = -1;
+            PyErr_Clear();
+        }
     }
 
     ~PyReadStreamWrapper() {
         Py_CLEAR(stream);
         Py_CLEAR(chunkSize);
         Py_CLEAR(chunk);
+        Py_CLEAR(readBuffer);
+    }
+
+    int Traverse(visitproc visit, void* arg) {
+        Py_VISIT(stream);
+        return 0;
     }
 
     Ch Peek() {
@@ -295,17 +498,45 @@ public:
     }
 
 private:
-    void Read() {
-        Py_CLEAR(chunk);
+    static bool IsBinary(PyObject* stream) {
+        int rc = PyObject_IsInstance(stream, buffered_io_base_type);
+        if (rc == 0)
+            rc = PyObject_IsInstance(stream, raw_io_base_type);
+        if (rc < 0) {
+            PyErr_Clear();
+            return false;
+        }
+        return rc == 1;
+    }
 
-        chunk = PyObject_CallMethodObjArgs(stream, read_name, chunkSize, NULL);
+    // Whether the read() method is the one implemented by the io module, and not an
+    // override that may return something different from what readinto() fills
 
-        if (chunk == NULL) {
-            eof = true;
+    static bool HasBuiltinRead(PyObject* stream) {
+        PyObject* read = PyObject_GetAttr((PyObject*) Py_TYPE(stream), read_name);
+        if (read == NULL) {
+            PyErr_Clear();
+            return false;
+        }
+        bool builtin = Py_TYPE(read) == &PyMethodDescr_Type;
+        Py_DECREF(read);
+        return builtin;
+    }
+
+    void Read() {
+        Py_ssize_t len;
+
+        if (readBuffer != NULL) {
+            len = fd >= 0 ? ReadFromFileDescriptor() : ReadInto();
+            buffer = PyByteArray_AS_STRING(readBuffer);
         } else {
-            Py_ssize_t len;
+            Py_CLEAR(chunk);
+
+            chunk = PyObject_CallMethodObjArgs(stream, read_name, chunkSize, NULL);
 
-            if (PyBytes_Check(chunk)) {
+            if (chunk == NULL) {
+                len = 0;
+            } else if (PyBytes_Check(chunk)) {
                 len = PyBytes_GET_SIZE(chunk);
                 buffer = PyBytes_AS_STRING(chunk);
             } else {
@@ -314,20 +545,81 @@ private:
                     len = 0;
                 }
             }
+        }
 
-            if (len == 0) {
-                eof = true;
-            } else {
-                offset += chunkLen;
-                chunkLen = len;
-                pos = 0;
+        if (len <= 0) {
+            eof = true;
+        } else {
+            offset += chunkLen;
+            chunkLen = len;
+            pos = 0;
+        }
+    }
+
+    // Fill the buffer calling stream.readinto(), returning the number of bytes read or
+    // -1 in case of error
+
+    Py_ssize_t ReadInto() {
+        PyObject* count = PyObject_CallMethodObjArgs(stream, readinto_name, readBuffer,
+                                                     NULL);
+        if (count == NULL)
+            return -1;
+
+        Py_ssize_t len;
+
+        if (count == Py_None) {
+            PyErr_SetString(PyExc_BlockingIOError,
+                            "No data available from non-blocking stream");
+            len = -1;
+        } else {
+            len = PyNumber_AsSsize_t(count, PyExc_OverflowError);
+            if (len == -1 && PyErr_Occurred())
+                len = -1;
+            else if (len < 0 || len > PyByteArray_GET_SIZE(readBuffer)) {
+                PyErr_SetString(PyExc_ValueError,
+                                "readinto() returned an invalid number of bytes");
+                len = -1;
             }
         }
+
+        Py_DECREF(count);
+        return len;
+    }
+
+    // Fill the buffer reading directly from the file descriptor, with the GIL released,
+    // returning the number of bytes read or -1 in case of error
+
+    Py_ssize_t ReadFromFileDescriptor() {
+        char* data = PyByteArray_AS_STRING(readBuffer);
+        Py_ssize_t size = PyByteArray_GET_SIZE(readBuffer);
+        Py_ssize_t len;
+        int error;
+
+        do {
+            Py_BEGIN_ALLOW_THREADS
+#ifdef _WIN32
+            len = _read(fd, data, (unsigned) std::min(size, (Py_ssize_t) INT_MAX));
+#else
+            len = read(fd, data, (size_t) size);
+#endif
+            error = errno;
+            Py_END_ALLOW_THREADS
+        } while (len < 0 && error == EINTR && PyErr_CheckSignals() == 0);
+
+        if (len < 0 && !PyErr_Occurred()) {
+            errno = error;
+            PyErr_SetFromErrno(PyExc_OSError);
+        }
+
+        return len;
     }
 
     PyObject* stream;
     PyObject* chunkSize;
     PyObject* chunk;
+    // The buffer filled by readinto() or by the file descriptor reads, if any
+    PyObject* readBuffer;
+    int fd;
     const Ch* buffer;
     size_t chunkLen;
     size_t pos;
@@ -443,6 +735,253 @@ inline void PutUnsafe(PyWriteStreamWrapper& stream, char c) {
 }
 
 
+// Output stream used by dumps() when the result is either a bytes or, with ensure_ascii,
+// a str: since in the latter case the writer emits only ASCII characters, in both cases
+// it writes straight into the data of the final object, that is trimmed to its length at
+// the end, instead of going thru a StringBuffer that should then be copied and decoded
+// again.
+
+class DirectOutputBuffer {
+public:
+    typedef char Ch;
+
+    DirectOutputBuffer(bool isBytes, size_t capacity)
+        : isBytes(isBytes), failed(false) {
+        obj = (isBytes
+               ? PyBytes_FromStringAndSize(NULL, capacity)
+               : PyUnicode_New(capacity, 127));
+        if (obj == NULL) {
+            failed = true;
+            cursor = scratch;
+            end = scratch + sizeof(scratch);
+        } else {
+            cursor = Data();
+            end = cursor + capacity;
+        }
+    }
+
+    ~DirectOutputBuffer() {
+        Py_XDECREF(obj);
+    }
+
+    void Put(Ch c) {
+        if (RAPIDJSON_UNLIKELY(cursor == end))
+            Grow(1);
+        *cursor++ = c;
+    }
+
+    void Reserve(size_t count) {
+        if (RAPIDJSON_UNLIKELY((size_t) (end - cursor) < count))
+            Grow(count);
+    }
+
+    void Flush() {}
+
+    // Return the resulting object, trimmed to the actual length, or NULL if some
+    // allocation failed
+    PyObject* Finish() {
+        if (failed)
+            return NULL;
+
+        size_t length = (size_t) (cursor - Data());
+
+        // Raw JSON values are copied verbatim, so even with ensure_ascii the output may
+        // contain non-ASCII bytes, that do not fit a str of the ASCII kind: decode the
+        // UTF-8 text in that case, as it would happen going thru a StringBuffer
+        if (!isBytes && !IsAscii(Data(), length))
+            return unicode_from_utf8(Data(), length);
+
+        if (!Resize(length))
+            return NULL;
+        PyObject* result = obj;
+        obj = NULL;
+        return result;
+    }
+
+private:
+    Ch* Data() {
+        return isBytes ? PyBytes_AS_STRING(obj) : (Ch*) PyUnicode_1BYTE_DATA(obj);
+    }
+
+    // Whether no byte has the high bit set, checking a word at a time
+    static bool IsAscii(const Ch* data, size_t length) {
+        const unsigned char* p = (const unsigned char*) data;
+        const unsigned char* end = p + length;
+        uint64_t bits = 0;
+
+        for (; end - p >= 8; p += 8) {
+            uint64_t word;
+            memcpy(&word, p, sizeof(word));
+            bits |= word;
+        }
+        for (; p < end; p++)
+            bits |= *p;
+        return (bits & UINT64_C(0x8080808080808080)) == 0;
+    }
+
+    bool Resize(size_t size) {
+        if (isBytes)
+            // On failure this releases the object and sets it to NULL
+            return _PyBytes_Resize(&obj, (Py_ssize_t) size) == 0;
+        if (PyUnicode_Resize(&obj, (Py_ssize_t) size) == 0)
+            return true;
+        Py_CLEAR(obj);
+        return false;
+    }
+
+    void Grow(size_t count) {
+        if (!failed) {
+            Ch* data = Data();
+            size_t length = (size_t) (cursor - data);
+            size_t capacity = (size_t) (end - data);
+            size_t newCapacity = capacity * 2;
+            if (newCapacity < length + count)
+                newCapacity = length + count;
+            if (Resize(newCapacity)) {
+                data = Data();
+                cursor = data + length;
+                end = data + newCapacity;
+                return;
+            }
+            failed = true;
+        }
+        // Once an allocation failed, the remaining output is simply discarded, cycling
+        // over a small scratch area: the pending MemoryError is raised at the end
+        cursor = scratch;
+        end = scratch + sizeof(scratch);
+    }
+
+    PyObject* obj;
+    Ch* cursor;
+    Ch* end;
+    bool isBytes;
+    bool failed;
+    Ch scratch[64];
+};
+
+
+inline void PutReserve(DirectOutputBuffer& stream, size_t count) {
+    stream.Reserve(count);
+}
+
+
+inline void PutUnsafe(DirectOutputBuffer& stream, char c) {
+    stream.Put(c);
+}
+
+
+// Output stream used by Encoder.dump_into(), writing into a caller supplied buffer,
+// starting at the given offset: when that is a bytearray it is enlarged as needed and
+// then trimmed to the end of the output, otherwise running out of space is an error.
+// The view is kept while writing, so that nobody else can resize the bytearray under our
+// feet, and temporarily released only to enlarge it.
+
+class BufferOutputStream {
+public:
+    typedef char Ch;
+
+    BufferOutputStream(PyObject* target, Py_buffer* view, size_t offset)
+        : target(target), view(view), offset(offset), grown(false), failed(false),
+          errorType(NULL), errorValue(NULL), errorTraceback(NULL) {
+        originalSize = (size_t) view->len;
+        resizable = PyByteArray_Check(target);
+        cursor = (Ch*) view->buf + offset;
+        end = (Ch*) view->buf + view->len;
+    }
+
+    void Put(Ch c) {
+        if (RAPIDJSON_UNLIKELY(cursor == end))
+            Grow();
+        *cursor++ = c;
+    }
+
+    // Reserve() is not implemented: the writer asks for the worst case, for example six
+    // bytes for each character of a string, and that would enlarge the bytearray way
+    // more than needed, and then trim it again, at each call
+
+    void Flush() {}
+
+    // Release the view and return the number of bytes written, or NULL if the encoding
+    // failed or the buffer was not big enough
+    PyObject* Finish(bool ok) {
+        size_t written = failed ? 0 : (size_t) (cursor - (Ch*) view->buf) - offset;
+
+        if (view->obj != NULL)
+            PyBuffer_Release(view);
+
+        // Trim the bytearray to the end of the output, or restore its original size
+        if (grown && PyByteArray_Resize(target,
+                                        ok && !failed
+                                        ? offset + written
+                                        : originalSize) == -1)
+            ok = false;
+
+        if (failed) {
+            if (!ok) {
+                Py_XDECREF(errorType);
+                Py_XDECREF(errorValue);
+                Py_XDECREF(errorTraceback);
+            } else if (errorType != NULL) {
+                PyErr_Restore(errorType, errorValue, errorTraceback);
+            } else {
+                PyErr_SetString(PyExc_ValueError,
+                                "The buffer is too small to contain the encoded value");
+            }
+            return NULL;
+        }
+
+        return ok ? PyLong_FromSize_t(written) : NULL;
+    }
+
+private:
+    void Grow() {
+        if (!failed && resizable) {
+            size_t length = (size_t) (cursor - (Ch*) view->buf);
+            size_t capacity = (size_t) view->len;
+            size_t newCapacity = capacity < 128 ? 256 : capacity * 2;
+            PyBuffer_Release(view);
+            if (PyByteArray_Resize(target, newCapacity) == 0) {
+                // Even if the buffer cannot be acquired again, Finish() must restore
+                // the original size
+                grown = true;
+                if (PyObject_GetBuffer(target, view, PyBUF_WRITABLE) == 0) {
+                    cursor = (Ch*) view->buf + length;
+                    end = (Ch*) view->buf + view->len;
+                    return;
+                }
+            }
+            // Do not leave the error pending while the encoder goes on, it will be
+            // raised by Finish()
+            PyErr_Fetch(&errorType, &errorValue, &errorTraceback);
+            view->obj = NULL;
+        }
+        failed = true;
+        // The remaining output is simply discarded, cycling over a small scratch area
+        cursor = scratch;
+        end = scratch + sizeof(scratch);
+    }
+
+    PyObject* target;
+    Py_buffer* view;
+    size_t offset;
+    size_t originalSize;
+    Ch* cursor;
+    Ch* end;
+    bool resizable;
+    bool grown;
+    bool failed;
+    PyObject* errorType;
+    PyObject* errorValue;
+    PyObject* errorTraceback;
+    Ch scratch[64];
+};
+
+
+inline void PutUnsafe(BufferOutputStream& stream, char c) {
+    stream.Put(c);
+}
+
+
 /////////////
 // RawJSON //
 /////////////
@@ -797,809 +1336,5518 @@ float_from_string(const char* s, Py_ssize_t len)
 }
 
 
-struct PyHandler {
-    PyObject* decoderStartObject;
-    PyObject* decoderEndObject;
-    PyObject* decoderEndArray;
-    PyObject* decoderString;
-    PyObject* sharedKeys;
-    PyObject* root;
-    PyObject* objectHook;
-    unsigned datetimeMode;
-    unsigned uuidMode;
-    unsigned numberMode;
-    unsigned recursionLimit;
-    std::vector<HandlerContext> stack;
-
-    PyHandler(PyObject* decoder,
-              PyObject* hook,
-              unsigned dm,
-              unsigned um,
-              unsigned nm)
-        : decoderStartObject(NULL),
-          decoderEndObject(NULL),
-          decoderEndArray(NULL),
-          decoderString(NULL),
-          root(NULL),
-          objectHook(hook),
-          datetimeMode(dm),
-          uuidMode(um),
-          numberMode(nm)
-        {
-            stack.reserve(128);
-            if (decoder != NULL) {
-                assert(!objectHook);
-                if (PyObject_HasAttr(decoder, start_object_name)) {
-                    decoderStartObject = PyObject_GetAttr(decoder, start_object_name);
-                }
-                if (PyObject_HasAttr(decoder, end_object_name)) {
-                    decoderEndObject = PyObject_GetAttr(decoder, end_object_name);
-                }
-                if (PyObject_HasAttr(decoder, end_array_name)) {
-                    decoderEndArray = PyObject_GetAttr(decoder, end_array_name);
-                }
-                if (PyObject_HasAttr(decoder, string_name)) {
-                    decoderString = PyObject_GetAttr(decoder, string_name);
-                }
-            }
-            sharedKeys = PyDict_New();
-            recursionLimit = Py_GetRecursionLimit();
-        }
+/* Whether the integer can be represented by RapidJSON, either as an int64_t or as an
+   uint64_t. */
 
-    ~PyHandler() {
-        while (!stack.empty()) {
-            const HandlerContext& ctx = stack.back();
-            if (ctx.copiedKey)
-                PyMem_Free((void*) ctx.key);
-            if (ctx.object != NULL)
-                Py_DECREF(ctx.object);
-            stack.pop_back();
-        }
-        Py_CLEAR(decoderStartObject);
-        Py_CLEAR(decoderEndObject);
-        Py_CLEAR(decoderEndArray);
-        Py_CLEAR(decoderString);
-        Py_CLEAR(sharedKeys);
+static bool
+long_fits_native(PyObject* value)
+{
+    int overflow;
+    PyLong_AsLongLongAndOverflow(value, &overflow);
+    if (overflow <= 0)
+        return overflow == 0;
+
+    PyLong_AsUnsignedLongLong(value);
+    if (PyErr_Occurred()) {
+        PyErr_Clear();
+        return false;
     }
+    return true;
+}
 
-    bool Handle(PyObject* value) {
-        if (root) {
-            const HandlerContext& current = stack.back();
 
-            if (current.isObject) {
-                PyObject* key = PyUnicode_FromStringAndSize(current.key,
-                                                            current.keyLength);
-                if (key == NULL) {
-                    Py_DECREF(value);
-                    return false;
-                }
+/* The 128-bit approximations of the powers of five between 5^-342 and 5^308, high word
+   first, used by the Eisel-Lemire algorithm in float_from_decimal(): they are computed
+   at module initialization, see init_powers_of_five(). */
 
-                PyObject* shared_key = PyDict_SetDefault(sharedKeys, key, key);
-                if (shared_key == NULL) {
-                    Py_DECREF(key);
-                    Py_DECREF(value);
-                    return false;
-                }
-                Py_INCREF(shared_key);
-                Py_DECREF(key);
-                key = shared_key;
+static const int smallestPowerOfFive = -342;
+static const int largestPowerOfFive = 308;
+static uint64_t powersOfFive[2 * (largestPowerOfFive - smallestPowerOfFive + 1)];
 
-                int rc;
-                if (current.keyValuePairs) {
-                    PyObject* pair = PyTuple_Pack(2, key, value);
 
-                    Py_DECREF(key);
-                    Py_DECREF(value);
-                    if (pair == NULL) {
-                        return false;
-                    }
-                    rc = PyList_Append(current.object, pair);
-                    Py_DECREF(pair);
-                } else {
-                    if (PyDict_CheckExact(current.object))
-                        // If it's a standard dictionary, this is +20% faster
-                        rc = PyDict_SetItem(current.object, key, value);
-                    else
-                        rc = PyObject_SetItem(current.object, key, value);
-                    Py_DECREF(key);
-                    Py_DECREF(value);
-                }
+/* Minimal arbitrary precision unsigned integer, with 32-bit limbs in little endian
+   order, just enough to compute the table above. */
 
-                if (rc == -1) {
-                    return false;
-                }
-            } else {
-                int rc = PyList_Append(current.object, value);
-                Py_DECREF(value);
-                if (rc == -1) {
-                    return false;
-                }
-            }
-        } else {
-            root = value;
-        }
-        return true;
-    }
+typedef std::vector<uint32_t> BigInt;
 
-    bool Key(const char* str, SizeType length, bool copy) {
-        HandlerContext& current = stack.back();
 
-        // This happens when operating in stream mode and kParseInsituFlag is not set: we
-        // must copy the incoming string in the context, and destroy the duplicate when
-        // the context gets reused for the next dictionary key
+static size_t
+bigint_bit_length(const BigInt& x)
+{
+    size_t i = x.size();
+    while (i > 0 && x[i-1] == 0)
+        i--;
+    if (i == 0)
+        return 0;
+    size_t bits = (i - 1) * 32;
+    for (uint32_t top = x[i-1]; top != 0; top >>= 1)
+        bits++;
+    return bits;
+}
 
-        if (current.key && current.copiedKey) {
-            PyMem_Free((void*) current.key);
-            current.key = NULL;
-        }
 
-        if (copy) {
-            char* copied_str = (char*) PyMem_Malloc(length+1);
-            if (copied_str == NULL)
-                return false;
-            memcpy(copied_str, str, length+1);
-            str = copied_str;
-            assert(!current.key);
-        }
+static void
+bigint_mul_small(BigInt& x, uint32_t m)
+{
+    uint64_t carry = 0;
+    for (size_t i = 0, n = x.size(); i < n; i++) {
+        carry += (uint64_t) x[i] * m;
+        x[i] = (uint32_t) carry;
+        carry >>= 32;
+    }
+    if (carry)
+        x.push_back((uint32_t) carry);
+}
 
-        current.key = str;
-        current.keyLength = length;
-        current.copiedKey = copy;
 
-        return true;
+static void
+bigint_div_small(BigInt& x, uint32_t d)
+{
+    uint64_t rest = 0;
+    for (size_t i = x.size(); i-- > 0; ) {
+        rest = (rest << 32) | x[i];
+        x[i] = (uint32_t) (rest / d);
+        rest %= d;
     }
+}
 
-    bool StartObject() {
-        if (recursionLimit-- == 0) {
-            PyErr_SetString(PyExc_RecursionError,
-                            "Maximum parse recursion depth exceeded");
-            return false;
+
+// Return the bits from the given position up, that must fit in 128 bits
+
+static void
+bigint_extract(const BigInt& x, size_t shift, uint64_t& high, uint64_t& low)
+{
+    high = low = 0;
+    for (size_t bit = 0; bit < 128; bit++) {
+        size_t src = shift + bit;
+        if (src / 32 < x.size() && (x[src / 32] >> (src % 32)) & 1) {
+            if (bit < 64)
+                low |= UINT64_C(1) << bit;
+            else
+                high |= UINT64_C(1) << (bit - 64);
         }
+    }
+}
 
-        PyObject* mapping;
-        bool key_value_pairs;
 
-        if (decoderStartObject != NULL) {
-            mapping = PyObject_CallFunctionObjArgs(decoderStartObject, NULL);
-            if (mapping == NULL)
-                return false;
-            key_value_pairs = PyList_Check(mapping);
-            if (!PyMapping_Check(mapping) && !key_value_pairs) {
-                Py_DECREF(mapping);
-                PyErr_SetString(PyExc_ValueError,
-                                "start_object() must return a mapping or a list instance");
-                return false;
-            }
-        } else {
-            mapping = PyDict_New();
-            if (mapping == NULL) {
-                return false;
+/* Fill powersOfFive: the positive powers are truncated to their 128 most significant
+   bits, while the negative ones are the 128 most significant bits of 2^b / 5^q plus one,
+   with b large enough to make the approximation accurate, as in the fast_float library.
+   Since floor(floor(n / 5) / 5) == floor(n / 25), those quotients are all obtained from a
+   single huge power of two, repeatedly divided by five. */
+
+static void
+init_powers_of_five()
+{
+    if (powersOfFive[0] != 0)
+        return;
+
+    BigInt power(1, 1);
+    std::vector<size_t> powerBits(-smallestPowerOfFive + 1);
+
+    for (int q = 0; q <= -smallestPowerOfFive; q++) {
+        size_t bits = bigint_bit_length(power);
+        powerBits[q] = bits;
+
+        if (q <= largestPowerOfFive) {
+            uint64_t* entry = powersOfFive + 2 * (q - smallestPowerOfFive);
+
+            if (bits >= 128)
+                bigint_extract(power, bits - 128, entry[0], entry[1]);
+            else {
+                uint64_t high, low;
+                bigint_extract(power, 0, high, low);
+                size_t shift = 128 - bits;
+                if (shift >= 64) {
+                    high = low << (shift - 64);
+                    low = 0;
+                } else if (shift > 0) {
+                    high = (high << shift) | (low >> (64 - shift));
+                    low <<= shift;
+                }
+                entry[0] = high;
+                entry[1] = low;
             }
-            key_value_pairs = false;
         }
 
-        if (!Handle(mapping)) {
-            return false;
+        bigint_mul_small(power, 5);
+    }
+
+    const size_t numeratorBits = 2 * powerBits[-smallestPowerOfFive] + 128;
+    BigInt numerator(numeratorBits / 32 + 1, 0);
+    numerator[numeratorBits / 32] = UINT32_C(1) << (numeratorBits % 32);
+
+    for (int q = 1; q <= -smallestPowerOfFive; q++) {
+        bigint_div_small(numerator, 5);
+
+        size_t z = powerBits[q];
+        size_t b = q <= 27 ? z + 127 : 2 * z + 128;
+
+        // Take floor(2^b / 5^q) + 1
+
+        BigInt quotient(numerator.begin() + (numeratorBits - b) / 32, numerator.end());
+        size_t shift = (numeratorBits - b) % 32;
+        if (shift > 0) {
+            for (size_t i = 0, n = quotient.size(); i < n; i++)
+                quotient[i] = (quotient[i] >> shift)
+                    | (i + 1 < n ? quotient[i+1] << (32 - shift) : 0);
         }
+        for (size_t i = 0; i < quotient.size() && ++quotient[i] == 0; i++)
+            ;
 
-        HandlerContext ctx;
-        ctx.isObject = true;
-        ctx.keyValuePairs = key_value_pairs;
-        ctx.object = mapping;
-        ctx.key = NULL;
-        ctx.copiedKey = false;
-        Py_INCREF(mapping);
+        size_t bits = bigint_bit_length(quotient);
+        uint64_t* entry = powersOfFive + 2 * (-q - smallestPowerOfFive);
+        bigint_extract(quotient, bits > 128 ? bits - 128 : 0, entry[0], entry[1]);
+    }
+}
 
-        stack.push_back(ctx);
 
-        return true;
+static inline void
+multiply_128(uint64_t a, uint64_t b, uint64_t& high, uint64_t& low)
+{
+#if defined(__SIZEOF_INT128__)
+    __extension__ typedef unsigned __int128 uint128_t;
+    uint128_t r = (uint128_t) a * b;
+    high = (uint64_t) (r >> 64);
+    low = (uint64_t) r;
+#else
+    uint64_t aLow = (uint32_t) a, aHigh = a >> 32;
+    uint64_t bLow = (uint32_t) b, bHigh = b >> 32;
+    uint64_t ll = aLow * bLow, lh = aLow * bHigh, hl = aHigh * bLow, hh = aHigh * bHigh;
+    uint64_t middle = (ll >> 32) + (uint32_t) lh + (uint32_t) hl;
+    low = (middle << 32) | (uint32_t) ll;
+    high = hh + (lh >> 32) + (hl >> 32) + (middle >> 32);
+#endif
+}
+
+
+static inline int
+leading_zeros_64(uint64_t x)
+{
+#if defined(__GNUC__)
+    return __builtin_clzll(x);
+#else
+    int n = 0;
+    while (!(x & (UINT64_C(1) << 63))) {
+        x <<= 1;
+        n++;
     }
+    return n;
+#endif
+}
 
-    bool EndObject(SizeType member_count) {
-        recursionLimit++;
 
-        const HandlerContext& ctx = stack.back();
+/* Compute the double nearest to mantissa * 10^exponent with the Eisel-Lemire algorithm,
+   for a mantissa of at most 19 digits: return false when the result cannot be determined
+   that way, that is in the rare halfway cases, for subnormals and for out of range
+   values, that must be handled by the slow path. */
 
-        if (ctx.copiedKey)
-            PyMem_Free((void*) ctx.key);
+static bool
+float_from_decimal(uint64_t mantissa, int64_t exponent, double& result)
+{
+    if (mantissa == 0) {
+        result = 0.0;
+        return true;
+    }
 
-        PyObject* mapping = ctx.object;
-        stack.pop_back();
+    if (exponent < smallestPowerOfFive || exponent > largestPowerOfFive)
+        return false;
 
-        if (objectHook == NULL && decoderEndObject == NULL) {
-            Py_DECREF(mapping);
-            return true;
-        }
+    int lz = leading_zeros_64(mantissa);
+    mantissa <<= lz;
 
-        PyObject* replacement;
-        if (decoderEndObject != NULL) {
-            replacement = PyObject_CallFunctionObjArgs(decoderEndObject, mapping, NULL);
-        } else /* if (objectHook != NULL) */ {
-            replacement = PyObject_CallFunctionObjArgs(objectHook, mapping, NULL);
-        }
+    const uint64_t* power = powersOfFive + 2 * (exponent - smallestPowerOfFive);
+    uint64_t high, low;
+    multiply_128(mantissa, power[0], high, low);
 
-        Py_DECREF(mapping);
-        if (replacement == NULL)
+    // Only the top 55 bits matter: when the remaining ones are all set the product
+    // could be off by one, so refine it with the low half of the power
+
+    const uint64_t precisionMask = UINT64_MAX >> 55;
+    if ((high & precisionMask) == precisionMask) {
+        uint64_t secondHigh, secondLow;
+        multiply_128(mantissa, power[1], secondHigh, secondLow);
+        low += secondHigh;
+        if (secondHigh > low)
+            high++;
+        if (low == UINT64_MAX)
             return false;
+    }
 
-        if (!stack.empty()) {
-            HandlerContext& current = stack.back();
+    int upperBit = (int) (high >> 63);
+    int shift = upperBit + 64 - 52 - 3;
+    uint64_t bits = high >> shift;
+    int64_t binaryExponent = (((152170 + 65536) * exponent) >> 16) + 63 + upperBit - lz
+        + 1023;
 
-            if (current.isObject) {
-                PyObject* key = PyUnicode_FromStringAndSize(current.key,
-                                                            current.keyLength);
-                if (key == NULL) {
-                    Py_DECREF(replacement);
-                    return false;
-                }
+    if (binaryExponent <= 0)
+        return false;
 
-                PyObject* shared_key = PyDict_SetDefault(sharedKeys, key, key);
-                if (shared_key == NULL) {
-                    Py_DECREF(key);
-                    Py_DECREF(replacement);
-                    return false;
-                }
-                Py_INCREF(shared_key);
-                Py_DECREF(key);
-                key = shared_key;
+    if (low <= 1 && (bits & 3) == 1 && (bits << shift) == high)
+        return false;
 
-                int rc;
-                if (current.keyValuePairs) {
-                    PyObject* pair = PyTuple_Pack(2, key, replacement);
+    bits += bits & 1;
+    bits >>= 1;
+    if (bits >= (UINT64_C(2) << 52)) {
+        bits = UINT64_C(1) << 52;
+        binaryExponent++;
+    }
+    bits &= ~(UINT64_C(1) << 52);
 
-                    Py_DECREF(key);
-                    Py_DECREF(replacement);
-                    if (pair == NULL) {
-                        return false;
-                    }
+    if (binaryExponent >= 0x7FF)
+        return false;
 
-                    Py_ssize_t listLen = PyList_GET_SIZE(current.object);
+    bits |= (uint64_t) binaryExponent << 52;
+    memcpy(&result, &bits, sizeof(result));
+    return true;
+}
 
-                    rc = PyList_SetItem(current.object, listLen - 1, pair);
 
-                    // NB: PyList_SetItem() always steals a reference on the replacement,
-                    // even in case of error:
-                    // https://docs.python.org/3/c-api/list.html#c.PyList_SetItem
+/* The 125-bit approximations of the powers of five used by the Ryū algorithm in
+   double_to_repr(), low word first: 5^i truncated, for i up to 325, and
+   floor(2^(bitlength(5^i) + 124) / 5^i) + 1, for i up to 341. They are computed at
+   module initialization, see init_ryu_tables(). */
 
-                    if (rc == -1) {
-                        return false;
-                    }
-                } else {
-                    if (PyDict_CheckExact(current.object))
-                        // If it's a standard dictionary, this is +20% faster
-                        rc = PyDict_SetItem(current.object, key, replacement);
-                    else
-                        rc = PyObject_SetItem(current.object, key, replacement);
-                    Py_DECREF(key);
-                    Py_DECREF(replacement);
-                    if (rc == -1) {
-                        return false;
-                    }
-                }
-            } else {
-                // Change these to PySequence_Size() and PySequence_SetItem(),
-                // should we implement Decoder.start_array()
-                Py_ssize_t listLen = PyList_GET_SIZE(current.object);
-                int rc = PyList_SetItem(current.object, listLen - 1, replacement);
+static const int ryuPow5BitCount = 125;
+static const int ryuPow5InvBitCount = 125;
+static const int ryuPow5TableSize = 326;
+static const int ryuPow5InvTableSize = 342;
+static uint64_t ryuPow5[2 * ryuPow5TableSize];
+static uint64_t ryuPow5Inv[2 * ryuPow5InvTableSize];
 
-                // NB: PyList_SetItem() always steals a reference on the replacement,
-                // even in case of error:
-                // https://docs.python.org/3/c-api/list.html#c.PyList_SetItem
 
-                if (rc == -1) {
-                    return false;
-                }
+static void
+init_ryu_tables()
+{
+    if (ryuPow5[1] != 0)
+        return;
+
+    BigInt power(1, 1);
+
+    for (int i = 0; i < ryuPow5TableSize; i++) {
+        size_t bits = bigint_bit_length(power);
+        uint64_t* entry = ryuPow5 + 2 * i;
+
+        if (bits >= (size_t) ryuPow5BitCount)
+            bigint_extract(power, bits - ryuPow5BitCount, entry[1], entry[0]);
+        else {
+            // Only the powers up to 5^53 are that short, and they fit in 128 bits
+            uint64_t high, low;
+            bigint_extract(power, 0, high, low);
+            size_t shift = ryuPow5BitCount - bits;
+            if (shift >= 64) {
+                high = low << (shift - 64);
+                low = 0;
+            } else if (shift > 0) {
+                high = (high << shift) | (low >> (64 - shift));
+                low <<= shift;
             }
-        } else {
-            Py_SETREF(root, replacement);
+            entry[0] = low;
+            entry[1] = high;
         }
 
-        return true;
+        bigint_mul_small(power, 5);
     }
 
-    bool StartArray() {
-        if (recursionLimit-- == 0) {
-            PyErr_SetString(PyExc_RecursionError,
-                            "Maximum parse recursion depth exceeded!");
-            return false;
-        }
+    // As in init_powers_of_five(), all the quotients come from a single power of two,
+    // repeatedly divided by five
 
-        PyObject* list = PyList_New(0);
-        if (list == NULL) {
-            return false;
-        }
+    const size_t numeratorBits = 1024;
+    BigInt numerator(numeratorBits / 32 + 1, 0);
+    numerator[numeratorBits / 32] = 1;
 
-        if (!Handle(list)) {
-            return false;
-        }
+    power.assign(1, 1);
 
-        HandlerContext ctx;
-        ctx.isObject = false;
-        ctx.object = list;
-        ctx.key = NULL;
-        ctx.copiedKey = false;
-        Py_INCREF(list);
+    for (int i = 0; i < ryuPow5InvTableSize; i++) {
+        size_t b = bigint_bit_length(power) - 1 + ryuPow5InvBitCount;
+        size_t shift = numeratorBits - b;
 
-        stack.push_back(ctx);
+        BigInt quotient(numerator.begin() + shift / 32, numerator.end());
+        if (shift % 32 > 0) {
+            for (size_t j = 0, n = quotient.size(); j < n; j++)
+                quotient[j] = (quotient[j] >> (shift % 32))
+                    | (j + 1 < n ? quotient[j+1] << (32 - shift % 32) : 0);
+        }
+        for (size_t j = 0; j < quotient.size() && ++quotient[j] == 0; j++)
+            ;
 
-        return true;
+        uint64_t* entry = ryuPow5Inv + 2 * i;
+        bigint_extract(quotient, 0, entry[1], entry[0]);
+
+        bigint_div_small(numerator, 5);
+        bigint_mul_small(power, 5);
     }
+}
 
-    bool EndArray(SizeType elementCount) {
-        recursionLimit++;
 
-        const HandlerContext& ctx = stack.back();
+// ceil(log2(5^e)), or 1 when e is 0
+static inline int32_t ryu_pow5_bits(int32_t e) { return ((e * 1217359) >> 19) + 1; }
+// floor(log10(2^e))
+static inline uint32_t ryu_log10_pow2(int32_t e) { return (e * 78913) >> 18; }
+// floor(log10(5^e))
+static inline uint32_t ryu_log10_pow5(int32_t e) { return (e * 732923) >> 20; }
 
-        if (ctx.copiedKey)
-            PyMem_Free((void*) ctx.key);
 
-        PyObject* sequence = ctx.object;
-        stack.pop_back();
+static inline bool
+ryu_multiple_of_power_of_5(uint64_t value, uint32_t p)
+{
+    uint32_t count = 0;
+    while (value % 5 == 0) {
+        value /= 5;
+        count++;
+    }
+    return count >= p;
+}
 
-        if (decoderEndArray == NULL) {
-            Py_DECREF(sequence);
-            return true;
-        }
 
-        PyObject* replacement = PyObject_CallFunctionObjArgs(decoderEndArray, sequence,
-                                                             NULL);
-        Py_DECREF(sequence);
-        if (replacement == NULL)
-            return false;
+static inline bool
+ryu_multiple_of_power_of_2(uint64_t value, uint32_t p)
+{
+    return (value & ((UINT64_C(1) << p) - 1)) == 0;
+}
 
-        if (!stack.empty()) {
-            const HandlerContext& current = stack.back();
 
-            if (current.isObject) {
-                PyObject* key = PyUnicode_FromStringAndSize(current.key,
-                                                            current.keyLength);
-                if (key == NULL) {
-                    Py_DECREF(replacement);
-                    return false;
-                }
+static inline uint64_t
+ryu_mul_shift(uint64_t m, const uint64_t* mul, int32_t j)
+{
+    uint64_t high1, low1, high0, low0;
+    multiply_128(m, mul[1], high1, low1);
+    multiply_128(m, mul[0], high0, low0);
+    uint64_t sum = high0 + low1;
+    if (sum < high0)
+        high1++;
+    int32_t dist = j - 64;
+    return (high1 << (64 - dist)) | (sum >> dist);
+}
 
-                int rc;
-                if (PyDict_Check(current.object))
-                    // If it's a standard dictionary, this is +20% faster
-                    rc = PyDict_SetItem(current.object, key, replacement);
-                else
-                    rc = PyObject_SetItem(current.object, key, replacement);
 
-                Py_DECREF(key);
-                Py_DECREF(replacement);
+/* Compute the shortest decimal digits, and the exponent of the last one, that uniquely
+   identify the finite non-zero double with the given IEEE fields, among them the one
+   nearest to its exact value, breaking ties to even: that is the Ryū algorithm by Ulf
+   Adams, see https://github.com/ulfjack/ryu. */
 
-                if (rc == -1) {
-                    return false;
-                }
-            } else {
-                // Change these to PySequence_Size() and PySequence_SetItem(),
-                // should we implement Decoder.start_array()
-                Py_ssize_t listLen = PyList_GET_SIZE(current.object);
-                int rc = PyList_SetItem(current.object, listLen - 1, replacement);
-
-                // NB: PyList_SetItem() always steals a reference on the replacement,
-                // even in case of error:
-                // https://docs.python.org/3/c-api/list.html#c.PyList_SetItem
-                //
-                if (rc == -1) {
-                    return false;
-                }
-            }
-        } else {
-            Py_SETREF(root, replacement);
-        }
+static void
+ryu_shortest(uint64_t ieeeMantissa, uint32_t ieeeExponent,
+             uint64_t& output, int32_t& exponent)
+{
+    int32_t e2;
+    uint64_t m2;
 
-        return true;
+    if (ieeeExponent == 0) {
+        e2 = 1 - 1023 - 52 - 2;
+        m2 = ieeeMantissa;
+    } else {
+        e2 = (int32_t) ieeeExponent - 1023 - 52 - 2;
+        m2 = (UINT64_C(1) << 52) | ieeeMantissa;
     }
 
-    bool NaN() {
-        if (!(numberMode & NM_NAN)) {
-            PyErr_SetString(PyExc_ValueError,
-                            "Out of range float values are not JSON compliant");
-            return false;
+    const bool acceptBounds = (m2 & 1) == 0;
+
+    // The exact value is mv / 4 * 2^e2, the halfway points to its neighbours mp and mm
+
+    const uint64_t mv = 4 * m2;
+    const uint32_t mmShift = ieeeMantissa != 0 || ieeeExponent <= 1;
+
+    uint64_t vr, vp, vm;
+    int32_t e10;
+    bool vmIsTrailingZeros = false;
+    bool vrIsTrailingZeros = false;
+
+    if (e2 >= 0) {
+        const uint32_t q = ryu_log10_pow2(e2) - (e2 > 3);
+        e10 = (int32_t) q;
+        const int32_t k = ryuPow5InvBitCount + ryu_pow5_bits(q) - 1;
+        const int32_t i = -e2 + (int32_t) q + k;
+        const uint64_t* mul = ryuPow5Inv + 2 * q;
+        vr = ryu_mul_shift(4 * m2, mul, i);
+        vp = ryu_mul_shift(4 * m2 + 2, mul, i);
+        vm = ryu_mul_shift(4 * m2 - 1 - mmShift, mul, i);
+        if (q <= 21) {
+            // Only one of mp, mv, and mm can be a multiple of 5, if any
+            if (mv % 5 == 0)
+                vrIsTrailingZeros = ryu_multiple_of_power_of_5(mv, q);
+            else if (acceptBounds)
+                vmIsTrailingZeros = ryu_multiple_of_power_of_5(mv - 1 - mmShift, q);
+            else
+                vp -= ryu_multiple_of_power_of_5(mv + 2, q);
+        }
+    } else {
+        const uint32_t q = ryu_log10_pow5(-e2) - (-e2 > 1);
+        e10 = (int32_t) q + e2;
+        const int32_t i = -e2 - (int32_t) q;
+        const int32_t k = ryu_pow5_bits(i) - ryuPow5BitCount;
+        const int32_t j = (int32_t) q - k;
+        const uint64_t* mul = ryuPow5 + 2 * i;
+        vr = ryu_mul_shift(4 * m2, mul, j);
+        vp = ryu_mul_shift(4 * m2 + 2, mul, j);
+        vm = ryu_mul_shift(4 * m2 - 1 - mmShift, mul, j);
+        if (q <= 1) {
+            // mv has at least two trailing zero bits, mm one only when mmShift is 1,
+            // and mp always one
+            vrIsTrailingZeros = true;
+            if (acceptBounds)
+                vmIsTrailingZeros = mmShift == 1;
+            else
+                vp--;
+        } else if (q < 63) {
+            vrIsTrailingZeros = ryu_multiple_of_power_of_2(mv, q);
         }
+    }
 
-        PyObject* value;
-        if (numberMode & NM_DECIMAL) {
-            value = PyObject_CallFunctionObjArgs(decimal_type, nan_string_value, NULL);
-        } else {
-            value = PyFloat_FromString(nan_string_value);
+    // Remove the digits while vp and vm differ, rounding vr
+
+    int32_t removed = 0;
+    uint32_t lastRemovedDigit = 0;
+
+    if (vmIsTrailingZeros || vrIsTrailingZeros) {
+        // The general, rare case
+        while (vp / 10 > vm / 10) {
+            vmIsTrailingZeros &= vm % 10 == 0;
+            vrIsTrailingZeros &= lastRemovedDigit == 0;
+            lastRemovedDigit = (uint32_t) (vr % 10);
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            removed++;
+        }
+        if (vmIsTrailingZeros) {
+            while (vm % 10 == 0) {
+                vrIsTrailingZeros &= lastRemovedDigit == 0;
+                lastRemovedDigit = (uint32_t) (vr % 10);
+                vr /= 10;
+                vp /= 10;
+                vm /= 10;
+                removed++;
+            }
+        }
+        if (vrIsTrailingZeros && lastRemovedDigit == 5 && vr % 2 == 0)
+            // Round to even when the exact value is halfway
+            lastRemovedDigit = 4;
+        output = vr + ((vr == vm && (!acceptBounds || !vmIsTrailingZeros))
+                       || lastRemovedDigit >= 5);
+    } else {
+        bool roundUp = false;
+        if (vp / 100 > vm / 100) {
+            roundUp = vr % 100 >= 50;
+            vr /= 100;
+            vp /= 100;
+            vm /= 100;
+            removed += 2;
+        }
+        while (vp / 10 > vm / 10) {
+            roundUp = vr % 10 >= 5;
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            removed++;
         }
+        output = vr + (vr == vm || roundUp);
+    }
 
-        if (value == NULL)
-            return false;
+    exponent = e10 + removed;
+}
 
-        return Handle(value);
-    }
 
-    bool Infinity(bool minus) {
-        if (!(numberMode & NM_NAN)) {
-            PyErr_SetString(PyExc_ValueError,
-                            "Out of range float values are not JSON compliant");
-            return false;
-        }
+/* Write into buffer, that must hold at least 25 chars, the same representation of the
+   finite double that repr() would produce, returning its length. */
 
-        PyObject* value;
-        if (numberMode & NM_DECIMAL) {
-            value = PyObject_CallFunctionObjArgs(decimal_type,
-                                                 minus
-                                                 ? minus_inf_string_value
-                                                 : plus_inf_string_value, NULL);
+static int
+double_to_repr(double d, char* buffer)
+{
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+
+    const bool negative = (bits >> 63) != 0;
+    const uint64_t ieeeMantissa = bits & ((UINT64_C(1) << 52) - 1);
+    const uint32_t ieeeExponent = (uint32_t) ((bits >> 52) & 0x7FF);
+
+    char* p = buffer;
+
+    if (negative)
+        *p++ = '-';
+
+    if (ieeeExponent == 0 && ieeeMantissa == 0) {
+        memcpy(p, "0.0", 3);
+        return (int) (p - buffer) + 3;
+    }
+
+    uint64_t output;
+    int32_t exponent;
+    ryu_shortest(ieeeMantissa, ieeeExponent, output, exponent);
+
+    char digits[17];
+    int length = 0;
+    for (uint64_t v = output; v != 0; v /= 10)
+        digits[16 - length++] = (char) ('0' + v % 10);
+    const char* first = digits + 17 - length;
+
+    // The position of the decimal point relative to the first digit: like
+    // float_repr_style "short", use the exponential notation when it is less than -3
+    // or greater than 16
+
+    int32_t point = exponent + length;
+
+    if (point > -4 && point <= 16) {
+        if (point <= 0) {
+            *p++ = '0';
+            *p++ = '.';
+            for (int32_t i = point; i < 0; i++)
+                *p++ = '0';
+            memcpy(p, first, length);
+            p += length;
+        } else if (point < length) {
+            memcpy(p, first, point);
+            p += point;
+            *p++ = '.';
+            memcpy(p, first + point, length - point);
+            p += length - point;
         } else {
-            value = PyFloat_FromString(minus
-                                       ? minus_inf_string_value
-                                       : plus_inf_string_value);
+            memcpy(p, first, length);
+            p += length;
+            for (int32_t i = length; i < point; i++)
+                *p++ = '0';
+            *p++ = '.';
+            *p++ = '0';
+        }
+    } else {
+        *p++ = first[0];
+        if (length > 1) {
+            *p++ = '.';
+            memcpy(p, first + 1, length - 1);
+            p += length - 1;
+        }
+        int32_t e = point - 1;
+        *p++ = 'e';
+        if (e < 0) {
+            *p++ = '-';
+            e = -e;
+        } else
+            *p++ = '+';
+        if (e >= 100) {
+            *p++ = (char) ('0' + e / 100);
+            e %= 100;
         }
+        *p++ = (char) ('0' + e / 10);
+        *p++ = (char) ('0' + e % 10);
+    }
 
-        if (value == NULL)
-            return false;
+    return (int) (p - buffer);
+}
 
-        return Handle(value);
-    }
 
-    bool Null() {
-        PyObject* value = Py_None;
-        Py_INCREF(value);
+/* Decode the UTF-8 sequence at p into c, returning its length, or 0 when it is not a
+   valid, shortest-form encoding of a non-surrogate code point. */
 
-        return Handle(value);
+static inline int
+decode_utf8_char(const unsigned char* p, const unsigned char* end, Py_UCS4& c)
+{
+    unsigned char lead = p[0];
+
+    if (lead < 0x80) {
+        c = lead;
+        return 1;
     }
 
-    bool Bool(bool b) {
-        PyObject* value = b ? Py_True : Py_False;
-        Py_INCREF(value);
+    if (lead < 0xC2)
+        return 0;
 
-        return Handle(value);
+    if (lead < 0xE0) {
+        if (end - p < 2 || (p[1] & 0xC0) != 0x80)
+            return 0;
+        c = ((Py_UCS4) (lead & 0x1F) << 6) | (p[1] & 0x3F);
+        return 2;
     }
 
-    bool Int(int i) {
-        PyObject* value = PyLong_FromLong(i);
-        return Handle(value);
+    if (lead < 0xF0) {
+        if (end - p < 3 || (p[1] & 0xC0) != 0x80 || (p[2] & 0xC0) != 0x80)
+            return 0;
+        c = ((Py_UCS4) (lead & 0x0F) << 12) | ((Py_UCS4) (p[1] & 0x3F) << 6)
+            | (p[2] & 0x3F);
+        if (c < 0x800 || (c >= 0xD800 && c <= 0xDFFF))
+            return 0;
+        return 3;
     }
 
-    bool Uint(unsigned i) {
-        PyObject* value = PyLong_FromUnsignedLong(i);
-        return Handle(value);
+    if (lead < 0xF5) {
+        if (end - p < 4 || (p[1] & 0xC0) != 0x80 || (p[2] & 0xC0) != 0x80
+            || (p[3] & 0xC0) != 0x80)
+            return 0;
+        c = ((Py_UCS4) (lead & 0x07) << 18) | ((Py_UCS4) (p[1] & 0x3F) << 12)
+            | ((Py_UCS4) (p[2] & 0x3F) << 6) | (p[3] & 0x3F);
+        if (c < 0x10000 || c > 0x10FFFF)
+            return 0;
+        return 4;
     }
 
-    bool Int64(int64_t i) {
-        PyObject* value = PyLong_FromLongLong(i);
-        return Handle(value);
-    }
+    return 0;
+}
 
-    bool Uint64(uint64_t i) {
-        PyObject* value = PyLong_FromUnsignedLongLong(i);
-        return Handle(value);
-    }
 
-    bool Double(double d) {
-        PyObject* value = PyFloat_FromDouble(d);
-        return Handle(value);
-    }
+/* Decode the UTF-8 text into out, returning false as soon as an invalid sequence is
+   found. */
 
-    bool RawNumber(const char* str, SizeType length, bool copy) {
-        PyObject* value;
-        bool isFloat = false;
+template <typename Char>
+static bool
+fill_from_utf8(Char* out, const unsigned char* p, const unsigned char* end)
+{
+    while (p < end) {
+        Py_UCS4 c;
+        int size = decode_utf8_char(p, end, c);
+        if (size == 0)
+            return false;
+        *out++ = (Char) c;
+        p += size;
+    }
+    return true;
+}
 
-        for (int i = length - 1; i >= 0; --i) {
-            // consider it a float if there is at least one non-digit character,
-            // it may be either a decimal number or +-infinity or nan
-            if (!isdigit(str[i]) && str[i] != '-') {
-                isFloat = true;
-                break;
-            }
-        }
 
-        if (isFloat) {
+/* Build a str from the UTF-8 text of a decoded string, allocating it with the right kind
+   and filling its 1, 2 or 4 bytes per character buffer directly, while
+   PyUnicode_FromStringAndSize() discovers the kind while decoding, possibly widening and
+   copying the characters more than once. The leading ASCII run is skipped a word at a
+   time; in the rest the length is the number of non-continuation bytes and the kind
+   follows from the greatest lead byte. Invalid sequences, that may come from an
+   unvalidated stream, are left to PyUnicode_DecodeUTF8() to raise the proper error. */
 
-            if (numberMode & NM_DECIMAL) {
-                PyObject* pystr = PyUnicode_FromStringAndSize(str, length);
-                if (pystr == NULL)
-                    return false;
-                value = PyObject_CallFunctionObjArgs(decimal_type, pystr, NULL);
-                Py_DECREF(pystr);
-            } else {
-                std::string zstr(str, length);
+static PyObject*
+unicode_from_utf8(const char* str, size_t length)
+{
+    const unsigned char* start = (const unsigned char*) str;
+    const unsigned char* end = start + length;
+    const unsigned char* p = start;
+
+    while (end - p >= 8) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        if (word & UINT64_C(0x8080808080808080))
+            break;
+        p += 8;
+    }
+    while (p < end && *p < 0x80)
+        p++;
 
-                value = float_from_string(zstr.c_str(), length);
-            }
+    size_t ascii = (size_t) (p - start);
 
-        } else {
-            std::string zstr(str, length);
+    if (p == end) {
+        PyObject* result = PyUnicode_New(length, 127);
+        if (result != NULL)
+            memcpy(PyUnicode_1BYTE_DATA(result), str, length);
+        return result;
+    }
 
-            value = PyLong_FromString(zstr.c_str(), NULL, 10);
-        }
+    size_t count = ascii;
+    unsigned char maxLead = 0;
 
-        if (value == NULL) {
-            PyErr_SetString(PyExc_ValueError,
-                            isFloat
-                            ? "Invalid float value"
-                            : "Invalid integer value");
-            return false;
-        } else {
-            return Handle(value);
-        }
+    for (const unsigned char* q = p; q < end; q++) {
+        count += (*q & 0xC0) != 0x80;
+        if (*q > maxLead)
+            maxLead = *q;
     }
 
-#define digit(idx) (str[idx] - '0')
+    // Lead bytes 0xC2 and 0xC3 encode U+0080-U+00FF, up to 0xEF the rest of the BMP
 
-    bool IsIso8601Date(const char* str, int& year, int& month, int& day) {
-        // we've already checked that str is a valid length and that 5 and 8 are '-'
-        if (!isdigit(str[0]) || !isdigit(str[1]) || !isdigit(str[2]) || !isdigit(str[3])
-            || !isdigit(str[5]) || !isdigit(str[6])
-            || !isdigit(str[8]) || !isdigit(str[9])) return false;
+    Py_UCS4 maxChar = maxLead <= 0xC3 ? 0xFF : maxLead < 0xF0 ? 0xFFFF : 0x10FFFF;
+    PyObject* result = PyUnicode_New(count, maxChar);
+    if (result == NULL)
+        return NULL;
 
-        year = digit(0)*1000 + digit(1)*100 + digit(2)*10 + digit(3);
-        month = digit(5)*10 + digit(6);
-        day = digit(8)*10 + digit(9);
+    bool valid;
 
-        return year > 0 && month <= 12 && day <= days_per_month(year, month);
+    switch (PyUnicode_KIND(result)) {
+    case PyUnicode_1BYTE_KIND: {
+        Py_UCS1* data = PyUnicode_1BYTE_DATA(result);
+        memcpy(data, str, ascii);
+        valid = fill_from_utf8(data + ascii, p, end);
+        break;
+    }
+    case PyUnicode_2BYTE_KIND:
+        valid = fill_from_utf8(PyUnicode_2BYTE_DATA(result), start, end);
+        break;
+    default:
+        valid = fill_from_utf8(PyUnicode_4BYTE_DATA(result), start, end);
+        break;
     }
 
-    bool IsIso8601Offset(const char* str, int& tzoff) {
-        if (!isdigit(str[1]) || !isdigit(str[2]) || str[3] != ':'
-            || !isdigit(str[4]) || !isdigit(str[5])) return false;
+    if (!valid) {
+        Py_DECREF(result);
+        return PyUnicode_DecodeUTF8(str, length, NULL);
+    }
 
-        int hofs = 0, mofs = 0, tzsign = 1;
-        hofs = digit(1)*10 + digit(2);
-        mofs = digit(4)*10 + digit(5);
+    return result;
+}
 
-        if (hofs > 23 || mofs > 59) return false;
 
-        if (str[0] == '-') tzsign = -1;
-        tzoff = tzsign * (hofs * 3600 + mofs * 60);
-        return true;
-    }
+/* Cache of the object keys seen while decoding, indexed by their raw UTF-8 bytes: it is
+   an open addressing hash table with linear probing, that holds a reference to the str
+   instance of each key, so that repeated keys are neither decoded nor allocated again.
 
-    bool IsIso8601Time(const char* str, SizeType length,
-                       int& hours, int& mins, int& secs, int& usecs, int& tzoff) {
-        // we've already checked that str is a minimum valid length, but nothing else
-        if (!isdigit(str[0]) || !isdigit(str[1]) || str[2] != ':'
-            || !isdigit(str[3]) || !isdigit(str[4]) || str[5] != ':'
-            || !isdigit(str[6]) || !isdigit(str[7])) return false;
+   When the capacity is not zero the cache holds at most that many keys, evicting the
+   ones not recently used with the "clock" algorithm: this is what a Decoder instance uses
+   to share the keys across different calls.
 
-        hours = digit(0)*10 + digit(1);
-        mins = digit(3)*10 + digit(4);
-        secs = digit(6)*10 + digit(7);
+   The hash is seeded once per process, so that colliding keys cannot be chosen in
+   advance, and a key is not cached at all when looking it up takes too many probes. */
 
-        if (hours > 23 || mins > 59 || secs > 59) return false;
+struct KeyCache {
+    struct Entry {
+        uint32_t hash;
+        bool referenced;
+        Py_ssize_t length;
+        const char* utf8;
+        PyObject* key;
+    };
 
-        if (length == 8 || (length == 9 && str[8] == 'Z')) {
-            // just time
-            return true;
-        }
+    Entry* entries;
+    size_t mask;
+    size_t used;
+    size_t capacity;
+    size_t hand;
+
+    KeyCache(size_t capacity = 0)
+        : entries(NULL),
+          mask(0),
+          used(0),
+          capacity(capacity),
+          hand(0)
+        {}
 
+    ~KeyCache() {
+        Clear();
+    }
 
-        if (length == 14 && (str[8] == '-' || str[8] == '+')) {
-            return IsIso8601Offset(&str[8], tzoff);
+    void Clear() {
+        if (entries != NULL) {
+            for (size_t i = 0; i <= mask; i++)
+                Py_XDECREF(entries[i].key);
+            PyMem_Free(entries);
+            entries = NULL;
         }
+        mask = 0;
+        used = 0;
+        hand = 0;
+    }
 
-        // at this point we need a . AND at least 1 more digit
-        if (length == 9 || str[8] != '.' || !isdigit(str[9])) return false;
+    // The longest probe sequence, beyond which the key is decoded without caching it
+    static const size_t kMaxProbes = 32;
 
-        int usecLength;
-        if (str[length - 1] == 'Z') {
-            usecLength = length - 10;
-        } else if (str[length - 3] == ':') {
-            if (!IsIso8601Offset(&str[length - 6], tzoff)) return false;
-            usecLength = length - 15;
-        } else {
-            usecLength = length - 9;
-        }
+    // The capacity of the caches living as long as a stream of values, that would
+    // otherwise keep every distinct key ever seen
+    static const size_t kStreamCapacity = 4096;
 
-        if (usecLength > 9) return false;
+    // Multiply and fold eight bytes at a time, starting from the random seed
 
-        switch (usecLength) {
-            case 9: if (!isdigit(str[17])) { return false; }
-            case 8: if (!isdigit(str[16])) { return false; }
-            case 7: if (!isdigit(str[15])) { return false; }
-            case 6: if (!isdigit(str[14])) { return false; } usecs += digit(14);
-            case 5: if (!isdigit(str[13])) { return false; } usecs += digit(13)*10;
-            case 4: if (!isdigit(str[12])) { return false; } usecs += digit(12)*100;
-            case 3: if (!isdigit(str[11])) { return false; } usecs += digit(11)*1000;
-            case 2: if (!isdigit(str[10])) { return false; } usecs += digit(10)*10000;
-            case 1: if (!isdigit(str[9])) { return false; } usecs += digit(9)*100000;
+    static uint32_t Hash(const char* str, SizeType length) {
+        const uint64_t k = UINT64_C(0x9E3779B97F4A7C15);
+        uint64_t hash = key_hash_seed ^ (length * k);
+        uint64_t word;
+
+        for (; length >= 8; str += 8, length -= 8) {
+            memcpy(&word, str, sizeof(word));
+            hash = (hash ^ word) * k;
+            hash ^= hash >> 32;
         }
+        if (length > 0) {
+            word = 0;
+            memcpy(&word, str, length);
+            hash = (hash ^ word) * k;
+            hash ^= hash >> 32;
+        }
+        return (uint32_t) ((hash * k) >> 32);
+    }
 
+    bool Grow() {
+        size_t size = entries == NULL ? 64 : (mask + 1) * 2;
+        Entry* grown = (Entry*) PyMem_Calloc(size, sizeof(Entry));
+        if (grown == NULL) {
+            PyErr_NoMemory();
+            return false;
+        }
+        if (entries != NULL) {
+            for (size_t i = 0; i <= mask; i++) {
+                if (entries[i].key != NULL) {
+                    size_t j = entries[i].hash & (size - 1);
+                    while (grown[j].key != NULL)
+                        j = (j + 1) & (size - 1);
+                    grown[j] = entries[i];
+                }
+            }
+            PyMem_Free(entries);
+        }
+        entries = grown;
+        mask = size - 1;
+        hand = 0;
         return true;
     }
 
-    bool IsIso8601(const char* str, SizeType length,
-                   int& year, int& month, int& day,
-                   int& hours, int& mins, int &secs, int& usecs, int& tzoff) {
-        year = -1;
-        month = day = hours = mins = secs = usecs = tzoff = 0;
+    // Advance the clock hand up to the first entry not referenced since its last visit,
+    // and remove it, shifting back the following entries of the same cluster
 
-        // Early exit for values that are clearly not valid (too short or too long)
-        if (length < 8 || length > 35) return false;
+    void Evict() {
+        for (;;) {
+            Entry& entry = entries[hand];
+            if (entry.key != NULL) {
+                if (!entry.referenced)
+                    break;
+                entry.referenced = false;
+            }
+            hand = (hand + 1) & mask;
+        }
 
-        bool isDate = str[4] == '-' && str[7] == '-';
+        size_t i = hand;
+        Py_DECREF(entries[i].key);
+        entries[i].key = NULL;
+        used--;
+
+        for (size_t j = (i + 1) & mask; entries[j].key != NULL; j = (j + 1) & mask) {
+            size_t home = entries[j].hash & mask;
+            // Move the entry into the hole, unless its home slot lies cyclically in
+            // (i, j]
+            if (i <= j ? (i < home && home <= j) : (i < home || home <= j))
+                continue;
+            entries[i] = entries[j];
+            entries[j].key = NULL;
+            i = j;
+        }
+    }
 
-        if (!isDate) {
-            return IsIso8601Time(str, length, hours, mins, secs, usecs, tzoff);
+    // Return a new reference to the str instance for the given key, creating it if
+    // this is the first time it is seen.
+
+    PyObject* Get(const char* str, SizeType length) {
+        if (used >= (mask + 1) / 2 && (capacity == 0 || used < capacity) && !Grow())
+            return NULL;
+
+        uint32_t hash = Hash(str, length);
+        size_t i = hash & mask;
+        size_t probes = 0;
+        while (entries[i].key != NULL) {
+            Entry& entry = entries[i];
+            if (entry.hash == hash
+                && entry.length == (Py_ssize_t) length
+                && memcmp(entry.utf8, str, length) == 0) {
+                entry.referenced = true;
+                Py_INCREF(entry.key);
+                return entry.key;
+            }
+            if (++probes == kMaxProbes)
+                return unicode_from_utf8(str, length);
+            i = (i + 1) & mask;
         }
 
-        if (length == 10) {
-            // if it looks like just a date, validate just the date
-            return IsIso8601Date(str, year, month, day);
+        PyObject* key = unicode_from_utf8(str, length);
+        if (key == NULL)
+            return NULL;
+
+        // For ASCII keys this is the content of the string itself, otherwise it is the
+        // UTF-8 representation cached by the instance: in both cases it lives as long as
+        // the key
+
+        Py_ssize_t utf8Length;
+        const char* utf8 = PyUnicode_AsUTF8AndSize(key, &utf8Length);
+        if (utf8 == NULL) {
+            Py_DECREF(key);
+            return NULL;
         }
-        if (length > 18 && (str[10] == 'T' || str[10] == ' ')) {
-            // if it looks like a date + time, validate date + time
-            return IsIso8601Date(str, year, month, day)
-                && IsIso8601Time(&str[11], length - 11, hours, mins, secs, usecs, tzoff);
+
+        if (capacity != 0 && used >= capacity) {
+            Evict();
+            // The eviction may have moved the entries around
+            i = hash & mask;
+            while (entries[i].key != NULL)
+                i = (i + 1) & mask;
         }
-        // can't be valid
-        return false;
+
+        Entry& entry = entries[i];
+        entry.hash = hash;
+        entry.referenced = false;
+        entry.length = utf8Length;
+        entry.utf8 = utf8;
+        entry.key = key;
+        Py_INCREF(key);
+        used++;
+
+        return key;
     }
+};
 
-    bool HandleIso8601(const char* str, SizeType length,
-                       int year, int month, int day,
-                       int hours, int mins, int secs, int usecs, int tzoff) {
-        // we treat year 0 as invalid and thus the default when there is no date
-        bool hasDate = year > 0;
 
-        if (length == 10 && hasDate) {
-            // just a date, handle quickly
-            return Handle(PyDate_FromDate(year, month, day));
-        }
+/* A set of paths selecting the parts of a document to be decoded, compiled into a trie.
+   Each node matches object keys, array indexes or both, since a reference token of a
+   JSON Pointer may address either, and optionally has a wildcard child matching any of
+   them, whose paths are merged into those of its siblings. */
 
-        bool isZ = str[length - 1] == 'Z';
-        bool hasOffset = !isZ && (str[length - 6] == '-' || str[length - 6] == '+');
+struct Selection {
+    // No matching child
+    static const unsigned NONE = UINT_MAX;
 
-        PyObject* value;
+    struct Node {
+        // Whether the whole subtree is selected
+        bool all;
+        unsigned wildcard;
+        std::vector<std::pair<std::string, unsigned> > keys;
+        std::vector<std::pair<size_t, unsigned> > indexes;
 
-        if ((datetimeMode & DM_NAIVE_IS_UTC || isZ) && !hasOffset) {
-            if (hasDate) {
-                value = PyDateTimeAPI->DateTime_FromDateAndTime(
-                    year, month, day, hours, mins, secs, usecs, timezone_utc,
-                    PyDateTimeAPI->DateTimeType);
-            } else {
-                value = PyDateTimeAPI->Time_FromTime(
-                    hours, mins, secs, usecs, timezone_utc, PyDateTimeAPI->TimeType);
-            }
-        } else if (datetimeMode & DM_IGNORE_TZ || (!hasOffset && !isZ)) {
-            if (hasDate) {
-                value = PyDateTime_FromDateAndTime(year, month, day,
-                                                   hours, mins, secs, usecs);
-            } else {
-                value = PyTime_FromTime(hours, mins, secs, usecs);
-            }
-        } else if (!hasDate && datetimeMode & DM_SHIFT_TO_UTC && tzoff) {
-            PyErr_Format(PyExc_ValueError,
-                         "Time literal cannot be shifted to UTC: %s", str);
-            value = NULL;
-        } else if (!hasDate && datetimeMode & DM_SHIFT_TO_UTC) {
-            value = PyDateTimeAPI->Time_FromTime(
-                hours, mins, secs, usecs, timezone_utc, PyDateTimeAPI->TimeType);
-        } else {
-            PyObject* offset = PyDateTimeAPI->Delta_FromDelta(0, tzoff, 0, 1,
-                                                              PyDateTimeAPI->DeltaType);
-            if (offset == NULL) {
-                value = NULL;
-            } else {
-                PyObject* tz = PyObject_CallFunctionObjArgs(timezone_type, offset, NULL);
-                Py_DECREF(offset);
-                if (tz == NULL) {
-                    value = NULL;
-                } else {
-                    if (hasDate) {
-                        value = PyDateTimeAPI->DateTime_FromDateAndTime(
-                            year, month, day, hours, mins, secs, usecs, tz,
-                            PyDateTimeAPI->DateTimeType);
-                        if (value != NULL && datetimeMode & DM_SHIFT_TO_UTC) {
-                            PyObject* asUTC = PyObject_CallMethodObjArgs(
-                                value, astimezone_name, timezone_utc, NULL);
-                            Py_DECREF(value);
-                            if (asUTC == NULL) {
-                                value = NULL;
-                            } else {
-                                value = asUTC;
-                            }
-                        }
-                    } else {
-                        value = PyDateTimeAPI->Time_FromTime(hours, mins, secs, usecs, tz,
-                                                             PyDateTimeAPI->TimeType);
-                    }
-                    Py_DECREF(tz);
-                }
-            }
-        }
+        Node() : all(false), wildcard(NONE) {}
+    };
 
-        if (value == NULL)
-            return false;
+    enum ComponentKind {
+        SC_KEY = 1<<0,
+        SC_INDEX = 1<<1,
+        SC_ANY = 1<<2
+    };
 
-        return Handle(value);
+    struct Component {
+        unsigned kind;
+        std::string key;
+        size_t index;
+    };
+
+    typedef std::vector<Component> Path;
+
+    std::vector<Node> nodes;
+
+    bool IsAll(unsigned node) const {
+        return nodes[node].all;
     }
 
-#undef digit
+    unsigned KeyChild(unsigned node, const char* key, SizeType length) const {
+        const Node& n = nodes[node];
 
-    bool IsUuid(const char* str, SizeType length) {
-        if (uuidMode == UM_HEX && length == 32) {
-            for (int i = length - 1; i >= 0; --i)
-                if (!isxdigit(str[i]))
-                    return false;
-            return true;
-        } else if (length == 36
-                   && str[8] == '-' && str[13] == '-'
-                   && str[18] == '-' && str[23] == '-') {
-            for (int i = length - 1; i >= 0; --i)
-                if (i != 8 && i != 13 && i != 18 && i != 23 && !isxdigit(str[i]))
-                    return false;
-            return true;
+        if (n.all)
+            return node;
+
+        for (size_t i = 0, c = n.keys.size(); i < c; i++) {
+            const std::string& k = n.keys[i].first;
+            if (k.size() == length && memcmp(k.data(), key, length) == 0)
+                return n.keys[i].second;
         }
-        return false;
+
+        return n.wildcard;
     }
 
-    bool HandleUuid(const char* str, SizeType length) {
-        PyObject* pystr = PyUnicode_FromStringAndSize(str, length);
-        if (pystr == NULL)
-            return false;
+    unsigned IndexChild(unsigned node, size_t index) const {
+        const Node& n = nodes[node];
 
-        PyObject* value = PyObject_CallFunctionObjArgs(uuid_type, pystr, NULL);
-        Py_DECREF(pystr);
+        if (n.all)
+            return node;
 
-        if (value == NULL)
-            return false;
-        else
-            return Handle(value);
+        for (size_t i = 0, c = n.indexes.size(); i < c; i++)
+            if (n.indexes[i].first == index)
+                return n.indexes[i].second;
+
+        return n.wildcard;
     }
 
-    bool String(const char* str, SizeType length, bool copy) {
-        PyObject* value;
+    // Build the node matching the given paths from their depth-th component onwards,
+    // returning its position
 
-        if (datetimeMode != DM_NONE) {
-            int year, month, day, hours, mins, secs, usecs, tzoff;
+    unsigned Build(const std::vector<const Path*>& paths, size_t depth) {
+        unsigned node = nodes.size();
+        nodes.push_back(Node());
 
-            if (IsIso8601(str, length, year, month, day,
-                          hours, mins, secs, usecs, tzoff))
-                return HandleIso8601(str, length, year, month, day,
-                                     hours, mins, secs, usecs, tzoff);
+        std::vector<const Path*> any;
+
+        for (size_t i = 0, c = paths.size(); i < c; i++) {
+            if (paths[i]->size() == depth) {
+                nodes[node].all = true;
+                return node;
+            }
+            if ((*paths[i])[depth].kind & SC_ANY)
+                any.push_back(paths[i]);
         }
 
-        if (uuidMode != UM_NONE && IsUuid(str, length))
-            return HandleUuid(str, length);
+        for (size_t i = 0, c = paths.size(); i < c; i++) {
+            const Component& first = (*paths[i])[depth];
 
-        value = PyUnicode_FromStringAndSize(str, length);
+            if (first.kind & SC_KEY) {
+                bool seen = false;
+                for (size_t j = 0; j < i && !seen; j++) {
+                    const Component& other = (*paths[j])[depth];
+                    seen = (other.kind & SC_KEY) && other.key == first.key;
+                }
+                if (!seen) {
+                    std::vector<const Path*> group(any);
+                    for (size_t j = i; j < c; j++) {
+                        const Component& other = (*paths[j])[depth];
+                        if ((other.kind & SC_KEY) && other.key == first.key)
+                            group.push_back(paths[j]);
+                    }
+                    unsigned child = Build(group, depth + 1);
+                    nodes[node].keys.push_back(std::make_pair(first.key, child));
+                }
+            }
+
+            if (first.kind & SC_INDEX) {
+                bool seen = false;
+                for (size_t j = 0; j < i && !seen; j++) {
+                    const Component& other = (*paths[j])[depth];
+                    seen = (other.kind & SC_INDEX) && other.index == first.index;
+                }
+                if (!seen) {
+                    std::vector<const Path*> group(any);
+                    for (size_t j = i; j < c; j++) {
+                        const Component& other = (*paths[j])[depth];
+                        if ((other.kind & SC_INDEX) && other.index == first.index)
+                            group.push_back(paths[j]);
+                    }
+                    unsigned child = Build(group, depth + 1);
+                    nodes[node].indexes.push_back(std::make_pair(first.index, child));
+                }
+            }
+        }
+
+        if (!any.empty()) {
+            unsigned child = Build(any, depth + 1);
+            nodes[node].wildcard = child;
+        }
+
+        return node;
+    }
+};
+
+
+/* Parse a JSON Pointer (RFC 6901) into its components: "*" stands for any key or index,
+   while a token that is a valid array index may address either an index or a key. */
+
+static bool
+parse_json_pointer(const char* pointer, Py_ssize_t length, Selection::Path& path)
+{
+    if (length == 0)
+        return true;
+
+    if (pointer[0] != '/') {
+        PyErr_Format(PyExc_ValueError,
+                     "Invalid JSON Pointer, must be empty or start with '/': %s",
+                     pointer);
+        return false;
+    }
+
+    const char* end = pointer + length;
+    const char* p = pointer + 1;
+
+    for (;;) {
+        Selection::Component component;
+        bool isIndex = p < end && *p >= '0' && *p <= '9';
+
+        component.kind = Selection::SC_KEY;
+        component.index = 0;
+
+        while (p < end && *p != '/') {
+            char c = *p++;
+            if (c == '~') {
+                if (p < end && (*p == '0' || *p == '1')) {
+                    c = *p++ == '0' ? '~' : '/';
+                } else {
+                    PyErr_Format(PyExc_ValueError,
+                                 "Invalid JSON Pointer, bad escape sequence: %s",
+                                 pointer);
+                    return false;
+                }
+            }
+            if (c < '0' || c > '9')
+                isIndex = false;
+            component.key += c;
+        }
+
+        if (component.key == "*")
+            component.kind = Selection::SC_ANY;
+        else if (isIndex && (component.key.size() == 1 || component.key[0] != '0')
+                 && component.key.size() < 19) {
+            component.kind |= Selection::SC_INDEX;
+            component.index = strtoull(component.key.c_str(), NULL, 10);
+        }
+
+        path.push_back(component);
+
+        if (p == end)
+            return true;
+        p++;
+    }
+}
+
+
+/* Parse a sequence of keys (str), indexes (non-negative int) and wildcards (Ellipsis). */
+
+static bool
+parse_key_path(PyObject* keys, Selection::Path& path)
+{
+    PyObject* items = PySequence_Fast(keys, "key path must be a tuple or a list");
+    if (items == NULL)
+        return false;
+
+    bool ok = true;
+
+    for (Py_ssize_t i = 0, c = PySequence_Fast_GET_SIZE(items); i < c && ok; i++) {
+        PyObject* item = PySequence_Fast_GET_ITEM(items, i);
+        Selection::Component component;
+
+        component.index = 0;
+
+        if (PyUnicode_Check(item)) {
+            Py_ssize_t length;
+            const char* key = PyUnicode_AsUTF8AndSize(item, &length);
+            if (key == NULL) {
+                ok = false;
+                break;
+            }
+            component.kind = Selection::SC_KEY;
+            component.key.assign(key, length);
+        } else if (PyLong_Check(item) && !PyBool_Check(item)) {
+            Py_ssize_t index = PyNumber_AsSsize_t(item, NULL);
+            if (index < 0) {
+                if (!PyErr_Occurred())
+                    PyErr_SetString(PyExc_ValueError,
+                                    "Invalid key path, indexes must be non-negative");
+                ok = false;
+                break;
+            }
+            component.kind = Selection::SC_INDEX;
+            component.index = (size_t) index;
+        } else if (item == Py_Ellipsis) {
+            component.kind = Selection::SC_ANY;
+        } else {
+            PyErr_SetString(PyExc_TypeError,
+                            "Invalid key path, items must be strings, non-negative"
+                            " integers or Ellipsis");
+            ok = false;
+            break;
+        }
+
+        path.push_back(component);
+    }
+
+    Py_DECREF(items);
+    return ok;
+}
+
+
+/* Compile the select argument, a single JSON Pointer or an iterable of JSON Pointers and
+   key paths, into a new Selection, left NULL when arg is None. */
+
+static bool
+accept_select_arg(PyObject* arg, Selection*& selection)
+{
+    selection = NULL;
+
+    if (arg == NULL || arg == Py_None)
+        return true;
+
+    std::vector<Selection::Path> paths;
+
+    if (PyUnicode_Check(arg)) {
+        Py_ssize_t length;
+        const char* pointer = PyUnicode_AsUTF8AndSize(arg, &length);
+        if (pointer == NULL)
+            return false;
+        paths.push_back(Selection::Path());
+        if (!parse_json_pointer(pointer, length, paths.back()))
+            return false;
+    } else {
+        PyObject* iterator = PyObject_GetIter(arg);
+        if (iterator == NULL) {
+            PyErr_SetString(PyExc_TypeError,
+                            "select must be a JSON Pointer, an iterable of JSON Pointers"
+                            " and key paths, or None");
+            return false;
+        }
+
+        PyObject* item;
+        bool ok = true;
+
+        while (ok && (item = PyIter_Next(iterator)) != NULL) {
+            paths.push_back(Selection::Path());
+            if (PyUnicode_Check(item)) {
+                Py_ssize_t length;
+                const char* pointer = PyUnicode_AsUTF8AndSize(item, &length);
+                ok = (pointer != NULL
+                      && parse_json_pointer(pointer, length, paths.back()));
+            } else
+                ok = parse_key_path(item, paths.back());
+            Py_DECREF(item);
+        }
+
+        Py_DECREF(iterator);
+
+        if (!ok || PyErr_Occurred())
+            return false;
+    }
+
+    std::vector<const Selection::Path*> pointers;
+    for (size_t i = 0, c = paths.size(); i < c; i++)
+        pointers.push_back(&paths[i]);
+
+    selection = new Selection();
+    selection->Build(pointers, 0);
+
+    return true;
+}
+
+
+struct PyHandler {
+    PyObject* decoderStartObject;
+    PyObject* decoderEndObject;
+    PyObject* decoderEndArray;
+    PyObject* decoderString;
+    KeyCache localKeys;
+    KeyCache* sharedKeys;
+    PyObject* root;
+    PyObject* objectHook;
+    unsigned datetimeMode;
+    unsigned uuidMode;
+    unsigned numberMode;
+    unsigned recursionLimit;
+    std::vector<HandlerContext> stack;
+    // The values (and the keys, for objects) of the containers being parsed, owned
+    std::vector<PyObject*> values;
+    // The parts of the document to be decoded, or NULL to decode it entirely
+    const Selection* selection;
+    // The nesting level within a container excluded by the selection
+    unsigned skipDepth;
+
+    PyHandler(PyObject* decoder,
+              PyObject* hook,
+              unsigned dm,
+              unsigned um,
+              unsigned nm,
+              KeyCache* keys = NULL)
+        : decoderStartObject(NULL),
+          decoderEndObject(NULL),
+          decoderEndArray(NULL),
+          decoderString(NULL),
+          root(NULL),
+          objectHook(hook),
+          datetimeMode(dm),
+          uuidMode(um),
+          numberMode(nm),
+          selection(NULL),
+          skipDepth(0)
+        {
+            sharedKeys = keys != NULL ? keys : &localKeys;
+            stack.reserve(128);
+            values.reserve(1024);
+            if (decoder != NULL) {
+                assert(!objectHook);
+                if (PyObject_HasAttr(decoder, start_object_name)) {
+                    decoderStartObject = PyObject_GetAttr(decoder, start_object_name);
+                }
+                if (PyObject_HasAttr(decoder, end_object_name)) {
+                    decoderEndObject = PyObject_GetAttr(decoder, end_object_name);
+                }
+                if (PyObject_HasAttr(decoder, end_array_name)) {
+                    decoderEndArray = PyObject_GetAttr(decoder, end_array_name);
+                }
+                if (PyObject_HasAttr(decoder, string_name)) {
+                    decoderString = PyObject_GetAttr(decoder, string_name);
+                }
+            }
+            recursionLimit = Py_GetRecursionLimit();
+        }
+
+    ~PyHandler() {
+        while (!stack.empty()) {
+            const HandlerContext& ctx = stack.back();
+            Py_XDECREF(ctx.key);
+            Py_XDECREF(ctx.object);
+            stack.pop_back();
+        }
+        for (size_t i = 0, n = values.size(); i < n; i++)
+            Py_DECREF(values[i]);
+        Py_CLEAR(decoderStartObject);
+        Py_CLEAR(decoderEndObject);
+        Py_CLEAR(decoderEndArray);
+        Py_CLEAR(decoderString);
+    }
+
+    int Traverse(visitproc visit, void* arg) {
+        for (size_t i = 0, n = stack.size(); i < n; i++) {
+            Py_VISIT(stack[i].key);
+            Py_VISIT(stack[i].object);
+        }
+        for (size_t i = 0, n = values.size(); i < n; i++)
+            Py_VISIT(values[i]);
+        Py_VISIT(decoderStartObject);
+        Py_VISIT(decoderEndObject);
+        Py_VISIT(decoderEndArray);
+        Py_VISIT(decoderString);
+        return 0;
+    }
+
+    bool Handle(PyObject* value) {
         if (value == NULL)
             return false;
 
-        if (decoderString != NULL) {
-            PyObject* replacement = PyObject_CallFunctionObjArgs(decoderString, value,
-                                                                 NULL);
+        if (stack.empty()) {
+            root = value;
+            return true;
+        }
+
+        const HandlerContext& current = stack.back();
+
+        if (current.object == NULL) {
+            values.push_back(value);
+            return true;
+        }
+
+        // This is a container returned by Decoder.start_object()
+
+        PyObject* key = current.key;
+        int rc;
+
+        if (current.keyValuePairs) {
+            PyObject* pair = PyTuple_Pack(2, key, value);
+
             Py_DECREF(value);
-            if (replacement == NULL)
+            if (pair == NULL) {
                 return false;
-            value = replacement;
+            }
+            rc = PyList_Append(current.object, pair);
+            Py_DECREF(pair);
+        } else {
+            if (PyDict_CheckExact(current.object))
+                // If it's a standard dictionary, this is +20% faster
+                rc = PyDict_SetItem(current.object, key, value);
+            else
+                rc = PyObject_SetItem(current.object, key, value);
+            Py_DECREF(value);
+        }
+
+        return rc != -1;
+    }
+
+    // When decoding a selection, determine whether the next value is excluded, and
+    // otherwise the node matching it
+
+    bool SelectValue(unsigned& node) {
+        if (skipDepth != 0)
+            return false;
+
+        if (stack.empty()) {
+            node = 0;
+            return true;
+        }
+
+        HandlerContext& current = stack.back();
+
+        if (current.isObject)
+            node = current.valueNode;
+        else
+            node = selection->IndexChild(current.selectNode, current.index++);
+
+        return node != Selection::NONE;
+    }
+
+    // Scalars are decoded only when selected as a whole, or when they are the root
+    // value: when skipping one in an object, drop its key
+
+    bool SkipScalar() {
+        unsigned node;
+
+        if (!SelectValue(node))
+            return true;
+
+        if (stack.empty() || selection->IsAll(node))
+            return false;
+
+        const HandlerContext& current = stack.back();
+
+        if (current.isObject && current.object == NULL) {
+            Py_DECREF(values.back());
+            values.pop_back();
+        }
+
+        return true;
+    }
+
+    bool Key(const char* str, SizeType length, bool copy) {
+        HandlerContext& current = stack.back();
+
+        if (selection != NULL) {
+            if (skipDepth != 0)
+                return true;
+
+            current.valueNode = selection->KeyChild(current.selectNode, str, length);
+            if (current.valueNode == Selection::NONE)
+                return true;
+        }
+
+        // The key is resolved right away, so there is no need to keep a copy of the
+        // incoming string even when it is transient, that is in stream mode
+
+        PyObject* key = sharedKeys->Get(str, length);
+        if (key == NULL)
+            return false;
+
+        if (current.object == NULL)
+            values.push_back(key);
+        else
+            Py_XSETREF(current.key, key);
+
+        return true;
+    }
+
+    bool StartObject() {
+        if (recursionLimit-- == 0) {
+            PyErr_SetString(PyExc_RecursionError,
+                            "Maximum parse recursion depth exceeded");
+            return false;
+        }
+
+        unsigned node = 0;
+
+        if (selection != NULL && !SelectValue(node)) {
+            skipDepth++;
+            return true;
         }
 
-        return Handle(value);
+        PyObject* mapping = NULL;
+        bool key_value_pairs = false;
+
+        if (decoderStartObject != NULL) {
+            mapping = PyObject_CallFunctionObjArgs(decoderStartObject, NULL);
+            if (mapping == NULL)
+                return false;
+            key_value_pairs = PyList_Check(mapping);
+            if (!PyMapping_Check(mapping) && !key_value_pairs) {
+                Py_DECREF(mapping);
+                PyErr_SetString(PyExc_ValueError,
+                                "start_object() must return a mapping or a list instance");
+                return false;
+            }
+        }
+
+        HandlerContext ctx;
+        ctx.isObject = true;
+        ctx.keyValuePairs = key_value_pairs;
+        ctx.object = mapping;
+        ctx.key = NULL;
+        ctx.valuesStart = values.size();
+        ctx.selectNode = node;
+        ctx.valueNode = Selection::NONE;
+        ctx.index = 0;
+
+        stack.push_back(ctx);
+
+        return true;
+    }
+
+    bool EndObject(SizeType memberCount) {
+        recursionLimit++;
+
+        if (skipDepth != 0) {
+            skipDepth--;
+            return true;
+        }
+
+        const HandlerContext& ctx = stack.back();
+
+        Py_XDECREF(ctx.key);
+
+        PyObject* mapping = ctx.object;
+        size_t valuesStart = ctx.valuesStart;
+        stack.pop_back();
+
+        if (mapping == NULL) {
+            // Build the dictionary out of the key/value pairs on the value stack, sized
+            // to hold all of them without resizing
+
+            size_t valuesEnd = values.size();
+
+            mapping = dict_new_presized((valuesEnd - valuesStart) / 2);
+            if (mapping == NULL)
+                return false;
+            int rc = 0;
+
+            for (size_t i = valuesStart; i < valuesEnd; i += 2) {
+                if (rc == 0)
+                    rc = PyDict_SetItem(mapping, values[i], values[i+1]);
+                Py_DECREF(values[i]);
+                Py_DECREF(values[i+1]);
+            }
+            values.resize(valuesStart);
+
+            if (rc == -1) {
+                Py_DECREF(mapping);
+                return false;
+            }
+        }
+
+        if (objectHook == NULL && decoderEndObject == NULL)
+            return Handle(mapping);
+
+        PyObject* replacement;
+        if (decoderEndObject != NULL) {
+            replacement = PyObject_CallFunctionObjArgs(decoderEndObject, mapping, NULL);
+        } else /* if (objectHook != NULL) */ {
+            replacement = PyObject_CallFunctionObjArgs(objectHook, mapping, NULL);
+        }
+
+        Py_DECREF(mapping);
+
+        return Handle(replacement);
+    }
+
+    bool StartArray() {
+        if (recursionLimit-- == 0) {
+            PyErr_SetString(PyExc_RecursionError,
+                            "Maximum parse recursion depth exceeded!");
+            return false;
+        }
+
+        unsigned node = 0;
+
+        if (selection != NULL && !SelectValue(node)) {
+            skipDepth++;
+            return true;
+        }
+
+        HandlerContext ctx;
+        ctx.isObject = false;
+        ctx.keyValuePairs = false;
+        ctx.object = NULL;
+        ctx.key = NULL;
+        ctx.valuesStart = values.size();
+        ctx.selectNode = node;
+        ctx.valueNode = Selection::NONE;
+        ctx.index = 0;
+
+        stack.push_back(ctx);
+
+        return true;
+    }
+
+    bool EndArray(SizeType elementCount) {
+        recursionLimit++;
+
+        if (skipDepth != 0) {
+            skipDepth--;
+            return true;
+        }
+
+        size_t valuesStart = stack.back().valuesStart;
+        stack.pop_back();
+
+        // Build the list at its exact size, moving the references off the value stack:
+        // this is less than elementCount when decoding a selection
+
+        size_t count = values.size() - valuesStart;
+
+        PyObject* sequence = PyList_New(count);
+        if (sequence == NULL)
+            return false;
+
+        for (size_t i = 0; i < count; i++)
+            PyList_SET_ITEM(sequence, i, values[valuesStart + i]);
+        values.resize(valuesStart);
+
+        if (decoderEndArray == NULL)
+            return Handle(sequence);
+
+        PyObject* replacement = PyObject_CallFunctionObjArgs(decoderEndArray, sequence,
+                                                             NULL);
+        Py_DECREF(sequence);
+
+        return Handle(replacement);
+    }
+
+    bool NaN() {
+        if (!(numberMode & NM_NAN)) {
+            PyErr_SetString(PyExc_ValueError,
+                            "Out of range float values are not JSON compliant");
+            return false;
+        }
+
+        PyObject* value;
+        if (numberMode & NM_DECIMAL) {
+            value = PyObject_CallFunctionObjArgs(decimal_type, nan_string_value, NULL);
+        } else {
+            value = PyFloat_FromString(nan_string_value);
+        }
+
+        if (value == NULL)
+            return false;
+
+        return Handle(value);
+    }
+
+    bool Infinity(bool minus) {
+        if (!(numberMode & NM_NAN)) {
+            PyErr_SetString(PyExc_ValueError,
+                            "Out of range float values are not JSON compliant");
+            return false;
+        }
+
+        PyObject* value;
+        if (numberMode & NM_DECIMAL) {
+            value = PyObject_CallFunctionObjArgs(decimal_type,
+                                                 minus
+                                                 ? minus_inf_string_value
+                                                 : plus_inf_string_value, NULL);
+        } else {
+            value = PyFloat_FromString(minus
+                                       ? minus_inf_string_value
+                                       : plus_inf_string_value);
+        }
+
+        if (value == NULL)
+            return false;
+
+        return Handle(value);
+    }
+
+    bool Null() {
+        if (selection != NULL && SkipScalar())
+            return true;
+
+        PyObject* value = Py_None;
+        Py_INCREF(value);
+
+        return Handle(value);
+    }
+
+    bool Bool(bool b) {
+        if (selection != NULL && SkipScalar())
+            return true;
+
+        PyObject* value = b ? Py_True : Py_False;
+        Py_INCREF(value);
+
+        return Handle(value);
+    }
+
+    bool Int(int i) {
+        if (selection != NULL && SkipScalar())
+            return true;
+
+        PyObject* value = PyLong_FromLong(i);
+        return Handle(value);
+    }
+
+    bool Uint(unsigned i) {
+        if (selection != NULL && SkipScalar())
+            return true;
+
+        PyObject* value = PyLong_FromUnsignedLong(i);
+        return Handle(value);
+    }
+
+    bool Int64(int64_t i) {
+        if (selection != NULL && SkipScalar())
+            return true;
+
+        PyObject* value = PyLong_FromLongLong(i);
+        return Handle(value);
+    }
+
+    bool Uint64(uint64_t i) {
+        if (selection != NULL && SkipScalar())
+            return true;
+
+        PyObject* value = PyLong_FromUnsignedLongLong(i);
+        return Handle(value);
+    }
+
+    bool Double(double d) {
+        if (selection != NULL && SkipScalar())
+            return true;
+
+        PyObject* value = PyFloat_FromDouble(d);
+        return Handle(value);
+    }
+
+    bool RawNumber(const char* str, SizeType length, bool copy) {
+        if (selection != NULL && SkipScalar())
+            return true;
+
+        PyObject* value;
+        bool isFloat = false;
+
+        // Scan the number in place, accumulating up to 19 significant digits: this
+        // is enough to convert most numbers without going thru a string
+
+        const char* p = str;
+        const char* end = str + length;
+        bool negative = *p == '-';
+        uint64_t mantissa = 0;
+        int64_t exponent = 0;
+        int digits = 0;
+
+        if (negative)
+            p++;
+
+        for (; p < end && isdigit(*p); p++) {
+            if (mantissa != 0 || *p != '0')
+                digits++;
+            if (digits <= 19)
+                mantissa = mantissa * 10 + (*p - '0');
+        }
+
+        if (p < end && *p == '.') {
+            isFloat = true;
+            for (p++; p < end && isdigit(*p); p++) {
+                if (mantissa != 0 || *p != '0')
+                    digits++;
+                if (digits <= 19) {
+                    mantissa = mantissa * 10 + (*p - '0');
+                    exponent--;
+                }
+            }
+        }
+
+        if (p < end && (*p == 'e' || *p == 'E')) {
+            isFloat = true;
+            p++;
+            bool negativeExponent = *p == '-';
+            if (*p == '-' || *p == '+')
+                p++;
+            int64_t e = 0;
+            for (; p < end && isdigit(*p); p++) {
+                if (e < 100000)
+                    e = e * 10 + (*p - '0');
+            }
+            exponent += negativeExponent ? -e : e;
+        }
+
+        // Anything else is either NaN or Infinity
+
+        bool plain = p == end;
+        if (!plain)
+            isFloat = true;
+
+        if (isFloat) {
+
+            double d;
+
+            if (numberMode & NM_DECIMAL) {
+                PyObject* pystr = PyUnicode_FromStringAndSize(str, length);
+                if (pystr == NULL)
+                    return false;
+                value = PyObject_CallFunctionObjArgs(decimal_type, pystr, NULL);
+                Py_DECREF(pystr);
+            } else if (plain && digits <= 19
+                       && float_from_decimal(mantissa, exponent, d)) {
+                value = PyFloat_FromDouble(negative ? -d : d);
+            } else {
+                std::string zstr(str, length);
+
+                value = float_from_string(zstr.c_str(), length);
+
+                // In NM_NATIVE mode, where this is used for PM_FULL_PRECISION, the
+                // overflow is an error as when RapidJSON converts the number
+
+                if (numberMode & NM_NATIVE && plain && value != NULL
+                    && std::isinf(PyFloat_AS_DOUBLE(value))) {
+                    Py_DECREF(value);
+                    PyErr_SetString(decode_error,
+                                    GetParseError_En(kParseErrorNumberTooBig));
+                    return false;
+                }
+            }
+
+        } else if (digits <= 18) {
+            value = PyLong_FromLongLong(negative
+                                        ? -(long long) mantissa
+                                        : (long long) mantissa);
+        } else {
+            std::string zstr(str, length);
+
+            value = PyLong_FromString(zstr.c_str(), NULL, 10);
+
+            // In NM_NATIVE mode integers that do not fit in 64 bits become floats, as
+            // when RapidJSON converts them
+
+            if (numberMode & NM_NATIVE && value != NULL && !long_fits_native(value)) {
+                Py_DECREF(value);
+                value = float_from_string(zstr.c_str(), length);
+            }
+        }
+
+        if (value == NULL) {
+            PyErr_SetString(PyExc_ValueError,
+                            isFloat
+                            ? "Invalid float value"
+                            : "Invalid integer value");
+            return false;
+        } else {
+            return Handle(value);
+        }
+    }
+
+#define digit(idx) (str[idx] - '0')
+
+    bool IsIso8601Date(const char* str, int& year, int& month, int& day) {
+        // we've already checked that str is a valid length and that 5 and 8 are '-'
+        if (!isdigit(str[0]) || !isdigit(str[1]) || !isdigit(str[2]) || !isdigit(str[3])
+            || !isdigit(str[5]) || !isdigit(str[6])
+            || !isdigit(str[8]) || !isdigit(str[9])) return false;
+
+        year = digit(0)*1000 + digit(1)*100 + digit(2)*10 + digit(3);
+        month = digit(5)*10 + digit(6);
+        day = digit(8)*10 + digit(9);
+
+        return year > 0 && month <= 12 && day <= days_per_month(year, month);
+    }
+
+    bool IsIso8601Offset(const char* str, int& tzoff) {
+        if (!isdigit(str[1]) || !isdigit(str[2]) || str[3] != ':'
+            || !isdigit(str[4]) || !isdigit(str[5])) return false;
+
+        int hofs = 0, mofs = 0, tzsign = 1;
+        hofs = digit(1)*10 + digit(2);
+        mofs = digit(4)*10 + digit(5);
+
+        if (hofs > 23 || mofs > 59) return false;
+
+        if (str[0] == '-') tzsign = -1;
+        tzoff = tzsign * (hofs * 3600 + mofs * 60);
+        return true;
+    }
+
+    bool IsIso8601Time(const char* str, SizeType length,
+                       int& hours, int& mins, int& secs, int& usecs, int& tzoff) {
+        // we've already checked that str is a minimum valid length, but nothing else
+        if (!isdigit(str[0]) || !isdigit(str[1]) || str[2] != ':'
+            || !isdigit(str[3]) || !isdigit(str[4]) || str[5] != ':'
+            || !isdigit(str[6]) || !isdigit(str[7])) return false;
+
+        hours = digit(0)*10 + digit(1);
+        mins = digit(3)*10 + digit(4);
+        secs = digit(6)*10 + digit(7);
+
+        if (hours > 23 || mins > 59 || secs > 59) return false;
+
+        if (length == 8 || (length == 9 && str[8] == 'Z')) {
+            // just time
+            return true;
+        }
+
+
+        if (length == 14 && (str[8] == '-' || str[8] == '+')) {
+            return IsIso8601Offset(&str[8], tzoff);
+        }
+
+        // at this point we need a . AND at least 1 more digit
+        if (length == 9 || str[8] != '.' || !isdigit(str[9])) return false;
+
+        int usecLength;
+        if (str[length - 1] == 'Z') {
+            usecLength = length - 10;
+        } else if (str[length - 3] == ':') {
+            if (!IsIso8601Offset(&str[length - 6], tzoff)) return false;
+            usecLength = length - 15;
+        } else {
+            usecLength = length - 9;
+        }
+
+        if (usecLength > 9) return false;
+
+        switch (usecLength) {
+            case 9: if (!isdigit(str[17])) { return false; }
+            case 8: if (!isdigit(str[16])) { return false; }
+            case 7: if (!isdigit(str[15])) { return false; }
+            case 6: if (!isdigit(str[14])) { return false; } usecs += digit(14);
+            case 5: if (!isdigit(str[13])) { return false; } usecs += digit(13)*10;
+            case 4: if (!isdigit(str[12])) { return false; } usecs += digit(12)*100;
+            case 3: if (!isdigit(str[11])) { return false; } usecs += digit(11)*1000;
+            case 2: if (!isdigit(str[10])) { return false; } usecs += digit(10)*10000;
+            case 1: if (!isdigit(str[9])) { return false; } usecs += digit(9)*100000;
+        }
+
+        return true;
+    }
+
+    bool IsIso8601(const char* str, SizeType length,
+                   int& year, int& month, int& day,
+                   int& hours, int& mins, int &secs, int& usecs, int& tzoff) {
+        year = -1;
+        month = day = hours = mins = secs = usecs = tzoff = 0;
+
+        // Early exit for values that are clearly not valid (too short or too long)
+        if (length < 8 || length > 35) return false;
+
+        bool isDate = str[4] == '-' && str[7] == '-';
+
+        if (!isDate) {
+            return IsIso8601Time(str, length, hours, mins, secs, usecs, tzoff);
+        }
+
+        if (length == 10) {
+            // if it looks like just a date, validate just the date
+            return IsIso8601Date(str, year, month, day);
+        }
+        if (length > 18 && (str[10] == 'T' || str[10] == ' ')) {
+            // if it looks like a date + time, validate date + time
+            return IsIso8601Date(str, year, month, day)
+                && IsIso8601Time(&str[11], length - 11, hours, mins, secs, usecs, tzoff);
+        }
+        // can't be valid
+        return false;
+    }
+
+    bool HandleIso8601(const char* str, SizeType length,
+                       int year, int month, int day,
+                       int hours, int mins, int secs, int usecs, int tzoff) {
+        // we treat year 0 as invalid and thus the default when there is no date
+        bool hasDate = year > 0;
+
+        if (length == 10 && hasDate) {
+            // just a date, handle quickly
+            return Handle(PyDate_FromDate(year, month, day));
+        }
+
+        bool isZ = str[length - 1] == 'Z';
+        bool hasOffset = !isZ && (str[length - 6] == '-' || str[length - 6] == '+');
+
+        PyObject* value;
+
+        if ((datetimeMode & DM_NAIVE_IS_UTC || isZ) && !hasOffset) {
+            if (hasDate) {
+                value = PyDateTimeAPI->DateTime_FromDateAndTime(
+                    year, month, day, hours, mins, secs, usecs, timezone_utc,
+                    PyDateTimeAPI->DateTimeType);
+            } else {
+                value = PyDateTimeAPI->Time_FromTime(
+                    hours, mins, secs, usecs, timezone_utc, PyDateTimeAPI->TimeType);
+            }
+        } else if (datetimeMode & DM_IGNORE_TZ || (!hasOffset && !isZ)) {
+            if (hasDate) {
+                value = PyDateTime_FromDateAndTime(year, month, day,
+                                                   hours, mins, secs, usecs);
+            } else {
+                value = PyTime_FromTime(hours, mins, secs, usecs);
+            }
+        } else if (!hasDate && datetimeMode & DM_SHIFT_TO_UTC && tzoff) {
+            PyErr_Format(PyExc_ValueError,
+                         "Time literal cannot be shifted to UTC: %s", str);
+            value = NULL;
+        } else if (!hasDate && datetimeMode & DM_SHIFT_TO_UTC) {
+            value = PyDateTimeAPI->Time_FromTime(
+                hours, mins, secs, usecs, timezone_utc, PyDateTimeAPI->TimeType);
+        } else if (hasDate && datetimeMode & DM_SHIFT_TO_UTC) {
+            if (shift_to_utc(year, month, day, hours, mins, tzoff)) {
+                value = PyDateTimeAPI->DateTime_FromDateAndTime(
+                    year, month, day, hours, mins, secs, usecs, timezone_utc,
+                    PyDateTimeAPI->DateTimeType);
+            } else {
+                PyErr_SetString(PyExc_OverflowError, "date value out of range");
+                value = NULL;
+            }
+        } else {
+            PyObject* tz = timezone_from_offset(tzoff);
+            if (tz == NULL) {
+                value = NULL;
+            } else if (hasDate) {
+                value = PyDateTimeAPI->DateTime_FromDateAndTime(
+                    year, month, day, hours, mins, secs, usecs, tz,
+                    PyDateTimeAPI->DateTimeType);
+            } else {
+                value = PyDateTimeAPI->Time_FromTime(hours, mins, secs, usecs, tz,
+                                                     PyDateTimeAPI->TimeType);
+            }
+        }
+
+        if (value == NULL)
+            return false;
+
+        return Handle(value);
+    }
+
+#undef digit
+
+    bool IsUuid(const char* str, SizeType length) {
+        if (uuidMode == UM_HEX && length == 32) {
+            for (int i = length - 1; i >= 0; --i)
+                if (!isxdigit(str[i]))
+                    return false;
+            return true;
+        } else if (length == 36
+                   && str[8] == '-' && str[13] == '-'
+                   && str[18] == '-' && str[23] == '-') {
+            for (int i = length - 1; i >= 0; --i)
+                if (i != 8 && i != 13 && i != 18 && i != 23 && !isxdigit(str[i]))
+                    return false;
+            return true;
+        }
+        return false;
+    }
+
+    // Build the UUID instance like its constructor does, but without its Python code:
+    // the hex digits, already checked by IsUuid(), are converted to the 128-bit integer
+    // that is stored with the "unknown" safety directly into its slots, bypassing the
+    // UUID.__setattr__() that forbids any change
+
+    bool HandleUuid(const char* str, SizeType length) {
+        uint64_t high = 0, low = 0;
+        int digits = 0;
+
+        for (SizeType i = 0; i < length; i++) {
+            char c = str[i];
+            if (c == '-')
+                continue;
+            unsigned d = c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10;
+            if (digits++ < 16)
+                high = (high << 4) | d;
+            else
+                low = (low << 4) | d;
+        }
+
+        PyObject* intValue = long_from_uint128(high, low);
+        if (intValue == NULL)
+            return false;
+
+        PyTypeObject* type = (PyTypeObject*) uuid_type;
+        PyObject* args = PyTuple_New(0);
+        PyObject* value = args != NULL ? type->tp_new(type, args, NULL) : NULL;
+        Py_XDECREF(args);
+
+        if (value == NULL
+            || PyObject_GenericSetAttr(value, int_name, intValue) < 0
+            || (safe_uuid_unknown != NULL
+                && PyObject_GenericSetAttr(value, is_safe_name, safe_uuid_unknown) < 0)) {
+            Py_DECREF(intValue);
+            Py_XDECREF(value);
+            return false;
+        }
+
+        Py_DECREF(intValue);
+
+        return Handle(value);
+    }
+
+    bool String(const char* str, SizeType length, bool copy) {
+        if (selection != NULL && SkipScalar())
+            return true;
+
+        PyObject* value;
+
+        if (datetimeMode != DM_NONE) {
+            int year, month, day, hours, mins, secs, usecs, tzoff;
+
+            if (IsIso8601(str, length, year, month, day,
+                          hours, mins, secs, usecs, tzoff))
+                return HandleIso8601(str, length, year, month, day,
+                                     hours, mins, secs, usecs, tzoff);
+        }
+
+        if (uuidMode != UM_NONE && IsUuid(str, length))
+            return HandleUuid(str, length);
+
+        value = unicode_from_utf8(str, length);
+        if (value == NULL)
+            return false;
+
+        if (decoderString != NULL) {
+            PyObject* replacement = PyObject_CallFunctionObjArgs(decoderString, value,
+                                                                 NULL);
+            Py_DECREF(value);
+            if (replacement == NULL)
+                return false;
+            value = replacement;
+        }
+
+        return Handle(value);
+    }
+};
+
+
+/* A compact native representation of a parsed JSON document, a "tape" of SAX events
+   that can be recorded without holding the GIL and later replayed into a PyHandler to
+   build the equivalent Python objects. */
+
+enum TapeEntryType {
+    TE_NULL,
+    TE_FALSE,
+    TE_TRUE,
+    TE_INT64,
+    TE_UINT64,
+    TE_DOUBLE,
+    TE_NUMBER,
+    TE_STRING,
+    TE_KEY,
+    TE_START_OBJECT,
+    TE_END_OBJECT,
+    TE_START_ARRAY,
+    TE_END_ARRAY
+};
+
+
+struct TapeEntry {
+    unsigned char type;
+    // The length of strings and raw numbers, or the number of members/elements of
+    // the containers
+    SizeType length;
+    // The stream offset right after the token
+    size_t position;
+    union {
+        int64_t i;
+        uint64_t u;
+        double d;
+        // Where the string starts, either within the tape strings or the insitu buffer
+        size_t offset;
+        // For the start entries, the index of the matching end entry
+        size_t end;
+    } value;
+};
+
+
+struct Tape {
+    std::vector<TapeEntry> entries;
+    // Copies of the transient strings, each followed by a NUL terminator
+    std::vector<char> strings;
+    // The buffer parsed in place, if any, that must outlive the tape
+    char* insitu;
+
+    Tape()
+        : insitu(NULL)
+        {}
+
+    const char* String(const TapeEntry& entry) const {
+        return (insitu != NULL ? insitu : strings.data()) + entry.value.offset;
+    }
+
+    void Clear() {
+        entries.clear();
+        strings.clear();
+        insitu = NULL;
+    }
+};
+
+
+/* This is a SAX handler that records the events into a Tape: it must not touch any
+   Python object, as it runs with the GIL released, nor let an exception escape, so when
+   memory runs out it stops the parse, and the caller raises the MemoryError. */
+
+template <typename InputStream>
+struct TapeHandler {
+    Tape& tape;
+    InputStream& stream;
+    std::vector<size_t> open;
+    unsigned depthLimit;
+    bool tooDeep;
+    bool outOfMemory;
+
+    TapeHandler(Tape& t, InputStream& is, unsigned limit)
+        : tape(t),
+          stream(is),
+          depthLimit(limit),
+          tooDeep(false),
+          outOfMemory(false)
+        {}
+
+    TapeEntry* Append(TapeEntryType type) {
+        try {
+            tape.entries.push_back(TapeEntry());
+        } catch (const std::bad_alloc&) {
+            outOfMemory = true;
+            return NULL;
+        }
+        TapeEntry& entry = tape.entries.back();
+        entry.type = type;
+        entry.length = 0;
+        entry.position = stream.Tell();
+        return &entry;
+    }
+
+    bool AppendString(TapeEntryType type, const char* str, SizeType length, bool copy) {
+        size_t offset;
+        if (copy) {
+            offset = tape.strings.size();
+            try {
+                tape.strings.insert(tape.strings.end(), str, str + length);
+                tape.strings.push_back('\0');
+            } catch (const std::bad_alloc&) {
+                outOfMemory = true;
+                return false;
+            }
+        } else {
+            offset = str - tape.insitu;
+        }
+        TapeEntry* entry = Append(type);
+        if (entry == NULL)
+            return false;
+        entry->length = length;
+        entry->value.offset = offset;
+        return true;
+    }
+
+    bool Null() {
+        return Append(TE_NULL) != NULL;
+    }
+
+    bool Bool(bool b) {
+        return Append(b ? TE_TRUE : TE_FALSE) != NULL;
+    }
+
+    bool Int(int i) {
+        return Int64(i);
+    }
+
+    bool Uint(unsigned i) {
+        return Uint64(i);
+    }
+
+    bool Int64(int64_t i) {
+        TapeEntry* entry = Append(TE_INT64);
+        if (entry == NULL)
+            return false;
+        entry->value.i = i;
+        return true;
+    }
+
+    bool Uint64(uint64_t i) {
+        TapeEntry* entry = Append(TE_UINT64);
+        if (entry == NULL)
+            return false;
+        entry->value.u = i;
+        return true;
+    }
+
+    bool Double(double d) {
+        TapeEntry* entry = Append(TE_DOUBLE);
+        if (entry == NULL)
+            return false;
+        entry->value.d = d;
+        return true;
+    }
+
+    bool RawNumber(const char* str, SizeType length, bool copy) {
+        return AppendString(TE_NUMBER, str, length, copy);
+    }
+
+    bool String(const char* str, SizeType length, bool copy) {
+        return AppendString(TE_STRING, str, length, copy);
+    }
+
+    bool Key(const char* str, SizeType length, bool copy) {
+        return AppendString(TE_KEY, str, length, copy);
+    }
+
+    bool Start(TapeEntryType type) {
+        if (open.size() >= depthLimit) {
+            tooDeep = true;
+            return false;
+        }
+        try {
+            open.push_back(tape.entries.size());
+        } catch (const std::bad_alloc&) {
+            outOfMemory = true;
+            return false;
+        }
+        return Append(type) != NULL;
+    }
+
+    bool End(TapeEntryType type, SizeType count) {
+        tape.entries[open.back()].value.end = tape.entries.size();
+        open.pop_back();
+        TapeEntry* entry = Append(type);
+        if (entry == NULL)
+            return false;
+        entry->length = count;
+        return true;
+    }
+
+    bool StartObject() {
+        return Start(TE_START_OBJECT);
+    }
+
+    bool EndObject(SizeType memberCount) {
+        return End(TE_END_OBJECT, memberCount);
+    }
+
+    bool StartArray() {
+        return Start(TE_START_ARRAY);
+    }
+
+    bool EndArray(SizeType elementCount) {
+        return End(TE_END_ARRAY, elementCount);
+    }
+};
+
+
+/* Replay the entries of the tape between begin and end (excluded) into the handler: in
+   case of error return false, setting position to the offset of the failing token. */
+
+static bool
+replay_tape(const Tape& tape, size_t begin, size_t end, PyHandler& handler,
+            size_t& position)
+{
+    for (size_t i = begin; i < end; i++) {
+        const TapeEntry& entry = tape.entries[i];
+        bool ok;
+
+        switch (entry.type) {
+        case TE_NULL:
+            ok = handler.Null();
+            break;
+        case TE_FALSE:
+            ok = handler.Bool(false);
+            break;
+        case TE_TRUE:
+            ok = handler.Bool(true);
+            break;
+        case TE_INT64:
+            ok = handler.Int64(entry.value.i);
+            break;
+        case TE_UINT64:
+            ok = handler.Uint64(entry.value.u);
+            break;
+        case TE_DOUBLE:
+            ok = handler.Double(entry.value.d);
+            break;
+        case TE_NUMBER:
+            ok = handler.RawNumber(tape.String(entry), entry.length, false);
+            break;
+        case TE_STRING:
+            ok = handler.String(tape.String(entry), entry.length, false);
+            break;
+        case TE_KEY:
+            ok = handler.Key(tape.String(entry), entry.length, false);
+            break;
+        case TE_START_OBJECT:
+            ok = handler.StartObject();
+            break;
+        case TE_END_OBJECT:
+            ok = handler.EndObject(entry.length);
+            break;
+        case TE_START_ARRAY:
+            ok = handler.StartArray();
+            break;
+        case TE_END_ARRAY:
+            ok = handler.EndArray(entry.length);
+            break;
+        default:
+            ok = false;
+            PyErr_SetString(PyExc_SystemError, "Unexpected tape entry");
+            break;
+        }
+
+        if (!ok) {
+            position = entry.position;
+            return false;
+        }
+    }
+    return true;
+}
+
+
+typedef struct {
+    PyObject_HEAD
+    unsigned datetimeMode;
+    unsigned uuidMode;
+    unsigned numberMode;
+    unsigned parseMode;
+    unsigned keyCacheSize;
+    KeyCache* keyCache;
+    Selection* selection;
+    bool releaseGil;
+} DecoderObject;
+
+
+PyDoc_STRVAR(loads_docstring,
+             "loads(string, *, object_hook=None, number_mode=None, datetime_mode=None,"
+             " uuid_mode=None, parse_mode=None, release_gil=False, select=None,"
+             " destructive=False, allow_nan=True)\n"
+             "\n"
+             "Decode a JSON string into a Python object.");
+
+
+static PyObject*
+loads(PyObject* self, PyObject* args, PyObject* kwargs)
+{
+    /* Converts a JSON encoded string to a Python object. */
+
+    static char const* kwlist[] = {
+        "string",
+        "object_hook",
+        "number_mode",
+        "datetime_mode",
+        "uuid_mode",
+        "parse_mode",
+        "release_gil",
+        "select",
+        "destructive",
+
+        /* compatibility with stdlib json */
+        "allow_nan",
+
+        NULL
+    };
+    PyObject* jsonObject;
+    PyObject* objectHook = NULL;
+    PyObject* datetimeModeObj = NULL;
+    unsigned datetimeMode = DM_NONE;
+    PyObject* uuidModeObj = NULL;
+    unsigned uuidMode = UM_NONE;
+    PyObject* numberModeObj = NULL;
+    unsigned numberMode = NM_NAN;
+    PyObject* parseModeObj = NULL;
+    unsigned parseMode = PM_NONE;
+    int allowNan = -1;
+    int releaseGil = false;
+    PyObject* selectObj = NULL;
+    int destructive = false;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|$OOOOOpOpp:rapidjson.loads",
+                                     (char**) kwlist,
+                                     &jsonObject,
+                                     &objectHook,
+                                     &numberModeObj,
+                                     &datetimeModeObj,
+                                     &uuidModeObj,
+                                     &parseModeObj,
+                                     &releaseGil,
+                                     &selectObj,
+                                     &destructive,
+                                     &allowNan))
+        return NULL;
+
+    if (objectHook && !PyCallable_Check(objectHook)) {
+        if (objectHook == Py_None) {
+            objectHook = NULL;
+        } else {
+            PyErr_SetString(PyExc_TypeError, "object_hook is not callable");
+            return NULL;
+        }
+    }
+
+    if (!accept_number_mode_arg(numberModeObj, allowNan, numberMode))
+        return NULL;
+    if (numberMode & NM_DECIMAL && numberMode & NM_NATIVE) {
+        PyErr_SetString(PyExc_ValueError,
+                        "Invalid number_mode, combining NM_NATIVE with NM_DECIMAL"
+                        " is not supported");
+        return NULL;
+    }
+
+    if (!accept_datetime_mode_arg(datetimeModeObj, datetimeMode))
+        return NULL;
+    if (datetimeMode && datetime_mode_format(datetimeMode) != DM_ISO8601) {
+        PyErr_SetString(PyExc_ValueError,
+                        "Invalid datetime_mode, can deserialize only from"
+                        " ISO8601");
+        return NULL;
+    }
+
+    if (!accept_uuid_mode_arg(uuidModeObj, uuidMode))
+        return NULL;
+
+    if (!accept_parse_mode_arg(parseModeObj, parseMode))
+        return NULL;
+
+    Py_ssize_t jsonStrLen;
+    const char* jsonStr;
+    Py_buffer view;
+    bool fromBuffer = false;
+
+    if (destructive) {
+        // Only mutable objects may be parsed in place, clobbering their content
+
+        if (!PyByteArray_Check(jsonObject) && !PyMemoryView_Check(jsonObject)) {
+            PyErr_SetString(PyExc_TypeError,
+                            "Destructive parsing requires a bytearray or a writable"
+                            " memoryview");
+            return NULL;
+        }
+        if (PyObject_GetBuffer(jsonObject, &view, PyBUF_WRITABLE) < 0)
+            return NULL;
+        jsonStr = (const char*) view.buf;
+        jsonStrLen = view.len;
+        fromBuffer = true;
+    } else if (PyUnicode_Check(jsonObject)) {
+        jsonStr = PyUnicode_AsUTF8AndSize(jsonObject, &jsonStrLen);
+        if (jsonStr == NULL) {
+            return NULL;
+        }
+    } else if (PyObject_CheckBuffer(jsonObject)) {
+        if (PyObject_GetBuffer(jsonObject, &view, PyBUF_SIMPLE) < 0)
+            return NULL;
+        jsonStr = (const char*) view.buf;
+        jsonStrLen = view.len;
+        fromBuffer = true;
+    } else {
+        PyErr_SetString(PyExc_TypeError,
+                        "Expected string or UTF-8 encoded bytes-like object");
+        return NULL;
+    }
+
+    Selection* selection;
+
+    if (!accept_select_arg(selectObj, selection)) {
+        if (fromBuffer)
+            PyBuffer_Release(&view);
+        return NULL;
+    }
+
+    PyObject* result = do_decode(NULL, jsonStr, jsonStrLen, fromBuffer, destructive,
+                                 NULL, 0, objectHook, numberMode, datetimeMode,
+                                 uuidMode, parseMode, releaseGil, selection);
+
+    delete selection;
+
+    if (fromBuffer)
+        PyBuffer_Release(&view);
+
+    return result;
+}
+
+
+PyDoc_STRVAR(load_docstring,
+             "load(stream, *, object_hook=None, number_mode=None, datetime_mode=None,"
+             " uuid_mode=None, parse_mode=None, chunk_size=65536, select=None,"
+             " allow_nan=True)\n"
+             "\n"
+             "Decode a JSON stream into a Python object.");
+
+
+static PyObject*
+load(PyObject* self, PyObject* args, PyObject* kwargs)
+{
+    /* Converts a JSON encoded stream to a Python object. */
+
+    static char const* kwlist[] = {
+        "stream",
+        "object_hook",
+        "number_mode",
+        "datetime_mode",
+        "uuid_mode",
+        "parse_mode",
+        "chunk_size",
+        "select",
+
+        /* compatibility with stdlib json */
+        "allow_nan",
+
+        NULL
+    };
+    PyObject* jsonObject;
+    PyObject* objectHook = NULL;
+    PyObject* datetimeModeObj = NULL;
+    unsigned datetimeMode = DM_NONE;
+    PyObject* uuidModeObj = NULL;
+    unsigned uuidMode = UM_NONE;
+    PyObject* numberModeObj = NULL;
+    unsigned numberMode = NM_NAN;
+    PyObject* parseModeObj = NULL;
+    unsigned parseMode = PM_NONE;
+    PyObject* chunkSizeObj = NULL;
+    size_t chunkSize = 65536;
+    int allowNan = -1;
+    PyObject* selectObj = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|$OOOOOOOp:rapidjson.load",
+                                     (char**) kwlist,
+                                     &jsonObject,
+                                     &objectHook,
+                                     &numberModeObj,
+                                     &datetimeModeObj,
+                                     &uuidModeObj,
+                                     &parseModeObj,
+                                     &chunkSizeObj,
+                                     &selectObj,
+                                     &allowNan))
+        return NULL;
+
+    if (!PyObject_HasAttr(jsonObject, read_name)) {
+        PyErr_SetString(PyExc_TypeError, "Expected file-like object");
+        return NULL;
+    }
+
+    if (objectHook && !PyCallable_Check(objectHook)) {
+        if (objectHook == Py_None) {
+            objectHook = NULL;
+        } else {
+            PyErr_SetString(PyExc_TypeError, "object_hook is not callable");
+            return NULL;
+        }
+    }
+
+    if (numberModeObj) {
+        if (numberModeObj == Py_None) {
+            numberMode = NM_NONE;
+        } else if (PyLong_Check(numberModeObj)) {
+            int mode = PyLong_AsLong(numberModeObj);
+            if (mode < 0 || mode >= NM_MAX) {
+                PyErr_SetString(PyExc_ValueError, "Invalid number_mode");
+                return NULL;
+            }
+            numberMode = (unsigned) mode;
+            if (numberMode & NM_DECIMAL && numberMode & NM_NATIVE) {
+                PyErr_SetString(PyExc_ValueError,
+                                "Combining NM_NATIVE with NM_DECIMAL is not supported");
+                return NULL;
+            }
+        }
+    }
+    if (allowNan != -1) {
+        if (allowNan)
+            numberMode |= NM_NAN;
+        else
+            numberMode &= ~NM_NAN;
+    }
+
+    if (datetimeModeObj) {
+        if (datetimeModeObj == Py_None) {
+            datetimeMode = DM_NONE;
+        } else if (PyLong_Check(datetimeModeObj)) {
+            int mode = PyLong_AsLong(datetimeModeObj);
+            if (!valid_datetime_mode(mode)) {
+                PyErr_SetString(PyExc_ValueError, "Invalid datetime_mode");
+                return NULL;
+            }
+            datetimeMode = (unsigned) mode;
+            if (datetimeMode && datetime_mode_format(datetimeMode) != DM_ISO8601) {
+                PyErr_SetString(PyExc_ValueError,
+                                "Invalid datetime_mode, can deserialize only from"
+                                " ISO8601");
+                return NULL;
+            }
+        } else {
+            PyErr_SetString(PyExc_TypeError,
+                            "datetime_mode must be a non-negative integer value or None");
+            return NULL;
+        }
+    }
+
+    if (uuidModeObj) {
+        if (uuidModeObj == Py_None) {
+            uuidMode = UM_NONE;
+        } else if (PyLong_Check(uuidModeObj)) {
+            int mode = PyLong_AsLong(uuidModeObj);
+            if (mode < 0 || mode >= UM_MAX) {
+                PyErr_SetString(PyExc_ValueError, "Invalid uuid_mode");
+                return NULL;
+            }
+            uuidMode = (unsigned) mode;
+        } else {
+            PyErr_SetString(PyExc_TypeError,
+                            "uuid_mode must be an integer value or None");
+            return NULL;
+        }
+    }
+
+    if (parseModeObj) {
+        if (parseModeObj == Py_None) {
+            parseMode = PM_NONE;
+        } else if (PyLong_Check(parseModeObj)) {
+            int mode = PyLong_AsLong(parseModeObj);
+            if (mode < 0 || mode >= PM_MAX) {
+                PyErr_SetString(PyExc_ValueError, "Invalid parse_mode");
+                return NULL;
+            }
+            parseMode = (unsigned) mode;
+        } else {
+            PyErr_SetString(PyExc_TypeError,
+                            "parse_mode must be an integer value or None");
+            return NULL;
+        }
+    }
+
+    if (chunkSizeObj && chunkSizeObj != Py_None) {
+        if (PyLong_Check(chunkSizeObj)) {
+            Py_ssize_t size = PyNumber_AsSsize_t(chunkSizeObj, PyExc_ValueError);
+            if (PyErr_Occurred() || size < 4 || size > UINT_MAX) {
+                PyErr_SetString(PyExc_ValueError,
+                                "Invalid chunk_size, must be an integer between 4 and"
+                                " UINT_MAX");
+                return NULL;
+            }
+            chunkSize = (size_t) size;
+        } else {
+            PyErr_SetString(PyExc_TypeError,
+                            "chunk_size must be an unsigned integer value or None");
+            return NULL;
+        }
+    }
+
+    Selection* selection;
+
+    if (!accept_select_arg(selectObj, selection))
+        return NULL;
+
+    PyObject* result = do_decode(NULL, NULL, 0, false, false, jsonObject, chunkSize,
+                                 objectHook, numberMode, datetimeMode, uuidMode,
+                                 parseMode, false, selection);
+
+    delete selection;
+
+    return result;
+}
+
+
+/* A read-only memory mapping of a whole file, hinted for sequential access. On POSIX
+   systems, files that cannot be mapped, like pipes, are read into memory instead. */
+
+struct MappedFile {
+    const char* data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE mapping;
+#else
+    // The contents read from a file that is not mapped, if any
+    char* contents;
+#endif
+
+    MappedFile()
+        : data(NULL),
+          size(0)
+#ifdef _WIN32
+          , mapping(NULL)
+#else
+          , contents(NULL)
+#endif
+        {}
+
+    ~MappedFile() {
+#ifdef _WIN32
+        if (mapping != NULL) {
+            if (data != NULL)
+                UnmapViewOfFile(data);
+            CloseHandle(mapping);
+        }
+#else
+        if (contents != NULL)
+            PyMem_RawFree(contents);
+        else if (data != NULL && size != 0)
+            munmap((void*) data, size);
+#endif
+    }
+
+    // Map the file at the given path-like object, setting an OSError on failure
+
+    bool Open(PyObject* path) {
+#ifdef _WIN32
+        PyObject* decoded;
+
+        if (!PyUnicode_FSDecoder(path, &decoded))
+            return false;
+
+        wchar_t* wpath = PyUnicode_AsWideCharString(decoded, NULL);
+        if (wpath == NULL) {
+            Py_DECREF(decoded);
+            return false;
+        }
+
+        HANDLE file;
+        LARGE_INTEGER fileSize;
+        bool ok = false;
+
+        Py_BEGIN_ALLOW_THREADS
+        file = CreateFileW(wpath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                           FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file != INVALID_HANDLE_VALUE) {
+            if (GetFileSizeEx(file, &fileSize)) {
+                size = (size_t) fileSize.QuadPart;
+                if (size == 0) {
+                    data = "";
+                    ok = true;
+                } else {
+                    mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+                    if (mapping != NULL) {
+                        data = (const char*) MapViewOfFile(mapping, FILE_MAP_READ,
+                                                           0, 0, 0);
+                        ok = data != NULL;
+                    }
+                }
+            }
+        }
+        Py_END_ALLOW_THREADS
+
+        if (!ok)
+            PyErr_SetExcFromWindowsErrWithFilenameObject(PyExc_OSError, 0, decoded);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+
+        PyMem_Free(wpath);
+        Py_DECREF(decoded);
+
+        return ok;
+#else
+        PyObject* encoded;
+
+        if (!PyUnicode_FSConverter(path, &encoded))
+            return false;
+
+        const char* cpath = PyBytes_AS_STRING(encoded);
+        int fd;
+        int error = 0;
+        struct stat info;
+        void* address = MAP_FAILED;
+
+        Py_BEGIN_ALLOW_THREADS
+        fd = open(cpath, O_RDONLY);
+        if (fd < 0)
+            error = errno;
+        else if (fstat(fd, &info) < 0)
+            error = errno;
+        else if (S_ISDIR(info.st_mode))
+            error = EISDIR;
+        else if (!S_ISREG(info.st_mode) || info.st_size == 0)
+            // Pipes and character devices cannot be mapped, and pseudo files like the
+            // ones under /proc report a zero size: read them until the end instead
+            error = Read(fd);
+        else {
+            address = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (address == MAP_FAILED)
+                error = errno;
+#ifdef MADV_SEQUENTIAL
+            else
+                madvise(address, (size_t) info.st_size, MADV_SEQUENTIAL);
+#endif
+        }
+        if (fd >= 0)
+            close(fd);
+        Py_END_ALLOW_THREADS
+
+        if (error != 0) {
+            errno = error;
+            PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, path);
+            Py_DECREF(encoded);
+            return false;
+        }
+
+        Py_DECREF(encoded);
+
+        if (address != MAP_FAILED) {
+            data = (const char*) address;
+            size = (size_t) info.st_size;
+        } else
+            data = contents;
+
+        return true;
+#endif
+    }
+
+#ifndef _WIN32
+    // Read the whole file with the GIL released, returning an errno value on failure
+
+    int Read(int fd) {
+        size_t capacity = 0;
+
+        size = 0;
+        for (;;) {
+            if (size == capacity) {
+                capacity = capacity != 0 ? capacity * 2 : 65536;
+                char* grown = (char*) PyMem_RawRealloc(contents, capacity);
+                if (grown == NULL)
+                    return ENOMEM;
+                contents = grown;
+            }
+
+            ssize_t count = read(fd, contents + size, capacity - size);
+            if (count < 0) {
+                if (errno == EINTR)
+                    continue;
+                return errno;
+            } else if (count == 0)
+                return 0;
+            size += (size_t) count;
+        }
+    }
+#endif
+};
+
+
+PyDoc_STRVAR(load_file_docstring,
+             "load_file(path, *, object_hook=None, number_mode=None, datetime_mode=None,"
+             " uuid_mode=None, parse_mode=None, release_gil=False, select=None,"
+             " allow_nan=True)\n"
+             "\n"
+             "Decode the JSON file at the given path into a Python object, parsing it"
+             " directly from a memory mapping.");
+
+
+static PyObject*
+load_file(PyObject* self, PyObject* args, PyObject* kwargs)
+{
+    static char const* kwlist[] = {
+        "path",
+        "object_hook",
+        "number_mode",
+        "datetime_mode",
+        "uuid_mode",
+        "parse_mode",
+        "release_gil",
+        "select",
+
+        /* compatibility with stdlib json */
+        "allow_nan",
+
+        NULL
+    };
+    PyObject* path;
+    PyObject* objectHook = NULL;
+    PyObject* datetimeModeObj = NULL;
+    unsigned datetimeMode = DM_NONE;
+    PyObject* uuidModeObj = NULL;
+    unsigned uuidMode = UM_NONE;
+    PyObject* numberModeObj = NULL;
+    unsigned numberMode = NM_NAN;
+    PyObject* parseModeObj = NULL;
+    unsigned parseMode = PM_NONE;
+    int allowNan = -1;
+    int releaseGil = false;
+    PyObject* selectObj = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|$OOOOOpOp:rapidjson.load_file",
+                                     (char**) kwlist,
+                                     &path,
+                                     &objectHook,
+                                     &numberModeObj,
+                                     &datetimeModeObj,
+                                     &uuidModeObj,
+                                     &parseModeObj,
+                                     &releaseGil,
+                                     &selectObj,
+                                     &allowNan))
+        return NULL;
+
+    if (objectHook && !PyCallable_Check(objectHook)) {
+        if (objectHook == Py_None) {
+            objectHook = NULL;
+        } else {
+            PyErr_SetString(PyExc_TypeError, "object_hook is not callable");
+            return NULL;
+        }
+    }
+
+    if (!accept_number_mode_arg(numberModeObj, allowNan, numberMode))
+        return NULL;
+    if (numberMode & NM_DECIMAL && numberMode & NM_NATIVE) {
+        PyErr_SetString(PyExc_ValueError,
+                        "Invalid number_mode, combining NM_NATIVE with NM_DECIMAL"
+                        " is not supported");
+        return NULL;
+    }
+
+    if (!accept_datetime_mode_arg(datetimeModeObj, datetimeMode))
+        return NULL;
+    if (datetimeMode && datetime_mode_format(datetimeMode) != DM_ISO8601) {
+        PyErr_SetString(PyExc_ValueError,
+                        "Invalid datetime_mode, can deserialize only from"
+                        " ISO8601");
+        return NULL;
+    }
+
+    if (!accept_uuid_mode_arg(uuidModeObj, uuidMode))
+        return NULL;
+
+    if (!accept_parse_mode_arg(parseModeObj, parseMode))
+        return NULL;
+
+    Selection* selection;
+
+    if (!accept_select_arg(selectObj, selection))
+        return NULL;
+
+    MappedFile file;
+    PyObject* result = NULL;
+
+    // The mapping is parsed like a bytes-like object, validating its UTF-8 encoding
+
+    if (file.Open(path))
+        result = do_decode(NULL, file.data, file.size, true, false, NULL, 0,
+                           objectHook, numberMode, datetimeMode, uuidMode, parseMode,
+                           releaseGil, selection);
+
+    delete selection;
+
+    return result;
+}
+
+
+PyDoc_STRVAR(decoder_doc,
+             "Decoder(number_mode=None, datetime_mode=None, uuid_mode=None,"
+             " parse_mode=None, key_cache_size=None, release_gil=False, select=None)\n"
+             "\n"
+             "Create and return a new Decoder instance.");
+
+
+static PyMemberDef decoder_members[] = {
+    {"datetime_mode",
+     T_UINT, offsetof(DecoderObject, datetimeMode), READONLY,
+     "The datetime mode, whether and how datetime literals will be recognized."},
+    {"uuid_mode",
+     T_UINT, offsetof(DecoderObject, uuidMode), READONLY,
+     "The UUID mode, whether and how UUID literals will be recognized."},
+    {"number_mode",
+     T_UINT, offsetof(DecoderObject, numberMode), READONLY,
+     "The number mode, whether numeric literals will be decoded."},
+    {"parse_mode",
+     T_UINT, offsetof(DecoderObject, parseMode), READONLY,
+     "The parse mode, whether comments and trailing commas are allowed."},
+    {"key_cache_size",
+     T_UINT, offsetof(DecoderObject, keyCacheSize), READONLY,
+     "The maximum number of object keys shared across calls, 0 when disabled."},
+    {"release_gil",
+     T_BOOL, offsetof(DecoderObject, releaseGil), READONLY,
+     "Whether strings are parsed with the GIL released."},
+    {NULL}
+};
+
+
+static void
+decoder_dealloc(PyObject* self)
+{
+    DecoderObject* d = (DecoderObject*) self;
+
+    delete d->keyCache;
+    delete d->selection;
+    Py_TYPE(self)->tp_free(self);
+}
+
+
+PyDoc_STRVAR(decoder_iter_docstring,
+             "iter(json, *, chunk_size=65536)\n"
+             "\n"
+             "Return an iterator over the sequence of JSON values in a string, a"
+             " bytes-like object or a stream.");
+
+
+PyDoc_STRVAR(decoder_load_file_docstring,
+             "load_file(path)\n"
+             "\n"
+             "Decode the JSON file at the given path, parsing it directly from a memory"
+             " mapping.");
+
+
+PyDoc_STRVAR(decoder_loads_many_docstring,
+             "loads_many(jsons)\n"
+             "\n"
+             "Decode each string or bytes-like object of the given iterable, returning"
+             " the list of the resulting values.");
+
+
+static PyMethodDef decoder_methods[] = {
+    {"iter", (PyCFunction) decoder_iter, METH_VARARGS | METH_KEYWORDS,
+     decoder_iter_docstring},
+    {"loads_many", (PyCFunction) decoder_loads_many, METH_O,
+     decoder_loads_many_docstring},
+    {"load_file", (PyCFunction) decoder_load_file, METH_O,
+     decoder_load_file_docstring},
+    {NULL, NULL, 0, NULL}                     /* sentinel */
+};
+
+
+static PyTypeObject Decoder_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "rapidjson.Decoder",                      /* tp_name */
+    sizeof(DecoderObject),                    /* tp_basicsize */
+    0,                                        /* tp_itemsize */
+    (destructor) decoder_dealloc,             /* tp_dealloc */
+    0,                                        /* tp_print */
+    0,                                        /* tp_getattr */
+    0,                                        /* tp_setattr */
+    0,                                        /* tp_compare */
+    0,                                        /* tp_repr */
+    0,                                        /* tp_as_number */
+    0,                                        /* tp_as_sequence */
+    0,                                        /* tp_as_mapping */
+    0,                                        /* tp_hash */
+    (ternaryfunc) decoder_call,               /* tp_call */
+    0,                                        /* tp_str */
+    0,                                        /* tp_getattro */
+    0,                                        /* tp_setattro */
+    0,                                        /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE, /* tp_flags */
+    decoder_doc,                              /* tp_doc */
+    0,                                        /* tp_traverse */
+    0,                                        /* tp_clear */
+    0,                                        /* tp_richcompare */
+    0,                                        /* tp_weaklistoffset */
+    0,                                        /* tp_iter */
+    0,                                        /* tp_iternext */
+    decoder_methods,                          /* tp_methods */
+    decoder_members,                          /* tp_members */
+    0,                                        /* tp_getset */
+    0,                                        /* tp_base */
+    0,                                        /* tp_dict */
+    0,                                        /* tp_descr_get */
+    0,                                        /* tp_descr_set */
+    0,                                        /* tp_dictoffset */
+    0,                                        /* tp_init */
+    0,                                        /* tp_alloc */
+    decoder_new,                              /* tp_new */
+    PyObject_Del,                             /* tp_free */
+};
+
+
+#define Decoder_CheckExact(v) (Py_TYPE(v) == &Decoder_Type)
+#define Decoder_Check(v) PyObject_TypeCheck(v, &Decoder_Type)
+
+
+/* RapidJSON selects the features of its reader at compile time, by means of the flags
+   template argument of Reader::Parse<>() and Reader::IterativeParseNext<>():
+   decode_with_flags() and parse_next_with_flags() dispatch the runtime flags to a table
+   with one instance for each combination of the optional ones that the caller can reach,
+   indexed by a bitmask with one bit for each of them.
+
+   Since every instance is a whole copy of the parser, the rarely used modes are kept out
+   of the tables: full precision is obtained by converting the numbers as strings, see
+   reader_flags(), and the check that nothing follows the document is done outside of the
+   parser, see check_document_end(). */
+
+static const unsigned commonReaderFlags = (kParseNumbersAsStringsFlag
+                                           | kParseNanAndInfFlag
+                                           | kParseCommentsFlag
+                                           | kParseTrailingCommasFlag);
+
+
+/* Compute the reader flags for the given modes: in NM_NATIVE mode full precision is
+   obtained by converting the numbers from their text, as in the other modes. */
+
+static unsigned
+reader_flags(unsigned numberMode, unsigned parseMode)
+{
+    unsigned flags = 0;
+
+    if (!(numberMode & NM_NATIVE) || parseMode & PM_FULL_PRECISION)
+        flags |= kParseNumbersAsStringsFlag;
+    if (numberMode & NM_NAN)
+        flags |= kParseNanAndInfFlag;
+    if (parseMode & PM_COMMENTS)
+        flags |= kParseCommentsFlag;
+    if (parseMode & PM_TRAILING_COMMAS)
+        flags |= kParseTrailingCommasFlag;
+    if (parseMode & PM_VALIDATE_ENCODING)
+        flags |= kParseValidateEncodingFlag;
+    if (parseMode & PM_STOP_WHEN_DONE)
+        flags |= kParseStopWhenDoneFlag;
+
+    return flags;
+}
+
+
+/* The operations that can be dispatched: parsing a whole document, or advancing a pull
+   parser by a single token. */
+
+struct FullParse {
+    template <unsigned flags, typename InputStream, typename Handler>
+    static bool Run(Reader& reader, InputStream& stream, Handler& handler) {
+        return !reader.Parse<flags>(stream, handler).IsError();
+    }
+};
+
+
+struct IterativeParseStep {
+    template <unsigned flags, typename InputStream, typename Handler>
+    static bool Run(Reader& reader, InputStream& stream, Handler& handler) {
+        return reader.IterativeParseNext<flags>(stream, handler);
+    }
+};
+
+
+/* The baseFlags are always set, while only the optionalFlags are taken from the runtime
+   flags: any other is either irrelevant for the input stream or handled by the caller. */
+
+template <unsigned baseFlags, unsigned optionalFlags, typename InputStream,
+          typename Handler, typename Operation>
+struct ReaderDispatcher {
+    typedef bool (*ParseFunction)(Reader&, InputStream&, Handler&);
+
+    static constexpr unsigned CountFlags(unsigned mask) {
+        return mask == 0 ? 0 : 1 + CountFlags(mask & (mask - 1));
+    }
+
+    static const unsigned size = 1 << CountFlags(optionalFlags);
+
+    // The optional flags selected by the given index, the lowest bit selecting the
+    // lowest flag
+
+    static constexpr unsigned IndexFlags(unsigned index, unsigned mask = optionalFlags) {
+        return (mask == 0
+                ? 0
+                : ((index & 1) ? mask & (~mask + 1) : 0)
+                  | IndexFlags(index >> 1, mask & (mask - 1)));
+    }
+
+    template <unsigned flags>
+    static bool Parse(Reader& reader, InputStream& stream, Handler& handler) {
+        return Operation::template Run<baseFlags | flags>(reader, stream, handler);
+    }
+
+    template <unsigned index, bool last = index == 0>
+    struct Filler {
+        static void Fill(ParseFunction* table) {
+            table[index] = &Parse<IndexFlags(index)>;
+            Filler<index - 1>::Fill(table);
+        }
+    };
+
+    template <unsigned index>
+    struct Filler<index, true> {
+        static void Fill(ParseFunction* table) {
+            table[index] = &Parse<IndexFlags(index)>;
+        }
+    };
+
+    struct Table {
+        ParseFunction functions[size];
+
+        Table() {
+            Filler<size - 1>::Fill(functions);
+        }
+    };
+
+    static bool Dispatch(Reader& reader, unsigned flags,
+                         InputStream& stream, Handler& handler) {
+        static const Table table;
+
+        unsigned index = 0;
+        unsigned bit = 0;
+        for (unsigned mask = optionalFlags; mask != 0; mask &= mask - 1, bit++)
+            if (flags & mask & (~mask + 1))
+                index |= 1 << bit;
+
+        return table.functions[index](reader, stream, handler);
+    }
+};
+
+
+/* Record a parse error detected outside of the reader, thru the protected method it uses
+   for its own ones. */
+
+struct ReaderErrorSetter : Reader {
+    static void Set(Reader& reader, ParseErrorCode code, size_t offset) {
+        void (Reader::*setParseError)(ParseErrorCode, size_t) =
+            &ReaderErrorSetter::SetParseError;
+        (reader.*setParseError)(code, offset);
+    }
+};
+
+
+/* Check that only whitespace, and comments when allowed, follows the document parsed
+   with kParseStopWhenDoneFlag, setting the same error of the reader otherwise. */
+
+template <typename InputStream>
+static bool
+check_document_end(Reader& reader, InputStream& stream, bool comments)
+{
+    for (;;) {
+        SkipWhitespace(stream);
+
+        if (!comments || stream.Peek() != '/')
+            break;
+
+        stream.Take();
+        if (stream.Peek() == '*') {
+            stream.Take();
+            for (;;) {
+                char c = stream.Peek();
+                if (c == '\0') {
+                    ReaderErrorSetter::Set(reader, kParseErrorUnspecificSyntaxError,
+                                           stream.Tell());
+                    return false;
+                }
+                stream.Take();
+                if (c == '*' && stream.Peek() == '/') {
+                    stream.Take();
+                    break;
+                }
+            }
+        } else if (stream.Peek() == '/') {
+            while (stream.Peek() != '\0' && stream.Take() != '\n') {}
+        } else {
+            ReaderErrorSetter::Set(reader, kParseErrorUnspecificSyntaxError,
+                                   stream.Tell());
+            return false;
+        }
+    }
+
+    if (stream.Peek() != '\0') {
+        ReaderErrorSetter::Set(reader, kParseErrorDocumentRootNotSingular, stream.Tell());
+        return false;
+    }
+
+    return true;
+}
+
+
+/* The parser always stops at the end of the document, and when kParseStopWhenDoneFlag is
+   not given the rest of the input is checked afterwards. */
+
+template <unsigned baseFlags, unsigned optionalFlags, typename InputStream,
+          typename Handler>
+static inline bool
+decode_with_flags(Reader& reader, unsigned flags, InputStream& stream, Handler& handler)
+{
+    bool ok = ReaderDispatcher<baseFlags | kParseStopWhenDoneFlag, optionalFlags,
+                               InputStream, Handler,
+                               FullParse>::Dispatch(reader, flags, stream, handler);
+
+    if (ok && !(flags & kParseStopWhenDoneFlag))
+        ok = check_document_end(reader, stream, flags & kParseCommentsFlag);
+
+    return ok;
+}
+
+
+template <unsigned baseFlags, unsigned optionalFlags, typename InputStream,
+          typename Handler>
+static inline bool
+parse_next_with_flags(Reader& reader, unsigned flags, InputStream& stream,
+                      Handler& handler)
+{
+    return ReaderDispatcher<baseFlags, optionalFlags, InputStream, Handler,
+                            IterativeParseStep>::Dispatch(reader, flags, stream, handler);
+}
+
+
+/* Set the exception for a parse error at the given offset: when the failure was caused
+   by an exception raised while handling the data add the offset to its message, otherwise
+   raise a JSONDecodeError explaining the error code. */
+
+static void
+set_parse_error(size_t offset, ParseErrorCode code)
+{
+    if (PyErr_Occurred()) {
+        PyObject* etype;
+        PyObject* evalue;
+        PyObject* etraceback;
+        PyErr_Fetch(&etype, &evalue, &etraceback);
+
+        // Try to add the offset in the error message if the exception
+        // value is a string.  Otherwise, use the original exception since
+        // we can't be sure the exception type takes a single string.
+        if (evalue != NULL && PyUnicode_Check(evalue)) {
+            PyErr_Format(etype, "Parse error at offset %zu: %S", offset, evalue);
+            Py_DECREF(etype);
+            Py_DECREF(evalue);
+            Py_XDECREF(etraceback);
+        }
+        else
+            PyErr_Restore(etype, evalue, etraceback);
+    }
+    else
+        PyErr_Format(decode_error, "Parse error at offset %zu: %s",
+                     offset, GetParseError_En(code));
+}
+
+
+/* An input stream that parses a writable buffer in place, like InsituStringStream, but
+   bounded by its length instead of by a NUL terminator. */
+
+struct InsituMemoryStream {
+    typedef char Ch;
+
+    InsituMemoryStream(char* src, size_t length)
+        : src(src),
+          dst(NULL),
+          head(src),
+          end(src + length)
+        {}
+
+    Ch Peek() const { return src == end ? '\0' : *src; }
+    Ch Take() { return src == end ? '\0' : *src++; }
+    size_t Tell() const { return static_cast<size_t>(src - head); }
+
+    Ch* PutBegin() { return dst = src; }
+    void Put(Ch c) { *dst++ = c; }
+    size_t PutEnd(Ch* begin) { return static_cast<size_t>(dst - begin); }
+    void Flush() {}
+
+    Ch* src;
+    Ch* dst;
+    Ch* head;
+    Ch* end;
+};
+
+
+/* Parse the string into the tape with the GIL released: when tape.insitu is set, that
+   is either the NUL-terminated copy of the string or, when destructive is true, the
+   caller's writable buffer, that gets parsed in place. In case of error set the exception
+   and return false. */
+
+static bool
+parse_into_tape(Tape& tape, const char* jsonStr, Py_ssize_t jsonStrLen, bool destructive,
+                unsigned numberMode, unsigned parseMode, unsigned depthLimit)
+{
+    Reader reader;
+    unsigned flags = reader_flags(numberMode, parseMode);
+    bool tooDeep;
+    bool outOfMemory;
+
+    if (destructive) {
+        InsituMemoryStream ims(tape.insitu, jsonStrLen);
+        TapeHandler<InsituMemoryStream> th(tape, ims, depthLimit);
+
+        Py_BEGIN_ALLOW_THREADS
+        decode_with_flags<kParseInsituFlag | kParseValidateEncodingFlag,
+                          commonReaderFlags>(reader, flags, ims, th);
+        Py_END_ALLOW_THREADS
+
+        tooDeep = th.tooDeep;
+        outOfMemory = th.outOfMemory;
+    } else if (tape.insitu != NULL) {
+        InsituStringStream ss(tape.insitu);
+        TapeHandler<InsituStringStream> th(tape, ss, depthLimit);
+
+        Py_BEGIN_ALLOW_THREADS
+        decode_with_flags<kParseInsituFlag, commonReaderFlags>(reader, flags, ss, th);
+        Py_END_ALLOW_THREADS
+
+        tooDeep = th.tooDeep;
+        outOfMemory = th.outOfMemory;
+    } else {
+        MemoryStream ms(jsonStr, jsonStrLen);
+        TapeHandler<MemoryStream> th(tape, ms, depthLimit);
+
+        Py_BEGIN_ALLOW_THREADS
+        decode_with_flags<kParseValidateEncodingFlag, commonReaderFlags>(reader, flags,
+                                                                         ms, th);
+        Py_END_ALLOW_THREADS
+
+        tooDeep = th.tooDeep;
+        outOfMemory = th.outOfMemory;
+    }
+
+    if (reader.HasParseError()) {
+        if (outOfMemory) {
+            PyErr_NoMemory();
+            return false;
+        }
+        if (tooDeep)
+            PyErr_SetString(PyExc_RecursionError,
+                            "Maximum parse recursion depth exceeded");
+        set_parse_error(reader.GetErrorOffset(), reader.GetParseErrorCode());
+        return false;
+    }
+
+    return true;
+}
+
+
+/* A growable buffer holding the NUL-terminated copy of a string to be parsed in place,
+   that can be reused for several documents. */
+
+struct InsituBuffer {
+    char* data;
+    size_t capacity;
+
+    InsituBuffer()
+        : data(NULL),
+          capacity(0)
+        {}
+
+    ~InsituBuffer() {
+        PyMem_Free(data);
+    }
+
+    // Copy the string, including its terminating NUL, returning NULL on failure
+
+    char* Copy(const char* str, size_t length) {
+        if (length + 1 > capacity) {
+            char* grown = (char*) PyMem_Realloc(data, sizeof(char) * (length + 1));
+            if (grown == NULL) {
+                PyErr_NoMemory();
+                return NULL;
+            }
+            data = grown;
+            capacity = length + 1;
+        }
+
+        memcpy(data, str, length + 1);
+
+        return data;
+    }
+};
+
+
+/* Parse the whole string into a tape with the GIL released, and then replay it into the
+   handler to build the Python objects. */
+
+static PyObject*
+do_decode_without_gil(PyHandler& handler, InsituBuffer& buffer,
+                      const char* jsonStr, Py_ssize_t jsonStrLen,
+                      bool fromBuffer, bool destructive,
+                      unsigned numberMode, unsigned parseMode)
+{
+    Tape tape;
+
+    if (destructive)
+        tape.insitu = (char*) jsonStr;
+    else if (!fromBuffer) {
+        tape.insitu = buffer.Copy(jsonStr, jsonStrLen);
+        if (tape.insitu == NULL)
+            return NULL;
+    }
+
+    bool ok = parse_into_tape(tape, jsonStr, jsonStrLen, destructive, numberMode,
+                              parseMode, handler.recursionLimit);
+
+    if (ok) {
+        size_t offset;
+
+        ok = replay_tape(tape, 0, tape.entries.size(), handler, offset);
+        if (!ok)
+            set_parse_error(offset, kParseErrorTermination);
+    }
+
+    PyObject* result = handler.root;
+    handler.root = NULL;
+
+    if (!ok) {
+        Py_XDECREF(result);
+        return NULL;
+    }
+
+    return result;
+}
+
+
+/* Decode a single document with the given handler and reader, that are left ready for
+   the next one when successful: a string is copied into the buffer and parsed in place,
+   as is a writable buffer when destructive is true, but directly on its memory. */
+
+static PyObject*
+decode_document(PyHandler& handler, Reader& reader, InsituBuffer& buffer,
+                const char* jsonStr, Py_ssize_t jsonStrLen, bool fromBuffer,
+                bool destructive, PyObject* jsonStream, size_t chunkSize,
+                unsigned numberMode, unsigned parseMode, bool releaseGil)
+{
+    if (releaseGil && (fromBuffer || jsonStr != NULL))
+        return do_decode_without_gil(handler, buffer, jsonStr, jsonStrLen, fromBuffer,
+                                     destructive, numberMode, parseMode);
+
+    unsigned flags = reader_flags(numberMode, parseMode);
+
+    if (destructive) {
+        // Parse the caller's buffer in place, clobbering its content: it is neither
+        // NUL-terminated nor guaranteed to be valid UTF-8
+
+        InsituMemoryStream ims((char*) jsonStr, jsonStrLen);
+
+        decode_with_flags<kParseInsituFlag | kParseValidateEncodingFlag,
+                          commonReaderFlags>(reader, flags, ims, handler);
+    } else if (fromBuffer) {
+        // Parse the bytes-like object in place, without an intermediary copy: it is not
+        // guaranteed to be valid UTF-8, so the reader must check that
+
+        MemoryStream ms(jsonStr, jsonStrLen);
+
+        decode_with_flags<kParseValidateEncodingFlag, commonReaderFlags>(reader, flags,
+                                                                         ms, handler);
+    } else if (jsonStr != NULL) {
+        char* jsonStrCopy = buffer.Copy(jsonStr, jsonStrLen);
+
+        if (jsonStrCopy == NULL)
+            return NULL;
+
+        InsituStringStream ss(jsonStrCopy);
+
+        decode_with_flags<kParseInsituFlag, commonReaderFlags>(reader, flags, ss,
+                                                               handler);
+    } else {
+        PyReadStreamWrapper sw(jsonStream, chunkSize);
+
+        decode_with_flags<kParseNoFlags, commonReaderFlags | kParseValidateEncodingFlag>(
+            reader, flags, sw, handler);
+    }
+
+    PyObject* result = handler.root;
+    handler.root = NULL;
+
+    if (reader.HasParseError()) {
+        set_parse_error(reader.GetErrorOffset(), reader.GetParseErrorCode());
+        Py_XDECREF(result);
+        return NULL;
+    } else if (PyErr_Occurred()) {
+        // Catch possible error raised in associated stream operations
+        Py_XDECREF(result);
+        return NULL;
+    }
+
+    return result;
+}
+
+
+static PyObject*
+do_decode(PyObject* decoder, const char* jsonStr, Py_ssize_t jsonStrLen, bool fromBuffer,
+          bool destructive, PyObject* jsonStream, size_t chunkSize, PyObject* objectHook,
+          unsigned numberMode, unsigned datetimeMode, unsigned uuidMode,
+          unsigned parseMode, bool releaseGil, const Selection* selection)
+{
+    KeyCache* keyCache = decoder != NULL ? ((DecoderObject*) decoder)->keyCache : NULL;
+    PyHandler handler(decoder, objectHook, datetimeMode, uuidMode, numberMode, keyCache);
+    Reader reader;
+    InsituBuffer buffer;
+
+    handler.selection = selection;
+
+    return decode_document(handler, reader, buffer, jsonStr, jsonStrLen, fromBuffer,
+                           destructive, jsonStream, chunkSize, numberMode, parseMode,
+                           releaseGil);
+}
+
+
+static PyObject*
+decoder_call(PyObject* self, PyObject* args, PyObject* kwargs)
+{
+    static char const* kwlist[] = {
+        "json",
+        "chunk_size",
+        NULL
+    };
+    PyObject* jsonObject;
+    PyObject* chunkSizeObj = NULL;
+    size_t chunkSize = 65536;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|$O",
+                                     (char**) kwlist,
+                                     &jsonObject,
+                                     &chunkSizeObj))
+        return NULL;
+
+    if (chunkSizeObj && chunkSizeObj != Py_None) {
+        if (PyLong_Check(chunkSizeObj)) {
+            Py_ssize_t size = PyNumber_AsSsize_t(chunkSizeObj, PyExc_ValueError);
+            if (PyErr_Occurred() || size < 4 || size > UINT_MAX) {
+                PyErr_SetString(PyExc_ValueError,
+                                "Invalid chunk_size, must be an integer between 4 and"
+                                " UINT_MAX");
+                return NULL;
+            }
+            chunkSize = (size_t) size;
+        } else {
+            PyErr_SetString(PyExc_TypeError,
+                            "chunk_size must be an unsigned integer value or None");
+            return NULL;
+        }
+    }
+
+    Py_ssize_t jsonStrLen;
+    const char* jsonStr;
+    Py_buffer view;
+    bool fromBuffer = false;
+
+    if (PyUnicode_Check(jsonObject)) {
+        jsonStr = PyUnicode_AsUTF8AndSize(jsonObject, &jsonStrLen);
+        if (jsonStr == NULL)
+            return NULL;
+    } else if (PyObject_CheckBuffer(jsonObject)) {
+        if (PyObject_GetBuffer(jsonObject, &view, PyBUF_SIMPLE) < 0)
+            return NULL;
+        jsonStr = (const char*) view.buf;
+        jsonStrLen = view.len;
+        fromBuffer = true;
+    } else if (PyObject_HasAttr(jsonObject, read_name)) {
+        jsonStr = NULL;
+        jsonStrLen = 0;
+    } else {
+        PyErr_SetString(
+            PyExc_TypeError,
+            "Expected string or UTF-8 encoded bytes-like object or a file-like object");
+        return NULL;
+    }
+
+    DecoderObject* d = (DecoderObject*) self;
+
+    PyObject* result = do_decode(self, jsonStr, jsonStrLen, fromBuffer, false,
+                                 jsonObject, chunkSize, NULL, d->numberMode,
+                                 d->datetimeMode, d->uuidMode, d->parseMode,
+                                 d->releaseGil, d->selection);
+
+    if (fromBuffer)
+        PyBuffer_Release(&view);
+
+    return result;
+}
+
+
+static PyObject*
+decoder_new(PyTypeObject* type, PyObject* args, PyObject* kwargs)
+{
+    DecoderObject* d;
+    PyObject* datetimeModeObj = NULL;
+    unsigned datetimeMode = DM_NONE;
+    PyObject* uuidModeObj = NULL;
+    unsigned uuidMode = UM_NONE;
+    PyObject* numberModeObj = NULL;
+    unsigned numberMode = NM_NAN;
+    PyObject* parseModeObj = NULL;
+    unsigned parseMode = PM_NONE;
+    PyObject* keyCacheSizeObj = NULL;
+    unsigned keyCacheSize = 0;
+    int releaseGil = false;
+    PyObject* selectObj = NULL;
+    static char const* kwlist[] = {
+        "number_mode",
+        "datetime_mode",
+        "uuid_mode",
+        "parse_mode",
+        "key_cache_size",
+        "release_gil",
+        "select",
+        NULL
+    };
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|OOOOOpO:Decoder",
+                                     (char**) kwlist,
+                                     &numberModeObj,
+                                     &datetimeModeObj,
+                                     &uuidModeObj,
+                                     &parseModeObj,
+                                     &keyCacheSizeObj,
+                                     &releaseGil,
+                                     &selectObj))
+        return NULL;
+
+    if (numberModeObj) {
+        if (numberModeObj == Py_None) {
+            numberMode = NM_NONE;
+        } else if (PyLong_Check(numberModeObj)) {
+            int mode = PyLong_AsLong(numberModeObj);
+            if (mode < 0 || mode >= NM_MAX) {
+                PyErr_SetString(PyExc_ValueError, "Invalid number_mode");
+                return NULL;
+            }
+            numberMode = (unsigned) mode;
+            if (numberMode & NM_DECIMAL && numberMode & NM_NATIVE) {
+                PyErr_SetString(PyExc_ValueError,
+                                "Combining NM_NATIVE with NM_DECIMAL is not supported");
+                return NULL;
+            }
+        }
+    }
+
+    if (datetimeModeObj) {
+        if (datetimeModeObj == Py_None) {
+            datetimeMode = DM_NONE;
+        } else if (PyLong_Check(datetimeModeObj)) {
+            int mode = PyLong_AsLong(datetimeModeObj);
+            if (!valid_datetime_mode(mode)) {
+                PyErr_SetString(PyExc_ValueError, "Invalid datetime_mode");
+                return NULL;
+            }
+            datetimeMode = (unsigned) mode;
+            if (datetimeMode && datetime_mode_format(datetimeMode) != DM_ISO8601) {
+                PyErr_SetString(PyExc_ValueError,
+                                "Invalid datetime_mode, can deserialize only from"
+                                " ISO8601");
+                return NULL;
+            }
+        } else {
+            PyErr_SetString(PyExc_TypeError,
+                            "datetime_mode must be a non-negative integer value or None");
+            return NULL;
+        }
+    }
+
+    if (uuidModeObj) {
+        if (uuidModeObj == Py_None) {
+            uuidMode = UM_NONE;
+        } else if (PyLong_Check(uuidModeObj)) {
+            int mode = PyLong_AsLong(uuidModeObj);
+            if (mode < 0 || mode >= UM_MAX) {
+                PyErr_SetString(PyExc_ValueError, "Invalid uuid_mode");
+                return NULL;
+            }
+            uuidMode = (unsigned) mode;
+        } else {
+            PyErr_SetString(PyExc_TypeError,
+                            "uuid_mode must be an integer value or None");
+            return NULL;
+        }
+    }
+
+    if (parseModeObj) {
+        if (parseModeObj == Py_None) {
+            parseMode = PM_NONE;
+        } else if (PyLong_Check(parseModeObj)) {
+            int mode = PyLong_AsLong(parseModeObj);
+            if (mode < 0 || mode >= PM_MAX) {
+                PyErr_SetString(PyExc_ValueError, "Invalid parse_mode");
+                return NULL;
+            }
+            parseMode = (unsigned) mode;
+        } else {
+            PyErr_SetString(PyExc_TypeError,
+                            "parse_mode must be an integer value or None");
+            return NULL;
+        }
+    }
+
+    if (keyCacheSizeObj && keyCacheSizeObj != Py_None) {
+        if (PyLong_Check(keyCacheSizeObj)) {
+            Py_ssize_t size = PyNumber_AsSsize_t(keyCacheSizeObj, PyExc_ValueError);
+            if (PyErr_Occurred() || size < 0 || size > UINT_MAX) {
+                PyErr_SetString(PyExc_ValueError,
+                                "Invalid key_cache_size, must be an integer between 0 and"
+                                " UINT_MAX");
+                return NULL;
+            }
+            keyCacheSize = (unsigned) size;
+        } else {
+            PyErr_SetString(PyExc_TypeError,
+                            "key_cache_size must be a non-negative integer value"
+                            " or None");
+            return NULL;
+        }
+    }
+
+    Selection* selection;
+
+    if (!accept_select_arg(selectObj, selection))
+        return NULL;
+
+    d = (DecoderObject*) type->tp_alloc(type, 0);
+    if (d == NULL) {
+        delete selection;
+        return NULL;
+    }
+
+    d->datetimeMode = datetimeMode;
+    d->uuidMode = uuidMode;
+    d->numberMode = numberMode;
+    d->parseMode = parseMode;
+    d->keyCacheSize = keyCacheSize;
+    d->releaseGil = releaseGil;
+    if (keyCacheSize != 0)
+        d->keyCache = new KeyCache(keyCacheSize);
+    d->selection = selection;
+
+    return (PyObject*) d;
+}
+
+
+static PyObject*
+decoder_load_file(PyObject* self, PyObject* path)
+{
+    DecoderObject* d = (DecoderObject*) self;
+    MappedFile file;
+
+    if (!file.Open(path))
+        return NULL;
+
+    return do_decode(self, file.data, file.size, true, false, NULL, 0, NULL,
+                     d->numberMode, d->datetimeMode, d->uuidMode, d->parseMode,
+                     d->releaseGil, d->selection);
+}
+
+
+/* Decode a batch of documents, sharing the handler, the reader and the buffer for the
+   strings parsed in place among all of them. */
+
+static PyObject*
+decoder_loads_many(PyObject* self, PyObject* jsons)
+{
+    PyObject* iterator = PyObject_GetIter(jsons);
+    if (iterator == NULL)
+        return NULL;
+
+    PyObject* result = PyList_New(0);
+    if (result == NULL) {
+        Py_DECREF(iterator);
+        return NULL;
+    }
+
+    DecoderObject* d = (DecoderObject*) self;
+    KeyCache keys(KeyCache::kStreamCapacity);
+    PyHandler handler(self, NULL, d->datetimeMode, d->uuidMode, d->numberMode,
+                      d->keyCache != NULL ? d->keyCache : &keys);
+    Reader reader;
+    InsituBuffer buffer;
+    PyObject* jsonObject;
+
+    handler.selection = d->selection;
+
+    while ((jsonObject = PyIter_Next(iterator)) != NULL) {
+        Py_ssize_t jsonStrLen;
+        const char* jsonStr;
+        Py_buffer view;
+        bool fromBuffer = false;
+        PyObject* value = NULL;
+
+        if (PyUnicode_Check(jsonObject)) {
+            jsonStr = PyUnicode_AsUTF8AndSize(jsonObject, &jsonStrLen);
+        } else if (PyObject_CheckBuffer(jsonObject)) {
+            if (PyObject_GetBuffer(jsonObject, &view, PyBUF_SIMPLE) < 0)
+                jsonStr = NULL;
+            else {
+                jsonStr = (const char*) view.buf;
+                jsonStrLen = view.len;
+                fromBuffer = true;
+            }
+        } else {
+            PyErr_SetString(PyExc_TypeError,
+                            "Expected string or UTF-8 encoded bytes-like object");
+            jsonStr = NULL;
+        }
+
+        if (jsonStr != NULL)
+            value = decode_document(handler, reader, buffer, jsonStr, jsonStrLen,
+                                    fromBuffer, false, NULL, 0, d->numberMode,
+                                    d->parseMode, d->releaseGil);
+
+        if (fromBuffer)
+            PyBuffer_Release(&view);
+        Py_DECREF(jsonObject);
+
+        if (value == NULL || PyList_Append(result, value) == -1) {
+            Py_XDECREF(value);
+            Py_DECREF(iterator);
+            Py_DECREF(result);
+            return NULL;
+        }
+
+        Py_DECREF(value);
+    }
+
+    Py_DECREF(iterator);
+
+    if (PyErr_Occurred()) {
+        Py_DECREF(result);
+        return NULL;
+    }
+
+    return result;
+}
+
+
+/* A slice of a newline-delimited buffer, parsed by a worker thread into a tape holding
+   all its documents. */
+
+struct LinesChunk {
+    const char* begin;
+    size_t length;
+    // Where the chunk starts within the whole buffer
+    size_t offset;
+    Tape tape;
+    // The index of the first tape entry of each document
+    std::vector<size_t> documents;
+    ParseErrorCode error;
+    size_t errorOffset;
+    bool tooDeep;
+    // Whether the error is a document spanning multiple lines
+    bool multiLine;
+    // Whether the error is a document starting on the same line where the previous ends
+    bool sameLine;
+    bool outOfMemory;
+};
+
+
+/* Parse the documents of the chunk one after the other, stopping at the first error: it
+   runs with the GIL released, possibly in a different thread, so it must not throw. */
+
+static void
+parse_lines_chunk(LinesChunk* chunk, unsigned flags, unsigned depthLimit)
+{
+    chunk->error = kParseErrorNone;
+    chunk->tooDeep = false;
+    chunk->multiLine = false;
+    chunk->sameLine = false;
+    chunk->outOfMemory = false;
+
+    try {
+        Reader reader;
+        MemoryStream ms(chunk->begin, chunk->length);
+        TapeHandler<MemoryStream> th(chunk->tape, ms, depthLimit);
+        // Where the previous document ends, the chunk itself starts at a new line
+        size_t previousEnd = 0;
+
+        for (;;) {
+            size_t start = chunk->tape.entries.size();
+            bool ok = decode_with_flags<kParseValidateEncodingFlag,
+                                        commonReaderFlags>(reader, flags, ms, th);
+
+            // Only whitespace after the last document: this is the regular end
+
+            if (!ok && reader.GetParseErrorCode() == kParseErrorDocumentEmpty)
+                break;
+
+            // Strings cannot contain a raw newline, so any one between the first token
+            // and the end of the document, or the error, means it spans multiple lines:
+            // reject it even when the chunk contains it entirely, as the outcome must
+            // not depend on where the input is split
+
+            size_t end = ok ? ms.Tell() : reader.GetErrorOffset();
+            if (chunk->tape.entries.size() > start && !th.tooDeep && !th.outOfMemory) {
+                size_t first = chunk->tape.entries[start].position;
+
+                // Likewise, there must be a newline between two documents
+
+                if (previousEnd != 0
+                    && memchr(chunk->begin + previousEnd, '\n',
+                              first - previousEnd) == NULL) {
+                    size_t next = previousEnd;
+                    while (chunk->begin[next] == ' ' || chunk->begin[next] == '\t'
+                           || chunk->begin[next] == '\r')
+                        next++;
+                    chunk->error = kParseErrorTermination;
+                    chunk->errorOffset = next;
+                    chunk->sameLine = true;
+                    break;
+                }
+
+                const char* newline = first < end
+                    ? (const char*) memchr(chunk->begin + first, '\n', end - first)
+                    : NULL;
+                if (newline != NULL) {
+                    chunk->error = kParseErrorTermination;
+                    chunk->errorOffset = newline - chunk->begin;
+                    chunk->multiLine = true;
+                    break;
+                }
+            }
+
+            if (!ok) {
+                chunk->error = reader.GetParseErrorCode();
+                chunk->errorOffset = reader.GetErrorOffset();
+                chunk->tooDeep = th.tooDeep;
+                chunk->outOfMemory = th.outOfMemory;
+                break;
+            }
+
+            chunk->documents.push_back(start);
+            previousEnd = end;
+        }
+    } catch (const std::bad_alloc&) {
+        chunk->error = kParseErrorTermination;
+        chunk->errorOffset = 0;
+        chunk->outOfMemory = true;
+    }
+}
+
+
+/* Wait for the termination of the given workers, with the GIL released. */
+
+static void
+join_workers(std::vector<std::thread>& workers, size_t begin, size_t end)
+{
+    Py_BEGIN_ALLOW_THREADS
+    for (size_t i = begin; i < end; i++)
+        if (workers[i].joinable())
+            workers[i].join();
+    Py_END_ALLOW_THREADS
+}
+
+
+/* Build the Python values of the documents in the chunk, appending them to the list. */
+
+static bool
+materialize_lines_chunk(const LinesChunk& chunk, PyHandler& handler, PyObject* result)
+{
+    if (chunk.error != kParseErrorNone) {
+        if (chunk.outOfMemory) {
+            PyErr_NoMemory();
+            return false;
+        }
+        if (chunk.multiLine) {
+            PyErr_Format(decode_error,
+                         "Parse error at offset %zu: Each value must be on a single line",
+                         chunk.offset + chunk.errorOffset);
+            return false;
+        }
+        if (chunk.sameLine) {
+            PyErr_Format(decode_error,
+                         "Parse error at offset %zu: Each line must contain a single"
+                         " value",
+                         chunk.offset + chunk.errorOffset);
+            return false;
+        }
+        if (chunk.tooDeep)
+            PyErr_SetString(PyExc_RecursionError,
+                            "Maximum parse recursion depth exceeded");
+        set_parse_error(chunk.offset + chunk.errorOffset, chunk.error);
+        return false;
+    }
+
+    const Tape& tape = chunk.tape;
+
+    for (size_t i = 0, c = chunk.documents.size(); i < c; i++) {
+        size_t begin = chunk.documents[i];
+        size_t end = i + 1 < c ? chunk.documents[i + 1] : tape.entries.size();
+        size_t position;
+
+        bool ok = replay_tape(tape, begin, end, handler, position);
+
+        PyObject* value = handler.root;
+        handler.root = NULL;
+
+        if (!ok) {
+            Py_XDECREF(value);
+            set_parse_error(chunk.offset + position, kParseErrorTermination);
+            return false;
+        }
+
+        int rc = PyList_Append(result, value);
+        Py_DECREF(value);
+        if (rc == -1)
+            return false;
+    }
+
+    return true;
+}
+
+
+// Don't bother splitting the input in chunks smaller than this
+static const size_t minLinesChunkSize = 65536;
+
+
+PyDoc_STRVAR(loads_lines_docstring,
+             "loads_lines(string, *, object_hook=None, number_mode=None,"
+             " datetime_mode=None, uuid_mode=None, parse_mode=None, threads=None,"
+             " allow_nan=True)\n"
+             "\n"
+             "Decode a newline-delimited sequence of JSON values, parsing it with"
+             " multiple threads, and return the list of the resulting values.");
+
+
+static PyObject*
+loads_lines(PyObject* self, PyObject* args, PyObject* kwargs)
+{
+    static char const* kwlist[] = {
+        "string",
+        "object_hook",
+        "number_mode",
+        "datetime_mode",
+        "uuid_mode",
+        "parse_mode",
+        "threads",
+
+        /* compatibility with stdlib json */
+        "allow_nan",
+
+        NULL
+    };
+    PyObject* jsonObject;
+    PyObject* objectHook = NULL;
+    PyObject* datetimeModeObj = NULL;
+    unsigned datetimeMode = DM_NONE;
+    PyObject* uuidModeObj = NULL;
+    unsigned uuidMode = UM_NONE;
+    PyObject* numberModeObj = NULL;
+    unsigned numberMode = NM_NAN;
+    PyObject* parseModeObj = NULL;
+    unsigned parseMode = PM_NONE;
+    PyObject* threadsObj = NULL;
+    size_t threads;
+    int allowNan = -1;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|$OOOOOOp:rapidjson.loads_lines",
+                                     (char**) kwlist,
+                                     &jsonObject,
+                                     &objectHook,
+                                     &numberModeObj,
+                                     &datetimeModeObj,
+                                     &uuidModeObj,
+                                     &parseModeObj,
+                                     &threadsObj,
+                                     &allowNan))
+        return NULL;
+
+    if (objectHook && !PyCallable_Check(objectHook)) {
+        if (objectHook == Py_None) {
+            objectHook = NULL;
+        } else {
+            PyErr_SetString(PyExc_TypeError, "object_hook is not callable");
+            return NULL;
+        }
+    }
+
+    if (!accept_number_mode_arg(numberModeObj, allowNan, numberMode))
+        return NULL;
+    if (numberMode & NM_DECIMAL && numberMode & NM_NATIVE) {
+        PyErr_SetString(PyExc_ValueError,
+                        "Invalid number_mode, combining NM_NATIVE with NM_DECIMAL"
+                        " is not supported");
+        return NULL;
+    }
+
+    if (!accept_datetime_mode_arg(datetimeModeObj, datetimeMode))
+        return NULL;
+    if (datetimeMode && datetime_mode_format(datetimeMode) != DM_ISO8601) {
+        PyErr_SetString(PyExc_ValueError,
+                        "Invalid datetime_mode, can deserialize only from"
+                        " ISO8601");
+        return NULL;
+    }
+
+    if (!accept_uuid_mode_arg(uuidModeObj, uuidMode))
+        return NULL;
+
+    if (!accept_parse_mode_arg(parseModeObj, parseMode))
+        return NULL;
+
+    if (threadsObj == NULL || threadsObj == Py_None) {
+        threads = std::thread::hardware_concurrency();
+        if (threads == 0)
+            threads = 1;
+    } else if (PyLong_Check(threadsObj)) {
+        Py_ssize_t count = PyNumber_AsSsize_t(threadsObj, PyExc_ValueError);
+        if (PyErr_Occurred() || count < 1 || count > 1024) {
+            PyErr_Clear();
+            PyErr_SetString(PyExc_ValueError,
+                            "Invalid threads, must be an integer between 1 and 1024");
+            return NULL;
+        }
+        threads = (size_t) count;
+    } else {
+        PyErr_SetString(PyExc_TypeError,
+                        "threads must be a positive integer value or None");
+        return NULL;
+    }
+
+    Py_ssize_t jsonStrLen;
+    const char* jsonStr;
+    Py_buffer view;
+    bool fromBuffer = false;
+
+    if (PyUnicode_Check(jsonObject)) {
+        jsonStr = PyUnicode_AsUTF8AndSize(jsonObject, &jsonStrLen);
+        if (jsonStr == NULL)
+            return NULL;
+    } else if (PyObject_CheckBuffer(jsonObject)) {
+        if (PyObject_GetBuffer(jsonObject, &view, PyBUF_SIMPLE) < 0)
+            return NULL;
+        jsonStr = (const char*) view.buf;
+        jsonStrLen = view.len;
+        fromBuffer = true;
+    } else {
+        PyErr_SetString(PyExc_TypeError,
+                        "Expected string or UTF-8 encoded bytes-like object");
+        return NULL;
+    }
+
+    PyObject* result = PyList_New(0);
+    if (result == NULL) {
+        if (fromBuffer)
+            PyBuffer_Release(&view);
+        return NULL;
+    }
+
+    // Split the input in roughly equal chunks, each one ending right after a newline
+
+    size_t length = (size_t) jsonStrLen;
+    size_t count = std::max(std::min(threads, length / minLinesChunkSize), (size_t) 1);
+    std::vector<LinesChunk> chunks(count);
+    size_t start = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        size_t end = i + 1 < count ? length / count * (i + 1) : length;
+
+        if (end < start)
+            end = start;
+        while (end < length && jsonStr[end - 1] != '\n')
+            end++;
+
+        chunks[i].begin = jsonStr + start;
+        chunks[i].length = end - start;
+        chunks[i].offset = start;
+        start = end;
+    }
+
+    unsigned flags = reader_flags(numberMode, parseMode) | kParseStopWhenDoneFlag;
+    unsigned depthLimit = Py_GetRecursionLimit();
+    std::vector<std::thread> workers(count);
+
+    // The first chunk is parsed by this thread, while the workers take care of the
+    // others: each chunk is then materialized as soon as its worker is done, in order
+
+    Py_BEGIN_ALLOW_THREADS
+    for (size_t i = 1; i < count; i++) {
+        try {
+            workers[i] = std::thread(parse_lines_chunk, &chunks[i], flags, depthLimit);
+        } catch (const std::system_error&) {
+            // Unable to start another thread, do it in this one
+            parse_lines_chunk(&chunks[i], flags, depthLimit);
+        }
+    }
+    parse_lines_chunk(&chunks[0], flags, depthLimit);
+    Py_END_ALLOW_THREADS
+
+    PyHandler handler(NULL, objectHook, datetimeMode, uuidMode, numberMode);
+    bool ok = true;
+
+    for (size_t i = 0; i < count && ok; i++) {
+        join_workers(workers, i, i + 1);
+        ok = materialize_lines_chunk(chunks[i], handler, result);
+        // Release the tape as soon as possible
+        chunks[i].tape = Tape();
+    }
+
+    if (!ok) {
+        join_workers(workers, 0, count);
+        Py_CLEAR(result);
+    }
+
+    if (fromBuffer)
+        PyBuffer_Release(&view);
+
+    return result;
+}
+
+
+/////////////////////
+// DecoderIterator //
+/////////////////////
+
+
+/* Iterator over a sequence of JSON values, either newline-delimited or simply
+   concatenated: each step parses the next value with kParseStopWhenDoneFlag, reusing
+   the same reader, input stream and handler. */
+
+typedef struct {
+    PyObject_HEAD
+    // The str, bytes-like or file-like object the values come from
+    PyObject* source;
+    PyObject* decoder;
+    PyObject* objectHook;
+    Py_buffer view;
+    bool fromBuffer;
+    MemoryStream* memoryStream;
+    PyReadStreamWrapper* streamWrapper;
+    PyHandler* handler;
+    // The keys seen in the whole stream, bounded, unless the decoder has its own cache
+    KeyCache* keys;
+    Reader* reader;
+    unsigned flags;
+    bool done;
+    // Whether a value is being parsed, possibly calling back Python code
+    bool running;
+} DecoderIteratorObject;
+
+
+static int
+decoder_iterator_traverse(PyObject* self, visitproc visit, void* arg)
+{
+    DecoderIteratorObject* it = (DecoderIteratorObject*) self;
+
+    Py_VISIT(it->source);
+    Py_VISIT(it->decoder);
+    Py_VISIT(it->objectHook);
+    if (it->handler != NULL) {
+        int result = it->handler->Traverse(visit, arg);
+        if (result != 0)
+            return result;
+    }
+    if (it->streamWrapper != NULL)
+        return it->streamWrapper->Traverse(visit, arg);
+    return 0;
+}
+
+
+/* Break reference cycles, typically through an attribute of a Decoder subclass: the
+   iterator is exhausted afterwards. */
+
+static int
+decoder_iterator_clear(PyObject* self)
+{
+    DecoderIteratorObject* it = (DecoderIteratorObject*) self;
+
+    it->done = true;
+    delete it->reader;
+    it->reader = NULL;
+    delete it->handler;
+    it->handler = NULL;
+    delete it->keys;
+    it->keys = NULL;
+    delete it->memoryStream;
+    it->memoryStream = NULL;
+    delete it->streamWrapper;
+    it->streamWrapper = NULL;
+    if (it->fromBuffer) {
+        it->fromBuffer = false;
+        PyBuffer_Release(&it->view);
+    }
+    Py_CLEAR(it->objectHook);
+    Py_CLEAR(it->decoder);
+    Py_CLEAR(it->source);
+    return 0;
+}
+
+
+static void
+decoder_iterator_dealloc(PyObject* self)
+{
+    PyObject_GC_UnTrack(self);
+    decoder_iterator_clear(self);
+    Py_TYPE(self)->tp_free(self);
+}
+
+
+static PyObject*
+decoder_iterator_next(PyObject* self)
+{
+    DecoderIteratorObject* it = (DecoderIteratorObject*) self;
+
+    if (it->done)
+        return NULL;
+
+    // The reader, the handler and the stream are shared by all the steps, so they must
+    // not be reentered from a hook or from the read() method of the stream
+
+    if (it->running) {
+        PyErr_SetString(PyExc_ValueError, "iterator already executing");
+        return NULL;
+    }
+
+    Reader& reader = *it->reader;
+    PyHandler& handler = *it->handler;
+
+    it->running = true;
+    if (it->memoryStream != NULL)
+        decode_with_flags<kParseValidateEncodingFlag, commonReaderFlags>(
+            reader, it->flags, *it->memoryStream, handler);
+    else
+        decode_with_flags<kParseNoFlags, commonReaderFlags | kParseValidateEncodingFlag>(
+            reader, it->flags, *it->streamWrapper, handler);
+    it->running = false;
+
+    PyObject* value = handler.root;
+    handler.root = NULL;
+
+    if (reader.HasParseError()) {
+        it->done = true;
+        Py_XDECREF(value);
+
+        // Only whitespace after the last value: this is the regular end
+
+        if (reader.GetParseErrorCode() == kParseErrorDocumentEmpty && !PyErr_Occurred())
+            return NULL;
+
+        set_parse_error(reader.GetErrorOffset(), reader.GetParseErrorCode());
+        return NULL;
+    } else if (PyErr_Occurred()) {
+        // Catch possible error raised in associated stream operations
+        it->done = true;
+        Py_XDECREF(value);
+        return NULL;
+    }
+
+    return value;
+}
+
+
+static PyTypeObject DecoderIterator_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "rapidjson.DecoderIterator",              /* tp_name */
+    sizeof(DecoderIteratorObject),            /* tp_basicsize */
+    0,                                        /* tp_itemsize */
+    (destructor) decoder_iterator_dealloc,    /* tp_dealloc */
+    0,                                        /* tp_print */
+    0,                                        /* tp_getattr */
+    0,                                        /* tp_setattr */
+    0,                                        /* tp_compare */
+    0,                                        /* tp_repr */
+    0,                                        /* tp_as_number */
+    0,                                        /* tp_as_sequence */
+    0,                                        /* tp_as_mapping */
+    0,                                        /* tp_hash */
+    0,                                        /* tp_call */
+    0,                                        /* tp_str */
+    0,                                        /* tp_getattro */
+    0,                                        /* tp_setattro */
+    0,                                        /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,  /* tp_flags */
+    0,                                        /* tp_doc */
+    (traverseproc) decoder_iterator_traverse, /* tp_traverse */
+    (inquiry) decoder_iterator_clear,         /* tp_clear */
+    0,                                        /* tp_richcompare */
+    0,                                        /* tp_weaklistoffset */
+    PyObject_SelfIter,                        /* tp_iter */
+    decoder_iterator_next,                    /* tp_iternext */
+    0,                                        /* tp_methods */
+    0,                                        /* tp_members */
+    0,                                        /* tp_getset */
+    0,                                        /* tp_base */
+    0,                                        /* tp_dict */
+    0,                                        /* tp_descr_get */
+    0,                                        /* tp_descr_set */
+    0,                                        /* tp_dictoffset */
+    0,                                        /* tp_init */
+    0,                                        /* tp_alloc */
+    0,                                        /* tp_new */
+    PyObject_GC_Del,                          /* tp_free */
+};
+
+
+static PyObject*
+decoder_iterator_new(PyObject* decoder, PyObject* jsonObject, size_t chunkSize,
+                     PyObject* objectHook, unsigned numberMode, unsigned datetimeMode,
+                     unsigned uuidMode, unsigned parseMode)
+{
+    const char* jsonStr = NULL;
+    Py_ssize_t jsonStrLen = 0;
+    Py_buffer view;
+    bool fromBuffer = false;
+
+    if (PyUnicode_Check(jsonObject)) {
+        jsonStr = PyUnicode_AsUTF8AndSize(jsonObject, &jsonStrLen);
+        if (jsonStr == NULL)
+            return NULL;
+    } else if (PyObject_CheckBuffer(jsonObject)) {
+        if (PyObject_GetBuffer(jsonObject, &view, PyBUF_SIMPLE) < 0)
+            return NULL;
+        jsonStr = (const char*) view.buf;
+        jsonStrLen = view.len;
+        fromBuffer = true;
+    } else if (!PyObject_HasAttr(jsonObject, read_name)) {
+        PyErr_SetString(
+            PyExc_TypeError,
+            "Expected string or UTF-8 encoded bytes-like object or a file-like object");
+        return NULL;
+    }
+
+    DecoderIteratorObject* it = PyObject_GC_New(DecoderIteratorObject,
+                                                &DecoderIterator_Type);
+    if (it == NULL) {
+        if (fromBuffer)
+            PyBuffer_Release(&view);
+        return NULL;
+    }
+
+    Py_INCREF(jsonObject);
+    it->source = jsonObject;
+    Py_XINCREF(decoder);
+    it->decoder = decoder;
+    Py_XINCREF(objectHook);
+    it->objectHook = objectHook;
+    it->fromBuffer = fromBuffer;
+    if (fromBuffer)
+        it->view = view;
+    if (jsonStr != NULL) {
+        it->memoryStream = new MemoryStream(jsonStr, jsonStrLen);
+        it->streamWrapper = NULL;
+    } else {
+        it->memoryStream = NULL;
+        it->streamWrapper = new PyReadStreamWrapper(jsonObject, chunkSize);
+    }
+    KeyCache* keyCache = decoder != NULL ? ((DecoderObject*) decoder)->keyCache : NULL;
+    if (keyCache == NULL)
+        keyCache = it->keys = new KeyCache(KeyCache::kStreamCapacity);
+    else
+        it->keys = NULL;
+    it->handler = new PyHandler(decoder, objectHook, datetimeMode, uuidMode, numberMode,
+                                keyCache);
+    if (decoder != NULL)
+        it->handler->selection = ((DecoderObject*) decoder)->selection;
+    it->reader = new Reader();
+    it->flags = reader_flags(numberMode, parseMode) | kParseStopWhenDoneFlag;
+    it->done = false;
+    it->running = false;
+    PyObject_GC_Track(it);
+
+    return (PyObject*) it;
+}
+
+
+PyDoc_STRVAR(iterload_docstring,
+             "iterload(json, *, object_hook=None, number_mode=None, datetime_mode=None,"
+             " uuid_mode=None, parse_mode=None, chunk_size=65536, allow_nan=True)\n"
+             "\n"
+             "Return an iterator over the sequence of JSON values in a string, a"
+             " bytes-like object or a stream.");
+
+
+static PyObject*
+iterload(PyObject* self, PyObject* args, PyObject* kwargs)
+{
+    static char const* kwlist[] = {
+        "json",
+        "object_hook",
+        "number_mode",
+        "datetime_mode",
+        "uuid_mode",
+        "parse_mode",
+        "chunk_size",
+
+        /* compatibility with stdlib json */
+        "allow_nan",
+
+        NULL
+    };
+    PyObject* jsonObject;
+    PyObject* objectHook = NULL;
+    PyObject* datetimeModeObj = NULL;
+    unsigned datetimeMode = DM_NONE;
+    PyObject* uuidModeObj = NULL;
+    unsigned uuidMode = UM_NONE;
+    PyObject* numberModeObj = NULL;
+    unsigned numberMode = NM_NAN;
+    PyObject* parseModeObj = NULL;
+    unsigned parseMode = PM_NONE;
+    PyObject* chunkSizeObj = NULL;
+    size_t chunkSize = 65536;
+    int allowNan = -1;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|$OOOOOOp:rapidjson.iterload",
+                                     (char**) kwlist,
+                                     &jsonObject,
+                                     &objectHook,
+                                     &numberModeObj,
+                                     &datetimeModeObj,
+                                     &uuidModeObj,
+                                     &parseModeObj,
+                                     &chunkSizeObj,
+                                     &allowNan))
+        return NULL;
+
+    if (objectHook && !PyCallable_Check(objectHook)) {
+        if (objectHook == Py_None) {
+            objectHook = NULL;
+        } else {
+            PyErr_SetString(PyExc_TypeError, "object_hook is not callable");
+            return NULL;
+        }
+    }
+
+    if (!accept_number_mode_arg(numberModeObj, allowNan, numberMode))
+        return NULL;
+    if (numberMode & NM_DECIMAL && numberMode & NM_NATIVE) {
+        PyErr_SetString(PyExc_ValueError,
+                        "Invalid number_mode, combining NM_NATIVE with NM_DECIMAL"
+                        " is not supported");
+        return NULL;
+    }
+
+    if (!accept_datetime_mode_arg(datetimeModeObj, datetimeMode))
+        return NULL;
+    if (datetimeMode && datetime_mode_format(datetimeMode) != DM_ISO8601) {
+        PyErr_SetString(PyExc_ValueError,
+                        "Invalid datetime_mode, can deserialize only from"
+                        " ISO8601");
+        return NULL;
+    }
+
+    if (!accept_uuid_mode_arg(uuidModeObj, uuidMode))
+        return NULL;
+
+    if (!accept_parse_mode_arg(parseModeObj, parseMode))
+        return NULL;
+
+    if (!accept_chunk_size_arg(chunkSizeObj, chunkSize))
+        return NULL;
+
+    return decoder_iterator_new(NULL, jsonObject, chunkSize, objectHook, numberMode,
+                                datetimeMode, uuidMode, parseMode);
+}
+
+
+static PyObject*
+decoder_iter(PyObject* self, PyObject* args, PyObject* kwargs)
+{
+    static char const* kwlist[] = {
+        "json",
+        "chunk_size",
+        NULL
+    };
+    PyObject* jsonObject;
+    PyObject* chunkSizeObj = NULL;
+    size_t chunkSize = 65536;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|$O",
+                                     (char**) kwlist,
+                                     &jsonObject,
+                                     &chunkSizeObj))
+        return NULL;
+
+    if (!accept_chunk_size_arg(chunkSizeObj, chunkSize))
+        return NULL;
+
+    DecoderObject* d = (DecoderObject*) self;
+
+    return decoder_iterator_new(self, jsonObject, chunkSize, NULL, d->numberMode,
+                                d->datetimeMode, d->uuidMode, d->parseMode);
+}
+
+
+///////////////////
+// EventIterator //
+///////////////////
+
+
+/* SAX handler translating the parser callbacks into ijson-style (path, event, value)
+   triples: the path is the dotted sequence of the keys leading to the current value,
+   with "item" standing for any array element. Events outside the selected prefix are
+   dropped without creating any Python object. */
+
+struct EventHandler {
+    // The keys seen in the whole stream, bounded
+    KeyCache keys;
+    // Used to convert the scalar values, with an always empty stack
+    PyHandler scalars;
+    std::string prefix;
+    bool hasPrefix;
+    std::string path;
+    // The length of the path of each open container, and whether it is an object
+    std::vector<std::pair<size_t, bool> > frames;
+    // The Python str of the current path, lazily built
+    PyObject* pathObject;
+    // The next (path, event, value) tuple to be yielded, if any
+    PyObject* event;
+    unsigned recursionLimit;
+
+    EventHandler(const char* prefix,
+                 Py_ssize_t prefixLength,
+                 unsigned dm,
+                 unsigned um,
+                 unsigned nm)
+        : keys(KeyCache::kStreamCapacity),
+          scalars(NULL, NULL, dm, um, nm, &keys),
+          hasPrefix(prefix != NULL),
+          pathObject(NULL),
+          event(NULL)
+        {
+            if (prefix != NULL)
+                this->prefix.assign(prefix, prefixLength);
+            frames.reserve(128);
+            recursionLimit = Py_GetRecursionLimit();
+        }
+
+    ~EventHandler() {
+        Py_CLEAR(pathObject);
+        Py_CLEAR(event);
+    }
+
+    int Traverse(visitproc visit, void* arg) {
+        Py_VISIT(event);
+        return scalars.Traverse(visit, arg);
+    }
+
+    // Whether the first length characters of the path fall within the prefix
+
+    bool IsSelected(size_t length) const {
+        if (!hasPrefix || prefix.empty())
+            return true;
+
+        size_t prefixLength = prefix.size();
+
+        return (length >= prefixLength
+                && path.compare(0, prefixLength, prefix) == 0
+                && (length == prefixLength || path[prefixLength] == '.'));
+    }
+
+    bool IsSelected() const {
+        return IsSelected(path.size());
+    }
+
+    void TruncatePath(size_t length) {
+        if (path.size() != length) {
+            path.resize(length);
+            Py_CLEAR(pathObject);
+        }
+    }
+
+    // Append a component to the path: below the outermost container it is always
+    // separated from the parent's path, even when that is empty, as for "" keys
+
+    void ExtendPath(const char* str, size_t length) {
+        if (frames.size() > 1)
+            path += '.';
+        path.append(str, length);
+        Py_CLEAR(pathObject);
+    }
+
+    // Queue the event, stealing the reference to value
+
+    bool Emit(PyObject* name, PyObject* value) {
+        if (value == NULL)
+            return false;
+
+        if (pathObject == NULL) {
+            pathObject = PyUnicode_FromStringAndSize(path.data(), path.size());
+            if (pathObject == NULL) {
+                Py_DECREF(value);
+                return false;
+            }
+        }
+
+        assert(event == NULL);
+        event = PyTuple_Pack(3, pathObject, name, value);
+        Py_DECREF(value);
+
+        return event != NULL;
+    }
+
+    bool EmitNone(PyObject* name) {
+        Py_INCREF(Py_None);
+        return Emit(name, Py_None);
+    }
+
+    // Queue the event carrying the scalar value just converted by the inner handler
+
+    bool EmitScalar(PyObject* name, bool converted) {
+        PyObject* value = scalars.root;
+        scalars.root = NULL;
+
+        if (!converted) {
+            Py_XDECREF(value);
+            return false;
+        }
+
+        return Emit(name, value);
+    }
+
+    bool Null() {
+        return !IsSelected() || EmitScalar(null_event_name, scalars.Null());
+    }
+
+    bool Bool(bool b) {
+        return !IsSelected() || EmitScalar(boolean_event_name, scalars.Bool(b));
+    }
+
+    bool Int(int i) {
+        return !IsSelected() || EmitScalar(number_event_name, scalars.Int(i));
+    }
+
+    bool Uint(unsigned i) {
+        return !IsSelected() || EmitScalar(number_event_name, scalars.Uint(i));
+    }
+
+    bool Int64(int64_t i) {
+        return !IsSelected() || EmitScalar(number_event_name, scalars.Int64(i));
+    }
+
+    bool Uint64(uint64_t i) {
+        return !IsSelected() || EmitScalar(number_event_name, scalars.Uint64(i));
+    }
+
+    bool Double(double d) {
+        return !IsSelected() || EmitScalar(number_event_name, scalars.Double(d));
+    }
+
+    bool RawNumber(const char* str, SizeType length, bool copy) {
+        return (!IsSelected()
+                || EmitScalar(number_event_name, scalars.RawNumber(str, length, copy)));
+    }
+
+    bool String(const char* str, SizeType length, bool copy) {
+        return (!IsSelected()
+                || EmitScalar(string_event_name, scalars.String(str, length, copy)));
+    }
+
+    bool Key(const char* str, SizeType length, bool copy) {
+        // The key event belongs to the object, the following value to the key
+
+        TruncatePath(frames.back().first);
+
+        if (IsSelected()) {
+            PyObject* key = keys.Get(str, length);
+            if (!Emit(map_key_event_name, key))
+                return false;
+        }
+
+        ExtendPath(str, length);
+
+        return true;
+    }
+
+    bool StartContainer(PyObject* name, bool isObject) {
+        if (recursionLimit-- == 0) {
+            PyErr_SetString(PyExc_RecursionError,
+                            "Maximum parse recursion depth exceeded");
+            return false;
+        }
+
+        if (IsSelected() && !EmitNone(name))
+            return false;
+
+        frames.push_back(std::make_pair(path.size(), isObject));
+
+        if (!isObject)
+            ExtendPath("item", 4);
+
+        return true;
+    }
+
+    bool EndContainer(PyObject* name) {
+        recursionLimit++;
+
+        TruncatePath(frames.back().first);
+        frames.pop_back();
+
+        return !IsSelected() || EmitNone(name);
+    }
+
+    bool StartObject() {
+        return StartContainer(start_map_event_name, true);
+    }
+
+    bool EndObject(SizeType memberCount) {
+        return EndContainer(end_map_event_name);
+    }
+
+    bool StartArray() {
+        return StartContainer(start_array_event_name, false);
+    }
+
+    bool EndArray(SizeType elementCount) {
+        return EndContainer(end_array_event_name);
+    }
+};
+
+
+/* Iterator over the events of a JSON document read from a stream, pulling one token at a
+   time from the reader until the handler queues the next selected event. */
+
+typedef struct {
+    PyObject_HEAD
+    PyReadStreamWrapper* streamWrapper;
+    EventHandler* handler;
+    Reader* reader;
+    unsigned flags;
+    bool done;
+    // Whether the reader is advancing, possibly calling back Python code
+    bool running;
+} EventIteratorObject;
+
+
+static int
+event_iterator_traverse(PyObject* self, visitproc visit, void* arg)
+{
+    EventIteratorObject* it = (EventIteratorObject*) self;
+
+    if (it->handler != NULL) {
+        int result = it->handler->Traverse(visit, arg);
+        if (result != 0)
+            return result;
+    }
+    if (it->streamWrapper != NULL)
+        return it->streamWrapper->Traverse(visit, arg);
+    return 0;
+}
+
+
+static int
+event_iterator_clear(PyObject* self)
+{
+    EventIteratorObject* it = (EventIteratorObject*) self;
+
+    it->done = true;
+    delete it->reader;
+    it->reader = NULL;
+    delete it->handler;
+    it->handler = NULL;
+    delete it->streamWrapper;
+    it->streamWrapper = NULL;
+    return 0;
+}
+
+
+static void
+event_iterator_dealloc(PyObject* self)
+{
+    PyObject_GC_UnTrack(self);
+    event_iterator_clear(self);
+    Py_TYPE(self)->tp_free(self);
+}
+
+
+static PyObject*
+event_iterator_next(PyObject* self)
+{
+    EventIteratorObject* it = (EventIteratorObject*) self;
+
+    if (it->done)
+        return NULL;
+
+    // The state of the pull parser lives in the reader, that must not be reentered from
+    // the read() method of the stream
+
+    if (it->running) {
+        PyErr_SetString(PyExc_ValueError, "iterator already executing");
+        return NULL;
+    }
+
+    Reader& reader = *it->reader;
+    EventHandler& handler = *it->handler;
+
+    it->running = true;
+    while (handler.event == NULL) {
+        if (reader.IterativeParseComplete()) {
+            it->done = true;
+            break;
+        }
+
+        // A document spanning the whole stream is expected, PM_STOP_WHEN_DONE is
+        // rejected by iterparse()
+
+        if (!parse_next_with_flags<kParseNoFlags,
+                                   commonReaderFlags | kParseValidateEncodingFlag>(
+                reader, it->flags, *it->streamWrapper, handler)) {
+            it->done = true;
+            set_parse_error(reader.GetErrorOffset(), reader.GetParseErrorCode());
+            break;
+        } else if (PyErr_Occurred()) {
+            // Catch possible error raised in associated stream operations
+            it->done = true;
+            break;
+        }
+    }
+    it->running = false;
+
+    if (it->done)
+        return NULL;
+
+    PyObject* event = handler.event;
+    handler.event = NULL;
+
+    return event;
+}
+
+
+static PyTypeObject EventIterator_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "rapidjson.EventIterator",                /* tp_name */
+    sizeof(EventIteratorObject),              /* tp_basicsize */
+    0,                                        /* tp_itemsize */
+    (destructor) event_iterator_dealloc,      /* tp_dealloc */
+    0,                                        /* tp_print */
+    0,                                        /* tp_getattr */
+    0,                                        /* tp_setattr */
+    0,                                        /* tp_compare */
+    0,                                        /* tp_repr */
+    0,                                        /* tp_as_number */
+    0,                                        /* tp_as_sequence */
+    0,                                        /* tp_as_mapping */
+    0,                                        /* tp_hash */
+    0,                                        /* tp_call */
+    0,                                        /* tp_str */
+    0,                                        /* tp_getattro */
+    0,                                        /* tp_setattro */
+    0,                                        /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,  /* tp_flags */
+    0,                                        /* tp_doc */
+    (traverseproc) event_iterator_traverse,   /* tp_traverse */
+    (inquiry) event_iterator_clear,           /* tp_clear */
+    0,                                        /* tp_richcompare */
+    0,                                        /* tp_weaklistoffset */
+    PyObject_SelfIter,                        /* tp_iter */
+    event_iterator_next,                      /* tp_iternext */
+    0,                                        /* tp_methods */
+    0,                                        /* tp_members */
+    0,                                        /* tp_getset */
+    0,                                        /* tp_base */
+    0,                                        /* tp_dict */
+    0,                                        /* tp_descr_get */
+    0,                                        /* tp_descr_set */
+    0,                                        /* tp_dictoffset */
+    0,                                        /* tp_init */
+    0,                                        /* tp_alloc */
+    0,                                        /* tp_new */
+    PyObject_GC_Del,                          /* tp_free */
+};
+
+
+PyDoc_STRVAR(iterparse_docstring,
+             "iterparse(stream, prefix=None, *, number_mode=None, datetime_mode=None,"
+             " uuid_mode=None, parse_mode=None, chunk_size=65536, allow_nan=True)\n"
+             "\n"
+             "Return an iterator over the (path, event, value) parsing events of the JSON"
+             " document read from the given stream, optionally restricted to those under"
+             " the given prefix.");
+
+
+static PyObject*
+iterparse(PyObject* self, PyObject* args, PyObject* kwargs)
+{
+    static char const* kwlist[] = {
+        "stream",
+        "prefix",
+        "number_mode",
+        "datetime_mode",
+        "uuid_mode",
+        "parse_mode",
+        "chunk_size",
+
+        /* compatibility with stdlib json */
+        "allow_nan",
+
+        NULL
+    };
+    PyObject* jsonObject;
+    PyObject* prefixObj = NULL;
+    const char* prefix = NULL;
+    Py_ssize_t prefixLength = 0;
+    PyObject* datetimeModeObj = NULL;
+    unsigned datetimeMode = DM_NONE;
+    PyObject* uuidModeObj = NULL;
+    unsigned uuidMode = UM_NONE;
+    PyObject* numberModeObj = NULL;
+    unsigned numberMode = NM_NAN;
+    PyObject* parseModeObj = NULL;
+    unsigned parseMode = PM_NONE;
+    PyObject* chunkSizeObj = NULL;
+    size_t chunkSize = 65536;
+    int allowNan = -1;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|O$OOOOOp:rapidjson.iterparse",
+                                     (char**) kwlist,
+                                     &jsonObject,
+                                     &prefixObj,
+                                     &numberModeObj,
+                                     &datetimeModeObj,
+                                     &uuidModeObj,
+                                     &parseModeObj,
+                                     &chunkSizeObj,
+                                     &allowNan))
+        return NULL;
+
+    if (!PyObject_HasAttr(jsonObject, read_name)) {
+        PyErr_SetString(PyExc_TypeError, "Expected file-like object");
+        return NULL;
+    }
+
+    if (prefixObj != NULL && prefixObj != Py_None) {
+        if (!PyUnicode_Check(prefixObj)) {
+            PyErr_SetString(PyExc_TypeError, "prefix must be a string or None");
+            return NULL;
+        }
+        prefix = PyUnicode_AsUTF8AndSize(prefixObj, &prefixLength);
+        if (prefix == NULL)
+            return NULL;
+    }
+
+    if (!accept_number_mode_arg(numberModeObj, allowNan, numberMode))
+        return NULL;
+    if (numberMode & NM_DECIMAL && numberMode & NM_NATIVE) {
+        PyErr_SetString(PyExc_ValueError,
+                        "Invalid number_mode, combining NM_NATIVE with NM_DECIMAL"
+                        " is not supported");
+        return NULL;
+    }
+
+    if (!accept_datetime_mode_arg(datetimeModeObj, datetimeMode))
+        return NULL;
+    if (datetimeMode && datetime_mode_format(datetimeMode) != DM_ISO8601) {
+        PyErr_SetString(PyExc_ValueError,
+                        "Invalid datetime_mode, can deserialize only from"
+                        " ISO8601");
+        return NULL;
+    }
+
+    if (!accept_uuid_mode_arg(uuidModeObj, uuidMode))
+        return NULL;
+
+    if (!accept_parse_mode_arg(parseModeObj, parseMode))
+        return NULL;
+    if (parseMode & PM_STOP_WHEN_DONE) {
+        PyErr_SetString(PyExc_ValueError,
+                        "Invalid parse_mode, PM_STOP_WHEN_DONE is not supported, the"
+                        " document must span the whole stream");
+        return NULL;
+    }
+
+    if (!accept_chunk_size_arg(chunkSizeObj, chunkSize))
+        return NULL;
+
+    EventIteratorObject* it = PyObject_GC_New(EventIteratorObject, &EventIterator_Type);
+    if (it == NULL)
+        return NULL;
+
+    it->streamWrapper = new PyReadStreamWrapper(jsonObject, chunkSize);
+    it->handler = new EventHandler(prefix, prefixLength, datetimeMode, uuidMode,
+                                   numberMode);
+    it->reader = new Reader();
+    it->reader->IterativeParseInit();
+    it->flags = reader_flags(numberMode, parseMode);
+    it->done = false;
+    it->running = false;
+    PyObject_GC_Track(it);
+
+    return (PyObject*) it;
+}
+
+
+//////////////////
+// LazyDocument //
+//////////////////
+
+
+typedef struct {
+    PyObject_HEAD
+    // The document that owns the source, the tape and the keys, when this is a view on
+    // one of its containers, otherwise NULL
+    PyObject* owner;
+    // The index of the root value in the tape
+    size_t root;
+    // The str or bytes instance holding the JSON text
+    PyObject* source;
+    // The start of the text, the tape positions are relative to it
+    const char* text;
+    // The span of the root value within the text
+    const char* json;
+    Py_ssize_t length;
+    // Whether the text can be emitted as is by dumps()
+    bool verbatim;
+    bool isAscii;
+    Tape* tape;
+    KeyCache* keys;
+    // The tape index of each element, when the root is an array, built by the first
+    // access by position
+    std::vector<size_t>* elements;
+    // The number of distinct keys when the root is an object, -1 until the first len()
+    Py_ssize_t members;
+    unsigned datetimeMode;
+    unsigned uuidMode;
+    unsigned numberMode;
+    unsigned parseMode;
+} LazyDocumentObject;
+
+
+// Return the index of the tape entry following the value at the given index
+
+static inline size_t
+lazy_document_skip(const Tape* tape, size_t index)
+{
+    const TapeEntry& entry = tape->entries[index];
+
+    if (entry.type == TE_START_OBJECT || entry.type == TE_START_ARRAY)
+        return entry.value.end + 1;
+    else
+        return index + 1;
+}
+
+
+// Build the Python value for the tape entries starting at the given index
+
+static PyObject*
+lazy_document_materialize(LazyDocumentObject* self, size_t index)
+{
+    PyHandler handler(NULL, NULL, self->datetimeMode, self->uuidMode, self->numberMode,
+                      self->keys);
+    size_t offset;
+
+    if (!replay_tape(*self->tape, index, lazy_document_skip(self->tape, index), handler,
+                     offset)) {
+        set_parse_error(offset, kParseErrorTermination);
+        Py_XDECREF(handler.root);
+        return NULL;
+    }
+
+    return handler.root;
+}
+
+
+// Find the value of the given member of the object starting at the given index: when the
+// key is repeated, the last one wins, as it happens with dictionaries
+
+static bool
+lazy_document_find_member(const Tape* tape, size_t index,
+                          const char* key, Py_ssize_t length, size_t& found)
+{
+    size_t end = tape->entries[index].value.end;
+    bool result = false;
+
+    for (size_t i = index + 1; i < end; i = lazy_document_skip(tape, i + 1)) {
+        const TapeEntry& entry = tape->entries[i];
+
+        if ((Py_ssize_t) entry.length == length
+            && memcmp(tape->String(entry), key, length) == 0) {
+            found = i + 1;
+            result = true;
+        }
+    }
+
+    return result;
+}
+
+
+// Find the element at the given position of the array starting at the given index
+
+static bool
+lazy_document_find_element(const Tape* tape, size_t index, Py_ssize_t position,
+                           size_t& found)
+{
+    const TapeEntry& start = tape->entries[index];
+    Py_ssize_t count = tape->entries[start.value.end].length;
+
+    if (position < 0)
+        position += count;
+
+    if (position < 0 || position >= count)
+        return false;
+
+    size_t i = index + 1;
+    while (position--)
+        i = lazy_document_skip(tape, i);
+
+    found = i;
+    return true;
+}
+
+
+/* Find the value for the given key in the root container: return 1 when found, 0 when
+   not found, -1 in case of error. */
+
+static int
+lazy_document_lookup(LazyDocumentObject* self, PyObject* key, size_t& found)
+{
+    const TapeEntry& root = self->tape->entries[self->root];
+
+    if (root.type == TE_START_OBJECT) {
+        if (!PyUnicode_Check(key))
+            return 0;
+
+        Py_ssize_t length;
+        const char* str = PyUnicode_AsUTF8AndSize(key, &length);
+        if (str == NULL)
+            return -1;
+
+        return lazy_document_find_member(self->tape, self->root, str, length, found);
+    } else if (root.type == TE_START_ARRAY) {
+        if (!PyIndex_Check(key)) {
+            PyErr_Format(PyExc_TypeError,
+                         "array indices must be integers, not %.200s",
+                         Py_TYPE(key)->tp_name);
+            return -1;
+        }
+
+        Py_ssize_t position = PyNumber_AsSsize_t(key, PyExc_IndexError);
+        if (position == -1 && PyErr_Occurred())
+            return -1;
+
+        const Tape* tape = self->tape;
+        Py_ssize_t count = tape->entries[root.value.end].length;
+
+        if (position < 0)
+            position += count;
+        if (position < 0 || position >= count)
+            return 0;
+
+        // Index the elements at the first access, so that accessing all of them one
+        // after the other does not scan the array again and again
+
+        if (self->elements == NULL) {
+            std::vector<size_t>* elements = new std::vector<size_t>();
+            elements->reserve(count);
+            for (size_t i = self->root + 1; i < root.value.end;
+                 i = lazy_document_skip(tape, i))
+                elements->push_back(i);
+            self->elements = elements;
+        }
+
+        found = (*self->elements)[position];
+        return 1;
+    } else {
+        PyErr_SetString(PyExc_TypeError, "The JSON document is not a container");
+        return -1;
+    }
+}
+
+
+// Return the value at the given index: containers are wrapped in a view sharing the same
+// tape, that builds their Python values only when accessed and that can be emitted
+// verbatim, scalars are built right away
+
+static PyObject*
+lazy_document_value(LazyDocumentObject* self, size_t index)
+{
+    const Tape* tape = self->tape;
+    const TapeEntry& entry = tape->entries[index];
+
+    if (entry.type != TE_START_OBJECT && entry.type != TE_START_ARRAY)
+        return lazy_document_materialize(self, index);
+
+    if (index == self->root) {
+        Py_INCREF(self);
+        return (PyObject*) self;
+    }
+
+    PyTypeObject* type = Py_TYPE(self);
+    LazyDocumentObject* v = (LazyDocumentObject*) type->tp_alloc(type, 0);
+    if (v == NULL)
+        return NULL;
+
+    v->owner = self->owner != NULL ? self->owner : (PyObject*) self;
+    Py_INCREF(v->owner);
+    v->root = index;
+    v->source = NULL;
+    v->text = self->text;
+    v->datetimeMode = self->datetimeMode;
+    v->uuidMode = self->uuidMode;
+    v->numberMode = self->numberMode;
+    v->parseMode = self->parseMode;
+    v->tape = self->tape;
+    v->keys = self->keys;
+    v->elements = NULL;
+    v->members = -1;
+
+    // The text of the container goes from its opening bracket, just before the position
+    // of the start entry, up to the position of the end one, right after the closing
+    // bracket
+
+    v->json = self->text + entry.position - 1;
+    v->length = (Py_ssize_t) (tape->entries[entry.value.end].position
+                              - entry.position + 1);
+    v->verbatim = self->verbatim;
+    v->isAscii = true;
+    for (Py_ssize_t i = 0; v->verbatim && !self->isAscii && i < v->length; i++) {
+        if ((unsigned char) v->json[i] >= 0x80) {
+            v->isAscii = false;
+            break;
+        }
+    }
+
+    return (PyObject*) v;
+}
+
+
+// Order the members of an object by their key, to count the distinct ones
+
+struct MemberKeyLess {
+    const Tape* tape;
+
+    MemberKeyLess(const Tape* tape)
+        : tape(tape)
+        {}
+
+    bool operator()(size_t a, size_t b) const {
+        const TapeEntry& ka = tape->entries[a];
+        const TapeEntry& kb = tape->entries[b];
+        int rc = memcmp(tape->String(ka), tape->String(kb),
+                        ka.length < kb.length ? ka.length : kb.length);
+        return rc < 0 || (rc == 0 && ka.length < kb.length);
     }
 };
 
 
-typedef struct {
-    PyObject_HEAD
-    unsigned datetimeMode;
-    unsigned uuidMode;
-    unsigned numberMode;
-    unsigned parseMode;
-} DecoderObject;
+// Return the number of distinct keys of the object starting at the given index
 
+static Py_ssize_t
+lazy_document_count_members(const Tape* tape, size_t index)
+{
+    size_t end = tape->entries[index].value.end;
+    std::vector<size_t> keys;
 
-PyDoc_STRVAR(loads_docstring,
-             "loads(string, *, object_hook=None, number_mode=None, datetime_mode=None,"
-             " uuid_mode=None, parse_mode=None, allow_nan=True)\n"
-             "\n"
-             "Decode a JSON string into a Python object.");
+    keys.reserve(tape->entries[end].length);
+    for (size_t i = index + 1; i < end; i = lazy_document_skip(tape, i + 1))
+        keys.push_back(i);
 
+    MemberKeyLess less(tape);
+    std::sort(keys.begin(), keys.end(), less);
 
-static PyObject*
-loads(PyObject* self, PyObject* args, PyObject* kwargs)
+    Py_ssize_t count = 0;
+    for (size_t i = 0; i < keys.size(); i++)
+        if (i == 0 || less(keys[i - 1], keys[i]))
+            count++;
+
+    return count;
+}
+
+
+static void
+lazy_document_dealloc(PyObject* self)
 {
-    /* Converts a JSON encoded string to a Python object. */
+    LazyDocumentObject* d = (LazyDocumentObject*) self;
+
+    delete d->elements;
+    if (d->owner != NULL) {
+        Py_DECREF(d->owner);
+    } else {
+        delete d->tape;
+        delete d->keys;
+        Py_XDECREF(d->source);
+    }
+    Py_TYPE(self)->tp_free(self);
+}
+
 
+static PyObject*
+lazy_document_new(PyTypeObject* type, PyObject* args, PyObject* kwargs)
+{
     static char const* kwlist[] = {
-        "string",
-        "object_hook",
+        "json",
         "number_mode",
         "datetime_mode",
         "uuid_mode",
@@ -1611,7 +6859,6 @@ loads(PyObject* self, PyObject* args, PyObject* kwargs)
         NULL
     };
     PyObject* jsonObject;
-    PyObject* objectHook = NULL;
     PyObject* datetimeModeObj = NULL;
     unsigned datetimeMode = DM_NONE;
     PyObject* uuidModeObj = NULL;
@@ -1622,10 +6869,9 @@ loads(PyObject* self, PyObject* args, PyObject* kwargs)
     unsigned parseMode = PM_NONE;
     int allowNan = -1;
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|$OOOOOp:rapidjson.loads",
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|$OOOOp:LazyDocument",
                                      (char**) kwlist,
                                      &jsonObject,
-                                     &objectHook,
                                      &numberModeObj,
                                      &datetimeModeObj,
                                      &uuidModeObj,
@@ -1633,15 +6879,6 @@ loads(PyObject* self, PyObject* args, PyObject* kwargs)
                                      &allowNan))
         return NULL;
 
-    if (objectHook && !PyCallable_Check(objectHook)) {
-        if (objectHook == Py_None) {
-            objectHook = NULL;
-        } else {
-            PyErr_SetString(PyExc_TypeError, "object_hook is not callable");
-            return NULL;
-        }
-    }
-
     if (!accept_number_mode_arg(numberModeObj, allowNan, numberMode))
         return NULL;
     if (numberMode & NM_DECIMAL && numberMode & NM_NATIVE) {
@@ -1666,239 +6903,224 @@ loads(PyObject* self, PyObject* args, PyObject* kwargs)
     if (!accept_parse_mode_arg(parseModeObj, parseMode))
         return NULL;
 
-    Py_ssize_t jsonStrLen;
+    // Keep an immutable copy of the text, as it is needed to emit the document verbatim
+
+    PyObject* source;
     const char* jsonStr;
-    PyObject* asUnicode = NULL;
+    Py_ssize_t jsonStrLen;
 
     if (PyUnicode_Check(jsonObject)) {
         jsonStr = PyUnicode_AsUTF8AndSize(jsonObject, &jsonStrLen);
-        if (jsonStr == NULL) {
-            return NULL;
-        }
-    } else if (PyBytes_Check(jsonObject) || PyByteArray_Check(jsonObject)) {
-        asUnicode = PyUnicode_FromEncodedObject(jsonObject, "utf-8", NULL);
-        if (asUnicode == NULL)
-            return NULL;
-        jsonStr = PyUnicode_AsUTF8AndSize(asUnicode, &jsonStrLen);
-        if (jsonStr == NULL) {
-            Py_DECREF(asUnicode);
+        if (jsonStr == NULL)
             return NULL;
+        source = jsonObject;
+        Py_INCREF(source);
+    } else if (PyObject_CheckBuffer(jsonObject)) {
+        if (PyBytes_CheckExact(jsonObject)) {
+            source = jsonObject;
+            Py_INCREF(source);
+        } else {
+            source = PyBytes_FromObject(jsonObject);
+            if (source == NULL)
+                return NULL;
         }
+        jsonStr = PyBytes_AS_STRING(source);
+        jsonStrLen = PyBytes_GET_SIZE(source);
     } else {
         PyErr_SetString(PyExc_TypeError,
-                        "Expected string or UTF-8 encoded bytes or bytearray");
+                        "Expected string or UTF-8 encoded bytes-like object");
         return NULL;
     }
 
-    PyObject* result = do_decode(NULL, jsonStr, jsonStrLen, NULL, 0, objectHook,
-                                 numberMode, datetimeMode, uuidMode, parseMode);
+    LazyDocumentObject* d = (LazyDocumentObject*) type->tp_alloc(type, 0);
+    if (d == NULL) {
+        Py_DECREF(source);
+        return NULL;
+    }
 
-    if (asUnicode != NULL)
-        Py_DECREF(asUnicode);
+    d->owner = NULL;
+    d->root = 0;
+    d->elements = NULL;
+    d->members = -1;
+    d->source = source;
+    d->text = jsonStr;
+    d->datetimeMode = datetimeMode;
+    d->uuidMode = uuidMode;
+    d->numberMode = numberMode;
+    d->parseMode = parseMode;
+    d->tape = new Tape();
+    d->keys = new KeyCache();
 
-    return result;
-}
+    if (!parse_into_tape(*d->tape, jsonStr, jsonStrLen, false, numberMode, parseMode,
+                         Py_GetRecursionLimit())) {
+        Py_DECREF(d);
+        return NULL;
+    }
 
+    // Without comments nor trailing commas the text of the root value is valid standard
+    // JSON, unless it contains NaN or Infinity
+
+    bool verbatim = !(parseMode & (PM_COMMENTS | PM_TRAILING_COMMAS));
+    for (size_t i = 0, n = d->tape->entries.size(); verbatim && i < n; i++) {
+        const TapeEntry& entry = d->tape->entries[i];
+        if (entry.type == TE_DOUBLE && !std::isfinite(entry.value.d))
+            verbatim = false;
+        else if (entry.type == TE_NUMBER) {
+            const char* number = d->tape->String(entry);
+            if (number[0] == 'N' || number[0] == 'I' || number[1] == 'I')
+                verbatim = false;
+        }
+    }
 
-PyDoc_STRVAR(load_docstring,
-             "load(stream, *, object_hook=None, number_mode=None, datetime_mode=None,"
-             " uuid_mode=None, parse_mode=None, chunk_size=65536, allow_nan=True)\n"
-             "\n"
-             "Decode a JSON stream into a Python object.");
+    // The root value ends with its last token, possibly followed by other stuff when
+    // PM_STOP_WHEN_DONE is active, and starts after the leading whitespace
 
+    if (verbatim) {
+        jsonStrLen = (Py_ssize_t) d->tape->entries.back().position;
+        while (jsonStrLen > 0 && isspace((unsigned char) *jsonStr)) {
+            jsonStr++;
+            jsonStrLen--;
+        }
+    }
 
-static PyObject*
-load(PyObject* self, PyObject* args, PyObject* kwargs)
+    d->json = jsonStr;
+    d->length = jsonStrLen;
+    d->verbatim = verbatim;
+    d->isAscii = true;
+    for (Py_ssize_t i = 0; verbatim && i < jsonStrLen; i++) {
+        if ((unsigned char) jsonStr[i] >= 0x80) {
+            d->isAscii = false;
+            break;
+        }
+    }
+
+    return (PyObject*) d;
+}
+
+
+static Py_ssize_t
+lazy_document_len(PyObject* self)
 {
-    /* Converts a JSON encoded stream to a Python object. */
+    LazyDocumentObject* d = (LazyDocumentObject*) self;
+    const TapeEntry& root = d->tape->entries[d->root];
 
-    static char const* kwlist[] = {
-        "stream",
-        "object_hook",
-        "number_mode",
-        "datetime_mode",
-        "uuid_mode",
-        "parse_mode",
-        "chunk_size",
+    if (root.type == TE_START_ARRAY)
+        return d->tape->entries[root.value.end].length;
 
-        /* compatibility with stdlib json */
-        "allow_nan",
+    if (root.type != TE_START_OBJECT) {
+        PyErr_SetString(PyExc_TypeError, "The JSON document is not a container");
+        return -1;
+    }
 
-        NULL
-    };
-    PyObject* jsonObject;
-    PyObject* objectHook = NULL;
-    PyObject* datetimeModeObj = NULL;
-    unsigned datetimeMode = DM_NONE;
-    PyObject* uuidModeObj = NULL;
-    unsigned uuidMode = UM_NONE;
-    PyObject* numberModeObj = NULL;
-    unsigned numberMode = NM_NAN;
-    PyObject* parseModeObj = NULL;
-    unsigned parseMode = PM_NONE;
-    PyObject* chunkSizeObj = NULL;
-    size_t chunkSize = 65536;
-    int allowNan = -1;
+    if (d->members < 0)
+        d->members = lazy_document_count_members(d->tape, d->root);
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|$OOOOOOp:rapidjson.load",
-                                     (char**) kwlist,
-                                     &jsonObject,
-                                     &objectHook,
-                                     &numberModeObj,
-                                     &datetimeModeObj,
-                                     &uuidModeObj,
-                                     &parseModeObj,
-                                     &chunkSizeObj,
-                                     &allowNan))
+    return d->members;
+}
+
+
+static PyObject*
+lazy_document_getitem(PyObject* self, PyObject* key)
+{
+    LazyDocumentObject* d = (LazyDocumentObject*) self;
+    size_t found;
+
+    int rc = lazy_document_lookup(d, key, found);
+    if (rc == -1)
         return NULL;
 
-    if (!PyObject_HasAttr(jsonObject, read_name)) {
-        PyErr_SetString(PyExc_TypeError, "Expected file-like object");
+    if (rc == 0) {
+        if (d->tape->entries[d->root].type == TE_START_ARRAY)
+            PyErr_SetString(PyExc_IndexError, "array index out of range");
+        else
+            PyErr_SetObject(PyExc_KeyError, key);
         return NULL;
     }
 
-    if (objectHook && !PyCallable_Check(objectHook)) {
-        if (objectHook == Py_None) {
-            objectHook = NULL;
-        } else {
-            PyErr_SetString(PyExc_TypeError, "object_hook is not callable");
-            return NULL;
-        }
-    }
+    return lazy_document_value(d, found);
+}
 
-    if (numberModeObj) {
-        if (numberModeObj == Py_None) {
-            numberMode = NM_NONE;
-        } else if (PyLong_Check(numberModeObj)) {
-            int mode = PyLong_AsLong(numberModeObj);
-            if (mode < 0 || mode >= NM_MAX) {
-                PyErr_SetString(PyExc_ValueError, "Invalid number_mode");
-                return NULL;
-            }
-            numberMode = (unsigned) mode;
-            if (numberMode & NM_DECIMAL && numberMode & NM_NATIVE) {
-                PyErr_SetString(PyExc_ValueError,
-                                "Combining NM_NATIVE with NM_DECIMAL is not supported");
-                return NULL;
-            }
-        }
-    }
-    if (allowNan != -1) {
-        if (allowNan)
-            numberMode |= NM_NAN;
-        else
-            numberMode &= ~NM_NAN;
-    }
 
-    if (datetimeModeObj) {
-        if (datetimeModeObj == Py_None) {
-            datetimeMode = DM_NONE;
-        } else if (PyLong_Check(datetimeModeObj)) {
-            int mode = PyLong_AsLong(datetimeModeObj);
-            if (!valid_datetime_mode(mode)) {
-                PyErr_SetString(PyExc_ValueError, "Invalid datetime_mode");
-                return NULL;
-            }
-            datetimeMode = (unsigned) mode;
-            if (datetimeMode && datetime_mode_format(datetimeMode) != DM_ISO8601) {
-                PyErr_SetString(PyExc_ValueError,
-                                "Invalid datetime_mode, can deserialize only from"
-                                " ISO8601");
-                return NULL;
-            }
-        } else {
-            PyErr_SetString(PyExc_TypeError,
-                            "datetime_mode must be a non-negative integer value or None");
-            return NULL;
-        }
-    }
+static int
+lazy_document_contains(PyObject* self, PyObject* key)
+{
+    LazyDocumentObject* d = (LazyDocumentObject*) self;
+    const Tape* tape = d->tape;
+    const TapeEntry& root = tape->entries[d->root];
 
-    if (uuidModeObj) {
-        if (uuidModeObj == Py_None) {
-            uuidMode = UM_NONE;
-        } else if (PyLong_Check(uuidModeObj)) {
-            int mode = PyLong_AsLong(uuidModeObj);
-            if (mode < 0 || mode >= UM_MAX) {
-                PyErr_SetString(PyExc_ValueError, "Invalid uuid_mode");
-                return NULL;
-            }
-            uuidMode = (unsigned) mode;
-        } else {
-            PyErr_SetString(PyExc_TypeError,
-                            "uuid_mode must be an integer value or None");
-            return NULL;
-        }
+    if (root.type != TE_START_ARRAY) {
+        size_t found;
+        return lazy_document_lookup(d, key, found);
     }
 
-    if (parseModeObj) {
-        if (parseModeObj == Py_None) {
-            parseMode = PM_NONE;
-        } else if (PyLong_Check(parseModeObj)) {
-            int mode = PyLong_AsLong(parseModeObj);
-            if (mode < 0 || mode >= PM_MAX) {
-                PyErr_SetString(PyExc_ValueError, "Invalid parse_mode");
-                return NULL;
-            }
-            parseMode = (unsigned) mode;
-        } else {
-            PyErr_SetString(PyExc_TypeError,
-                            "parse_mode must be an integer value or None");
-            return NULL;
-        }
-    }
+    // A list or a dictionary is never equal to a scalar, so in that case there is no
+    // need to build the nested containers to compare them
 
-    if (chunkSizeObj && chunkSizeObj != Py_None) {
-        if (PyLong_Check(chunkSizeObj)) {
-            Py_ssize_t size = PyNumber_AsSsize_t(chunkSizeObj, PyExc_ValueError);
-            if (PyErr_Occurred() || size < 4 || size > UINT_MAX) {
-                PyErr_SetString(PyExc_ValueError,
-                                "Invalid chunk_size, must be an integer between 4 and"
-                                " UINT_MAX");
-                return NULL;
-            }
-            chunkSize = (size_t) size;
-        } else {
-            PyErr_SetString(PyExc_TypeError,
-                            "chunk_size must be an unsigned integer value or None");
-            return NULL;
-        }
+    bool scalar = (key == Py_None || PyBool_Check(key) || PyLong_CheckExact(key)
+                   || PyFloat_CheckExact(key) || PyUnicode_CheckExact(key));
+
+    for (size_t i = d->root + 1; i < root.value.end; i = lazy_document_skip(tape, i)) {
+        unsigned char type = tape->entries[i].type;
+
+        if (scalar && (type == TE_START_OBJECT || type == TE_START_ARRAY))
+            continue;
+
+        PyObject* value = lazy_document_value(d, i);
+        if (value == NULL)
+            return -1;
+
+        int rc = PyObject_RichCompareBool(value, key, Py_EQ);
+        Py_DECREF(value);
+        if (rc != 0)
+            return rc;
     }
 
-    return do_decode(NULL, NULL, 0, jsonObject, chunkSize, objectHook,
-                     numberMode, datetimeMode, uuidMode, parseMode);
+    return 0;
+}
+
+
+/* Iterator over the elements of a LazyDocument array, yielding the same values, possibly
+   views on nested containers, returned by indexing it. */
+
+typedef struct {
+    PyObject_HEAD
+    LazyDocumentObject* document;
+    // The tape index of the next element and the end of the array
+    size_t next;
+    size_t end;
+} LazyDocumentIteratorObject;
+
+
+static void
+lazy_document_iterator_dealloc(PyObject* self)
+{
+    LazyDocumentIteratorObject* it = (LazyDocumentIteratorObject*) self;
+
+    Py_XDECREF(it->document);
+    Py_TYPE(self)->tp_free(self);
 }
 
 
-PyDoc_STRVAR(decoder_doc,
-             "Decoder(number_mode=None, datetime_mode=None, uuid_mode=None,"
-             " parse_mode=None)\n"
-             "\n"
-             "Create and return a new Decoder instance.");
+static PyObject*
+lazy_document_iterator_next(PyObject* self)
+{
+    LazyDocumentIteratorObject* it = (LazyDocumentIteratorObject*) self;
 
+    if (it->next >= it->end)
+        return NULL;
 
-static PyMemberDef decoder_members[] = {
-    {"datetime_mode",
-     T_UINT, offsetof(DecoderObject, datetimeMode), READONLY,
-     "The datetime mode, whether and how datetime literals will be recognized."},
-    {"uuid_mode",
-     T_UINT, offsetof(DecoderObject, uuidMode), READONLY,
-     "The UUID mode, whether and how UUID literals will be recognized."},
-    {"number_mode",
-     T_UINT, offsetof(DecoderObject, numberMode), READONLY,
-     "The number mode, whether numeric literals will be decoded."},
-    {"parse_mode",
-     T_UINT, offsetof(DecoderObject, parseMode), READONLY,
-     "The parse mode, whether comments and trailing commas are allowed."},
-    {NULL}
-};
+    size_t index = it->next;
+    it->next = lazy_document_skip(it->document->tape, index);
+    return lazy_document_value(it->document, index);
+}
 
 
-static PyTypeObject Decoder_Type = {
+static PyTypeObject LazyDocumentIterator_Type = {
     PyVarObject_HEAD_INIT(NULL, 0)
-    "rapidjson.Decoder",                      /* tp_name */
-    sizeof(DecoderObject),                    /* tp_basicsize */
+    "rapidjson.LazyDocumentIterator",         /* tp_name */
+    sizeof(LazyDocumentIteratorObject),       /* tp_basicsize */
     0,                                        /* tp_itemsize */
-    0,                                        /* tp_dealloc */
+    (destructor) lazy_document_iterator_dealloc, /* tp_dealloc */
     0,                                        /* tp_print */
     0,                                        /* tp_getattr */
     0,                                        /* tp_setattr */
@@ -1908,21 +7130,21 @@ static PyTypeObject Decoder_Type = {
     0,                                        /* tp_as_sequence */
     0,                                        /* tp_as_mapping */
     0,                                        /* tp_hash */
-    (ternaryfunc) decoder_call,               /* tp_call */
+    0,                                        /* tp_call */
     0,                                        /* tp_str */
     0,                                        /* tp_getattro */
     0,                                        /* tp_setattro */
     0,                                        /* tp_as_buffer */
-    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE, /* tp_flags */
-    decoder_doc,                              /* tp_doc */
+    Py_TPFLAGS_DEFAULT,                       /* tp_flags */
+    0,                                        /* tp_doc */
     0,                                        /* tp_traverse */
     0,                                        /* tp_clear */
     0,                                        /* tp_richcompare */
     0,                                        /* tp_weaklistoffset */
-    0,                                        /* tp_iter */
-    0,                                        /* tp_iternext */
+    PyObject_SelfIter,                        /* tp_iter */
+    lazy_document_iterator_next,              /* tp_iternext */
     0,                                        /* tp_methods */
-    decoder_members,                          /* tp_members */
+    0,                                        /* tp_members */
     0,                                        /* tp_getset */
     0,                                        /* tp_base */
     0,                                        /* tp_dict */
@@ -1931,367 +7153,315 @@ static PyTypeObject Decoder_Type = {
     0,                                        /* tp_dictoffset */
     0,                                        /* tp_init */
     0,                                        /* tp_alloc */
-    decoder_new,                              /* tp_new */
+    0,                                        /* tp_new */
     PyObject_Del,                             /* tp_free */
 };
 
 
-#define Decoder_CheckExact(v) (Py_TYPE(v) == &Decoder_Type)
-#define Decoder_Check(v) PyObject_TypeCheck(v, &Decoder_Type)
-
-
-#define DECODE(r, f, s, h)                                              \
-    do {                                                                \
-        /* FIXME: isn't there a cleverer way to write the following?    \
-                                                                        \
-           Ideally, one would do something like:                        \
-                                                                        \
-               unsigned flags = kParseInsituFlag;                       \
-                                                                        \
-               if (! (numberMode & NM_NATIVE))                          \
-                   flags |= kParseNumbersAsStringsFlag;                 \
-               if (numberMode & NM_NAN)                                 \
-                   flags |= kParseNanAndInfFlag;                        \
-               if (parseMode & PM_COMMENTS)                             \
-                   flags |= kParseCommentsFlag;                         \
-               if (parseMode & PM_TRAILING_COMMAS)                      \
-                   flags |= kParseTrailingCommasFlag;                   \
-                                                                        \
-               reader.Parse<flags>(ss, handler);                        \
-                                                                        \
-           but C++ does not allow that...                               \
-        */                                                              \
-                                                                        \
-        if (numberMode & NM_NAN) {                                      \
-            if (numberMode & NM_NATIVE) {                               \
-                if (parseMode & PM_TRAILING_COMMAS) {                   \
-                    if (parseMode & PM_COMMENTS) {                      \
-                        r.Parse<f |                                     \
-                                kParseNanAndInfFlag |                   \
-                                kParseCommentsFlag |                    \
-                                kParseTrailingCommasFlag>(s, h);        \
-                    } else {                                            \
-                        r.Parse<f |                                     \
-                                kParseNanAndInfFlag |                   \
-                                kParseTrailingCommasFlag>(s, h);        \
-                    }                                                   \
-                } else if (parseMode & PM_COMMENTS) {                   \
-                    r.Parse<f |                                         \
-                            kParseNanAndInfFlag |                       \
-                            kParseCommentsFlag>(s, h);                  \
-                } else {                                                \
-                    r.Parse<f |                                         \
-                            kParseNanAndInfFlag>(s, h);                 \
-                }                                                       \
-            } else if (parseMode & PM_TRAILING_COMMAS) {                \
-                if (parseMode & PM_COMMENTS) {                          \
-                    r.Parse<f |                                         \
-                            kParseNumbersAsStringsFlag |                \
-                            kParseNanAndInfFlag |                       \
-                            kParseCommentsFlag |                        \
-                            kParseTrailingCommasFlag>(s, h);            \
-                } else {                                                \
-                    r.Parse<f |                                         \
-                            kParseNumbersAsStringsFlag |                \
-                            kParseNanAndInfFlag |                       \
-                            kParseTrailingCommasFlag>(s, h);            \
-                }                                                       \
-            } else if (parseMode & PM_COMMENTS) {                       \
-                r.Parse<f |                                             \
-                        kParseNumbersAsStringsFlag |                    \
-                        kParseNanAndInfFlag |                           \
-                        kParseCommentsFlag>(s, h);                      \
-            } else {                                                    \
-                r.Parse<f |                                             \
-                        kParseNumbersAsStringsFlag |                    \
-                        kParseNanAndInfFlag>(s, h);                     \
-            }                                                           \
-        } else if (numberMode & NM_NATIVE) {                            \
-            if (parseMode & PM_TRAILING_COMMAS) {                       \
-                if (parseMode & PM_COMMENTS) {                          \
-                    r.Parse<f |                                         \
-                            kParseCommentsFlag |                        \
-                            kParseTrailingCommasFlag>(s, h);            \
-                } else {                                                \
-                    r.Parse<f |                                         \
-                            kParseTrailingCommasFlag>(s, h);            \
-                }                                                       \
-            } else if (parseMode & PM_COMMENTS) {                       \
-                r.Parse<f |                                             \
-                        kParseCommentsFlag>(s, h);                      \
-            } else {                                                    \
-                r.Parse<f>(s, h);                                       \
-            }                                                           \
-        } else if (parseMode & PM_TRAILING_COMMAS) {                    \
-            if (parseMode & PM_COMMENTS) {                              \
-                r.Parse<f |                                             \
-                        kParseCommentsFlag |                            \
-                        kParseNumbersAsStringsFlag>(s, h);              \
-            } else {                                                    \
-                r.Parse<f |                                             \
-                        kParseNumbersAsStringsFlag |                    \
-                        kParseTrailingCommasFlag>(s, h);                \
-            }                                                           \
-        } else {                                                        \
-            r.Parse<f | kParseNumbersAsStringsFlag>(s, h);              \
-        }                                                               \
-    } while(0)
-
-
 static PyObject*
-do_decode(PyObject* decoder, const char* jsonStr, Py_ssize_t jsonStrLen,
-          PyObject* jsonStream, size_t chunkSize, PyObject* objectHook,
-          unsigned numberMode, unsigned datetimeMode, unsigned uuidMode,
-          unsigned parseMode)
+lazy_document_iter(PyObject* self)
 {
-    PyHandler handler(decoder, objectHook, datetimeMode, uuidMode, numberMode);
-    Reader reader;
+    LazyDocumentObject* d = (LazyDocumentObject*) self;
+    const TapeEntry& root = d->tape->entries[d->root];
 
-    if (jsonStr != NULL) {
-        char* jsonStrCopy = (char*) PyMem_Malloc(sizeof(char) * (jsonStrLen+1));
+    if (root.type != TE_START_ARRAY) {
+        PyObject* keys = PyObject_CallMethod(self, "keys", NULL);
+        if (keys == NULL)
+            return NULL;
 
-        if (jsonStrCopy == NULL)
-            return PyErr_NoMemory();
+        PyObject* iterator = PyObject_GetIter(keys);
+        Py_DECREF(keys);
+        return iterator;
+    }
 
-        memcpy(jsonStrCopy, jsonStr, jsonStrLen+1);
+    LazyDocumentIteratorObject* it = PyObject_New(LazyDocumentIteratorObject,
+                                                  &LazyDocumentIterator_Type);
+    if (it == NULL)
+        return NULL;
 
-        InsituStringStream ss(jsonStrCopy);
+    Py_INCREF(self);
+    it->document = d;
+    it->next = d->root + 1;
+    it->end = root.value.end;
 
-        DECODE(reader, kParseInsituFlag, ss, handler);
+    return (PyObject*) it;
+}
 
-        PyMem_Free(jsonStrCopy);
-    } else {
-        PyReadStreamWrapper sw(jsonStream, chunkSize);
 
-        DECODE(reader, kParseNoFlags, sw, handler);
-    }
+PyDoc_STRVAR(lazy_document_get_docstring,
+             "get(key, default=None)\n"
+             "\n"
+             "Return the value for key if present, else default.");
 
-    if (reader.HasParseError()) {
-        size_t offset = reader.GetErrorOffset();
-
-        if (PyErr_Occurred()) {
-            PyObject* etype;
-            PyObject* evalue;
-            PyObject* etraceback;
-            PyErr_Fetch(&etype, &evalue, &etraceback);
-
-            // Try to add the offset in the error message if the exception
-            // value is a string.  Otherwise, use the original exception since
-            // we can't be sure the exception type takes a single string.
-            if (evalue != NULL && PyUnicode_Check(evalue)) {
-                PyErr_Format(etype, "Parse error at offset %zu: %S", offset, evalue);
-                Py_DECREF(etype);
-                Py_DECREF(evalue);
-                Py_XDECREF(etraceback);
-            }
-            else
-                PyErr_Restore(etype, evalue, etraceback);
-        }
-        else
-            PyErr_Format(decode_error, "Parse error at offset %zu: %s",
-                         offset, GetParseError_En(reader.GetParseErrorCode()));
 
-        Py_XDECREF(handler.root);
+static PyObject*
+lazy_document_get(PyObject* self, PyObject* args)
+{
+    LazyDocumentObject* d = (LazyDocumentObject*) self;
+    PyObject* key;
+    PyObject* defaultValue = Py_None;
+    size_t found;
+
+    if (!PyArg_ParseTuple(args, "O|O:get", &key, &defaultValue))
         return NULL;
-    } else if (PyErr_Occurred()) {
-        // Catch possible error raised in associated stream operations
-        Py_XDECREF(handler.root);
+
+    int rc = lazy_document_lookup(d, key, found);
+    if (rc == -1)
         return NULL;
+
+    if (rc == 0) {
+        Py_INCREF(defaultValue);
+        return defaultValue;
     }
 
-    return handler.root;
+    return lazy_document_value(d, found);
 }
 
 
+PyDoc_STRVAR(lazy_document_keys_docstring,
+             "keys()\n"
+             "\n"
+             "Return the list of the keys of the JSON object.");
+
+
 static PyObject*
-decoder_call(PyObject* self, PyObject* args, PyObject* kwargs)
+lazy_document_keys(PyObject* self, PyObject* Py_UNUSED(ignored))
 {
-    static char const* kwlist[] = {
-        "json",
-        "chunk_size",
-        NULL
-    };
-    PyObject* jsonObject;
-    PyObject* chunkSizeObj = NULL;
-    size_t chunkSize = 65536;
+    LazyDocumentObject* d = (LazyDocumentObject*) self;
+    const Tape* tape = d->tape;
+    const TapeEntry& root = tape->entries[d->root];
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|$O",
-                                     (char**) kwlist,
-                                     &jsonObject,
-                                     &chunkSizeObj))
+    if (root.type != TE_START_OBJECT) {
+        PyErr_SetString(PyExc_TypeError, "The JSON document is not an object");
         return NULL;
-
-    if (chunkSizeObj && chunkSizeObj != Py_None) {
-        if (PyLong_Check(chunkSizeObj)) {
-            Py_ssize_t size = PyNumber_AsSsize_t(chunkSizeObj, PyExc_ValueError);
-            if (PyErr_Occurred() || size < 4 || size > UINT_MAX) {
-                PyErr_SetString(PyExc_ValueError,
-                                "Invalid chunk_size, must be an integer between 4 and"
-                                " UINT_MAX");
-                return NULL;
-            }
-            chunkSize = (size_t) size;
-        } else {
-            PyErr_SetString(PyExc_TypeError,
-                            "chunk_size must be an unsigned integer value or None");
-            return NULL;
-        }
     }
 
-    Py_ssize_t jsonStrLen;
-    const char* jsonStr;
-    PyObject* asUnicode = NULL;
+    // Use a dictionary to get rid of repeated keys, preserving their order
 
-    if (PyUnicode_Check(jsonObject)) {
-        jsonStr = PyUnicode_AsUTF8AndSize(jsonObject, &jsonStrLen);
-        if (jsonStr == NULL)
-            return NULL;
-    } else if (PyBytes_Check(jsonObject) || PyByteArray_Check(jsonObject)) {
-        asUnicode = PyUnicode_FromEncodedObject(jsonObject, "utf-8", NULL);
-        if (asUnicode == NULL)
+    PyObject* keys = PyDict_New();
+    if (keys == NULL)
+        return NULL;
+
+    for (size_t i = d->root + 1;
+         i < root.value.end;
+         i = lazy_document_skip(tape, i + 1)) {
+        const TapeEntry& entry = tape->entries[i];
+        PyObject* key = d->keys->Get(tape->String(entry), entry.length);
+        if (key == NULL) {
+            Py_DECREF(keys);
             return NULL;
-        jsonStr = PyUnicode_AsUTF8AndSize(asUnicode, &jsonStrLen);
-        if (jsonStr == NULL) {
-            Py_DECREF(asUnicode);
+        }
+        int rc = PyDict_SetItem(keys, key, Py_None);
+        Py_DECREF(key);
+        if (rc == -1) {
+            Py_DECREF(keys);
             return NULL;
         }
-    } else if (PyObject_HasAttr(jsonObject, read_name)) {
-        jsonStr = NULL;
-        jsonStrLen = 0;
-    } else {
-        PyErr_SetString(
-            PyExc_TypeError,
-            "Expected string or UTF-8 encoded bytes or bytearray or a file-like object");
-        return NULL;
     }
 
-    DecoderObject* d = (DecoderObject*) self;
-
-    PyObject* result = do_decode(self, jsonStr, jsonStrLen, jsonObject, chunkSize, NULL,
-                                 d->numberMode, d->datetimeMode, d->uuidMode,
-                                 d->parseMode);
-
-    if (asUnicode != NULL)
-        Py_DECREF(asUnicode);
-
+    PyObject* result = PyDict_Keys(keys);
+    Py_DECREF(keys);
     return result;
 }
 
 
+PyDoc_STRVAR(lazy_document_resolve_docstring,
+             "resolve(pointer)\n"
+             "\n"
+             "Return the value referenced by the given JSON Pointer.");
+
+
 static PyObject*
-decoder_new(PyTypeObject* type, PyObject* args, PyObject* kwargs)
+lazy_document_resolve(PyObject* self, PyObject* pointer)
 {
-    DecoderObject* d;
-    PyObject* datetimeModeObj = NULL;
-    unsigned datetimeMode = DM_NONE;
-    PyObject* uuidModeObj = NULL;
-    unsigned uuidMode = UM_NONE;
-    PyObject* numberModeObj = NULL;
-    unsigned numberMode = NM_NAN;
-    PyObject* parseModeObj = NULL;
-    unsigned parseMode = PM_NONE;
-    static char const* kwlist[] = {
-        "number_mode",
-        "datetime_mode",
-        "uuid_mode",
-        "parse_mode",
-        NULL
-    };
+    LazyDocumentObject* d = (LazyDocumentObject*) self;
+    const Tape* tape = d->tape;
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|OOOO:Decoder",
-                                     (char**) kwlist,
-                                     &numberModeObj,
-                                     &datetimeModeObj,
-                                     &uuidModeObj,
-                                     &parseModeObj))
+    if (!PyUnicode_Check(pointer)) {
+        PyErr_SetString(PyExc_TypeError, "pointer must be a string");
         return NULL;
+    }
 
-    if (numberModeObj) {
-        if (numberModeObj == Py_None) {
-            numberMode = NM_NONE;
-        } else if (PyLong_Check(numberModeObj)) {
-            int mode = PyLong_AsLong(numberModeObj);
-            if (mode < 0 || mode >= NM_MAX) {
-                PyErr_SetString(PyExc_ValueError, "Invalid number_mode");
-                return NULL;
-            }
-            numberMode = (unsigned) mode;
-            if (numberMode & NM_DECIMAL && numberMode & NM_NATIVE) {
-                PyErr_SetString(PyExc_ValueError,
-                                "Combining NM_NATIVE with NM_DECIMAL is not supported");
-                return NULL;
-            }
-        }
+    Py_ssize_t length;
+    const char* str = PyUnicode_AsUTF8AndSize(pointer, &length);
+    if (str == NULL)
+        return NULL;
+
+    if (length > 0 && str[0] != '/') {
+        PyErr_Format(PyExc_ValueError, "Invalid JSON Pointer: %R", pointer);
+        return NULL;
     }
 
-    if (datetimeModeObj) {
-        if (datetimeModeObj == Py_None) {
-            datetimeMode = DM_NONE;
-        } else if (PyLong_Check(datetimeModeObj)) {
-            int mode = PyLong_AsLong(datetimeModeObj);
-            if (!valid_datetime_mode(mode)) {
-                PyErr_SetString(PyExc_ValueError, "Invalid datetime_mode");
-                return NULL;
-            }
-            datetimeMode = (unsigned) mode;
-            if (datetimeMode && datetime_mode_format(datetimeMode) != DM_ISO8601) {
-                PyErr_SetString(PyExc_ValueError,
-                                "Invalid datetime_mode, can deserialize only from"
-                                " ISO8601");
-                return NULL;
-            }
-        } else {
-            PyErr_SetString(PyExc_TypeError,
-                            "datetime_mode must be a non-negative integer value or None");
-            return NULL;
+    const char* end = str + length;
+    size_t index = d->root;
+    std::string token;
+
+    while (str < end) {
+        // Skip the slash and collect the next reference token, unescaping it
+
+        token.clear();
+        for (str++; str < end && *str != '/'; str++) {
+            if (*str == '~') {
+                if (str + 1 < end && (str[1] == '0' || str[1] == '1')) {
+                    token += str[1] == '0' ? '~' : '/';
+                    str++;
+                } else {
+                    PyErr_Format(PyExc_ValueError, "Invalid JSON Pointer: %R", pointer);
+                    return NULL;
+                }
+            } else
+                token += *str;
         }
-    }
 
-    if (uuidModeObj) {
-        if (uuidModeObj == Py_None) {
-            uuidMode = UM_NONE;
-        } else if (PyLong_Check(uuidModeObj)) {
-            int mode = PyLong_AsLong(uuidModeObj);
-            if (mode < 0 || mode >= UM_MAX) {
-                PyErr_SetString(PyExc_ValueError, "Invalid uuid_mode");
-                return NULL;
+        const TapeEntry& entry = tape->entries[index];
+        bool found;
+
+        if (entry.type == TE_START_OBJECT) {
+            found = lazy_document_find_member(tape, index, token.data(), token.size(),
+                                              index);
+        } else if (entry.type == TE_START_ARRAY) {
+            // Only canonical non-negative decimal numbers are valid array indexes: the
+            // value saturates at the number of elements, so that any longer one is
+            // simply out of range
+
+            size_t count = tape->entries[entry.value.end].length;
+            size_t position = 0;
+
+            found = !token.empty() && (token[0] != '0' || token.size() == 1);
+            for (size_t i = 0; found && i < token.size(); i++) {
+                found = isdigit((unsigned char) token[i]);
+                if (position < count)
+                    position = position * 10 + (token[i] - '0');
             }
-            uuidMode = (unsigned) mode;
-        } else {
-            PyErr_SetString(PyExc_TypeError,
-                            "uuid_mode must be an integer value or None");
+            if (found)
+                found = (position < count
+                         && lazy_document_find_element(tape, index,
+                                                       (Py_ssize_t) position, index));
+        } else
+            found = false;
+
+        if (!found) {
+            PyErr_SetObject(PyExc_KeyError, pointer);
             return NULL;
         }
     }
 
-    if (parseModeObj) {
-        if (parseModeObj == Py_None) {
-            parseMode = PM_NONE;
-        } else if (PyLong_Check(parseModeObj)) {
-            int mode = PyLong_AsLong(parseModeObj);
-            if (mode < 0 || mode >= PM_MAX) {
-                PyErr_SetString(PyExc_ValueError, "Invalid parse_mode");
-                return NULL;
-            }
-            parseMode = (unsigned) mode;
-        } else {
-            PyErr_SetString(PyExc_TypeError,
-                            "parse_mode must be an integer value or None");
+    return lazy_document_value(d, index);
+}
+
+
+// Compare the Python value of the document with the other one, so that views on nested
+// containers can be compared with plain lists and dictionaries
+
+static PyObject*
+lazy_document_richcompare(PyObject* self, PyObject* other, int op)
+{
+    if (op != Py_EQ && op != Py_NE)
+        Py_RETURN_NOTIMPLEMENTED;
+
+    LazyDocumentObject* d = (LazyDocumentObject*) self;
+    PyObject* value = lazy_document_materialize(d, d->root);
+    if (value == NULL)
+        return NULL;
+
+    PyObject* otherValue;
+    if (PyObject_TypeCheck(other, Py_TYPE(self))) {
+        LazyDocumentObject* o = (LazyDocumentObject*) other;
+        otherValue = lazy_document_materialize(o, o->root);
+        if (otherValue == NULL) {
+            Py_DECREF(value);
             return NULL;
         }
+    } else {
+        otherValue = other;
+        Py_INCREF(otherValue);
     }
 
-    d = (DecoderObject*) type->tp_alloc(type, 0);
-    if (d == NULL)
-        return NULL;
+    PyObject* result = PyObject_RichCompare(value, otherValue, op);
+    Py_DECREF(value);
+    Py_DECREF(otherValue);
+    return result;
+}
 
-    d->datetimeMode = datetimeMode;
-    d->uuidMode = uuidMode;
-    d->numberMode = numberMode;
-    d->parseMode = parseMode;
 
-    return (PyObject*) d;
-}
+static PyMappingMethods lazy_document_as_mapping = {
+    lazy_document_len,                        /* mp_length */
+    lazy_document_getitem,                    /* mp_subscript */
+    0,                                        /* mp_ass_subscript */
+};
+
+
+static PySequenceMethods lazy_document_as_sequence = {
+    0,                                        /* sq_length */
+    0,                                        /* sq_concat */
+    0,                                        /* sq_repeat */
+    0,                                        /* sq_item */
+    0,                                        /* was_sq_slice */
+    0,                                        /* sq_ass_item */
+    0,                                        /* was_sq_ass_slice */
+    lazy_document_contains,                   /* sq_contains */
+};
+
+
+static PyMethodDef lazy_document_methods[] = {
+    {"get", (PyCFunction) lazy_document_get, METH_VARARGS,
+     lazy_document_get_docstring},
+    {"keys", (PyCFunction) lazy_document_keys, METH_NOARGS,
+     lazy_document_keys_docstring},
+    {"resolve", (PyCFunction) lazy_document_resolve, METH_O,
+     lazy_document_resolve_docstring},
+    {NULL, NULL, 0, NULL}                     /* sentinel */
+};
+
+
+PyDoc_STRVAR(lazy_document_doc,
+             "LazyDocument(json, *, number_mode=None, datetime_mode=None,"
+             " uuid_mode=None, parse_mode=None, allow_nan=True)\n"
+             "\n"
+             "Parse a JSON document, building its Python values only on access.");
+
+
+static PyTypeObject LazyDocument_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "rapidjson.LazyDocument",                 /* tp_name */
+    sizeof(LazyDocumentObject),               /* tp_basicsize */
+    0,                                        /* tp_itemsize */
+    (destructor) lazy_document_dealloc,       /* tp_dealloc */
+    0,                                        /* tp_print */
+    0,                                        /* tp_getattr */
+    0,                                        /* tp_setattr */
+    0,                                        /* tp_compare */
+    0,                                        /* tp_repr */
+    0,                                        /* tp_as_number */
+    &lazy_document_as_sequence,               /* tp_as_sequence */
+    &lazy_document_as_mapping,                /* tp_as_mapping */
+    0,                                        /* tp_hash */
+    0,                                        /* tp_call */
+    0,                                        /* tp_str */
+    0,                                        /* tp_getattro */
+    0,                                        /* tp_setattro */
+    0,                                        /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                       /* tp_flags */
+    lazy_document_doc,                        /* tp_doc */
+    0,                                        /* tp_traverse */
+    0,                                        /* tp_clear */
+    lazy_document_richcompare,                /* tp_richcompare */
+    0,                                        /* tp_weaklistoffset */
+    lazy_document_iter,                       /* tp_iter */
+    0,                                        /* tp_iternext */
+    lazy_document_methods,                    /* tp_methods */
+    0,                                        /* tp_members */
+    0,                                        /* tp_getset */
+    0,                                        /* tp_base */
+    0,                                        /* tp_dict */
+    0,                                        /* tp_descr_get */
+    0,                                        /* tp_descr_set */
+    0,                                        /* tp_dictoffset */
+    0,                                        /* tp_init */
+    0,                                        /* tp_alloc */
+    lazy_document_new,                        /* tp_new */
+    PyObject_Del,                             /* tp_free */
+};
 
 
 /////////////
@@ -2327,6 +7497,29 @@ all_keys_are_string(PyObject* dict) {
 }
 
 
+/* Tell whether the writer can emit a LazyDocument text as is: the pretty one cannot, as
+   it would not indent it, and the one producing ASCII output can do that only when the
+   text is pure ASCII. */
+
+template <typename WriterT>
+struct WriterTraits {
+    static const bool verbatim = false;
+    static const bool asciiOnly = false;
+};
+
+template <typename OS, typename SE, typename TE, typename A, unsigned F>
+struct WriterTraits<Writer<OS, SE, TE, A, F> > {
+    static const bool verbatim = true;
+    static const bool asciiOnly = false;
+};
+
+template <typename OS, typename SE, typename A, unsigned F>
+struct WriterTraits<Writer<OS, SE, ASCII<>, A, F> > {
+    static const bool verbatim = true;
+    static const bool asciiOnly = true;
+};
+
+
 template<typename WriterT>
 static bool
 dumps_internal(
@@ -2424,21 +7617,43 @@ dumps_internal(
         } else {
             // Mimic stdlib json: subclasses of int may override __repr__, but we still
             // want to encode them as integers in JSON; one example within the standard
-            // library is IntEnum
+            // library is IntEnum. Those that fit in 64 bits are written directly by
+            // RapidJSON, only bigger ones go thru the base int.__repr__()
 
-            PyObject* intStrObj = PyLong_Type.tp_repr(object);
-            if (intStrObj == NULL)
+            int overflow;
+            long long i = PyLong_AsLongLongAndOverflow(object, &overflow);
+            if (i == -1 && PyErr_Occurred())
                 return false;
 
-            Py_ssize_t size;
-            const char* intStr = PyUnicode_AsUTF8AndSize(intStrObj, &size);
-            if (intStr == NULL) {
-                Py_DECREF(intStrObj);
-                return false;
+            bool isUnsigned = false;
+            unsigned long long ui = 0;
+            if (overflow > 0) {
+                ui = PyLong_AsUnsignedLongLong(object);
+                if (PyErr_Occurred())
+                    PyErr_Clear();
+                else
+                    isUnsigned = true;
             }
 
-            writer->RawValue(intStr, size, kNumberType);
-            Py_DECREF(intStrObj);
+            if (overflow == 0) {
+                writer->Int64(i);
+            } else if (isUnsigned) {
+                writer->Uint64(ui);
+            } else {
+                PyObject* intStrObj = PyLong_Type.tp_repr(object);
+                if (intStrObj == NULL)
+                    return false;
+
+                Py_ssize_t size;
+                const char* intStr = PyUnicode_AsUTF8AndSize(intStrObj, &size);
+                if (intStr == NULL) {
+                    Py_DECREF(intStrObj);
+                    return false;
+                }
+
+                writer->RawValue(intStr, size, kNumberType);
+                Py_DECREF(intStrObj);
+            }
         }
     } else if (PyFloat_Check(object)) {
         double d = PyFloat_AS_DOUBLE(object);
@@ -2462,22 +7677,13 @@ dumps_internal(
             }
         } else {
             // The RJ dtoa() produces "strange" results for particular values, see #101:
-            // use Python's repr() to emit a raw value instead of writer->Double(d)
-
-            PyObject* dr = PyFloat_Type.tp_repr(object);
-
-            if (dr == NULL)
-                return false;
+            // emit the same representation of Python's repr() as a raw value instead of
+            // writer->Double(d)
 
-            Py_ssize_t l;
-            const char* rs = PyUnicode_AsUTF8AndSize(dr, &l);
-            if (rs == NULL) {
-                Py_DECREF(dr);
-                return false;
-            }
+            char dr[25];
+            int l = double_to_repr(d, dr);
 
-            writer->RawValue(rs, l, kNumberType);
-            Py_DECREF(dr);
+            writer->RawValue(dr, l, kNumberType);
         }
     } else if (PyUnicode_Check(object)) {
         Py_ssize_t l;
@@ -2987,6 +8193,24 @@ dumps_internal(
             return false;
         ASSERT_VALID_SIZE(l);
         writer->RawValue(jsonStr, (SizeType) l, kStringType);
+    } else if (PyObject_TypeCheck(object, &LazyDocument_Type)) {
+        LazyDocumentObject* d = (LazyDocumentObject*) object;
+
+        if (d->verbatim
+            && WriterTraits<WriterT>::verbatim
+            && (d->isAscii || !WriterTraits<WriterT>::asciiOnly)
+            && mappingMode == MM_ANY_MAPPING) {
+            ASSERT_VALID_SIZE(d->length);
+            writer->RawValue(d->json, (SizeType) d->length, kStringType);
+        } else {
+            PyObject* value = lazy_document_materialize(d, d->root);
+            if (value == NULL)
+                return false;
+            bool r = RECURSE(value);
+            Py_DECREF(value);
+            if (!r)
+                return false;
+        }
     } else if (defaultFn) {
         PyObject* retval = PyObject_CallFunctionObjArgs(defaultFn, object, NULL);
         if (retval == NULL)
@@ -3025,15 +8249,25 @@ typedef struct {
     unsigned bytesMode;
     unsigned iterableMode;
     unsigned mappingMode;
+    // Smoothed average of the size of the outputs, used to presize the next one
+    size_t sizeHint;
+    // Buffer kept between calls when the result is an UTF-8 str, NULL while in use
+    StringBuffer* buffer;
 } EncoderObject;
 
 
+// Upper limit to both the initial capacity of the output of an Encoder and the capacity
+// of the buffer it keeps between calls, so that a single huge document does not pin
+// memory forever
+static const size_t kEncoderMaxBufferSize = 16 * 1024 * 1024;
+
+
 PyDoc_STRVAR(dumps_docstring,
              "dumps(obj, *, skipkeys=False, ensure_ascii=True, write_mode=WM_COMPACT,"
              " indent=4, default=None, sort_keys=False, number_mode=None,"
              " datetime_mode=None, uuid_mode=None, bytes_mode=BM_UTF8,"
              " iterable_mode=IM_ANY_ITERABLE, mapping_mode=MM_ANY_MAPPING,"
-             " allow_nan=True)\n"
+             " allow_nan=True, return_bytes=False)\n"
              "\n"
              "Encode a Python object into a JSON string.");
 
@@ -3081,13 +8315,16 @@ dumps(PyObject* self, PyObject* args, PyObject* kwargs)
         /* compatibility with stdlib json */
         "allow_nan",
 
+        "return_bytes",
+
         NULL
     };
     int skipKeys = false;
     int sortKeys = false;
     int allowNan = -1;
+    int returnBytes = false;
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|$ppOOpOOOOOOOp:rapidjson.dumps",
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|$ppOOpOOOOOOOpp:rapidjson.dumps",
                                      (char**) kwlist,
                                      &value,
                                      &skipKeys,
@@ -3102,7 +8339,8 @@ dumps(PyObject* self, PyObject* args, PyObject* kwargs)
                                      &writeModeObj,
                                      &iterableModeObj,
                                      &mappingModeObj,
-                                     &allowNan))
+                                     &allowNan,
+                                     &returnBytes))
         return NULL;
 
     if (defaultFn && !PyCallable_Check(defaultFn)) {
@@ -3144,9 +8382,10 @@ dumps(PyObject* self, PyObject* args, PyObject* kwargs)
     if (sortKeys)
         mappingMode |= MM_SORT_KEYS;
 
-    return do_encode(value, defaultFn, ensureAscii ? true : false, writeMode, indentChar,
-                     indentCount, numberMode, datetimeMode, uuidMode, bytesMode,
-                     iterableMode, mappingMode);
+    return do_encode(value, defaultFn, ensureAscii ? true : false,
+                     returnBytes ? true : false, writeMode, indentChar, indentCount,
+                     numberMode, datetimeMode, uuidMode, bytesMode, iterableMode,
+                     mappingMode, NULL, StringBuffer::kDefaultCapacity);
 }
 
 
@@ -3348,12 +8587,43 @@ static PyGetSetDef encoder_props[] = {
     {NULL}
 };
 
+PyDoc_STRVAR(encoder_encode_bytes_docstring,
+             "encode_bytes(obj)\n"
+             "\n"
+             "Encode a Python object into a JSON UTF-8 bytes instance.");
+
+
+PyDoc_STRVAR(encoder_sizeof_docstring,
+             "__sizeof__()\n"
+             "\n"
+             "Return the size of the encoder in memory, in bytes, including the output"
+             " buffer it keeps between calls.");
+
+
+PyDoc_STRVAR(encoder_dump_into_docstring,
+             "dump_into(obj, buffer, offset=0)\n"
+             "\n"
+             "Encode a Python object into the given bytearray or writable memoryview,"
+             " starting at offset, and return the number of bytes written.");
+
+
+static PyMethodDef encoder_methods[] = {
+    {"dump_into", (PyCFunction) encoder_dump_into, METH_VARARGS | METH_KEYWORDS,
+     encoder_dump_into_docstring},
+    {"encode_bytes", (PyCFunction) encoder_encode_bytes, METH_O,
+     encoder_encode_bytes_docstring},
+    {"__sizeof__", (PyCFunction) encoder_sizeof, METH_NOARGS,
+     encoder_sizeof_docstring},
+    {NULL, NULL, 0, NULL}                     /* sentinel */
+};
+
+
 static PyTypeObject Encoder_Type = {
     PyVarObject_HEAD_INIT(NULL, 0)
     "rapidjson.Encoder",                      /* tp_name */
     sizeof(EncoderObject),                    /* tp_basicsize */
     0,                                        /* tp_itemsize */
-    0,                                        /* tp_dealloc */
+    (destructor) encoder_dealloc,             /* tp_dealloc */
     0,                                        /* tp_print */
     0,                                        /* tp_getattr */
     0,                                        /* tp_setattr */
@@ -3376,7 +8646,7 @@ static PyTypeObject Encoder_Type = {
     0,                                        /* tp_weaklistoffset */
     0,                                        /* tp_iter */
     0,                                        /* tp_iternext */
-    0,                                        /* tp_methods */
+    encoder_methods,                          /* tp_methods */
     encoder_members,                          /* tp_members */
     encoder_props,                            /* tp_getset */
     0,                                        /* tp_base */
@@ -3405,35 +8675,66 @@ static PyTypeObject Encoder_Type = {
                     bytesMode,                          \
                     iterableMode,                       \
                     mappingMode)                        \
-     ? PyUnicode_FromString(buf.GetString()) : NULL)
+     ? result_from_buffer(buf) : NULL)
+
+
+static inline PyObject*
+result_from_buffer(StringBuffer& buf)
+{
+    return unicode_from_utf8(buf.GetString(), buf.GetSize());
+}
+
+
+static inline PyObject*
+result_from_buffer(DirectOutputBuffer& buf)
+{
+    return buf.Finish();
+}
 
 
 static PyObject*
-do_encode(PyObject* value, PyObject* defaultFn, bool ensureAscii, unsigned writeMode,
-          char indentChar, unsigned indentCount, unsigned numberMode,
+do_encode(PyObject* value, PyObject* defaultFn, bool ensureAscii, bool returnBytes,
+          unsigned writeMode, char indentChar, unsigned indentCount, unsigned numberMode,
           unsigned datetimeMode, unsigned uuidMode, unsigned bytesMode,
-          unsigned iterableMode, unsigned mappingMode)
+          unsigned iterableMode, unsigned mappingMode, StringBuffer* buffer,
+          size_t capacity)
 {
+    // When given, the buffer is used instead of a local one for an UTF-8 str result
+
     if (writeMode == WM_COMPACT) {
         if (ensureAscii) {
-            GenericStringBuffer<ASCII<> > buf;
-            Writer<GenericStringBuffer<ASCII<> >, UTF8<>, ASCII<> > writer(buf);
+            DirectOutputBuffer buf(returnBytes, capacity);
+            Writer<DirectOutputBuffer, UTF8<>, ASCII<> > writer(buf);
+            return DUMPS_INTERNAL_CALL;
+        } else if (returnBytes) {
+            DirectOutputBuffer buf(true, capacity);
+            Writer<DirectOutputBuffer> writer(buf);
             return DUMPS_INTERNAL_CALL;
         } else {
-            StringBuffer buf;
+            StringBuffer local(NULL, capacity);
+            StringBuffer& buf = buffer != NULL ? *buffer : local;
             Writer<StringBuffer> writer(buf);
             return DUMPS_INTERNAL_CALL;
         }
     } else if (ensureAscii) {
-        GenericStringBuffer<ASCII<> > buf;
-        PrettyWriter<GenericStringBuffer<ASCII<> >, UTF8<>, ASCII<> > writer(buf);
+        DirectOutputBuffer buf(returnBytes, capacity);
+        PrettyWriter<DirectOutputBuffer, UTF8<>, ASCII<> > writer(buf);
+        writer.SetIndent(indentChar, indentCount);
+        if (writeMode & WM_SINGLE_LINE_ARRAY) {
+            writer.SetFormatOptions(kFormatSingleLineArray);
+        }
+        return DUMPS_INTERNAL_CALL;
+    } else if (returnBytes) {
+        DirectOutputBuffer buf(true, capacity);
+        PrettyWriter<DirectOutputBuffer> writer(buf);
         writer.SetIndent(indentChar, indentCount);
         if (writeMode & WM_SINGLE_LINE_ARRAY) {
             writer.SetFormatOptions(kFormatSingleLineArray);
         }
         return DUMPS_INTERNAL_CALL;
     } else {
-        StringBuffer buf;
+        StringBuffer local(NULL, capacity);
+        StringBuffer& buf = buffer != NULL ? *buffer : local;
         PrettyWriter<StringBuffer> writer(buf);
         writer.SetIndent(indentChar, indentCount);
         if (writeMode & WM_SINGLE_LINE_ARRAY) {
@@ -3492,6 +8793,81 @@ do_stream_encode(PyObject* value, PyObject* stream, size_t chunkSize, PyObject*
 }
 
 
+#define DUMP_INTO_INTERNAL_CALL                 \
+    os.Finish(dumps_internal(&writer,           \
+                             value,             \
+                             defaultFn,         \
+                             numberMode,        \
+                             datetimeMode,      \
+                             uuidMode,          \
+                             bytesMode,         \
+                             iterableMode,      \
+                             mappingMode))
+
+
+static PyObject*
+do_encode_into(PyObject* value, PyObject* buffer, Py_buffer* view, size_t offset,
+               PyObject* defaultFn, bool ensureAscii, unsigned writeMode,
+               char indentChar, unsigned indentCount, unsigned numberMode,
+               unsigned datetimeMode, unsigned uuidMode, unsigned bytesMode,
+               unsigned iterableMode, unsigned mappingMode)
+{
+    BufferOutputStream os(buffer, view, offset);
+
+    if (writeMode == WM_COMPACT) {
+        if (ensureAscii) {
+            Writer<BufferOutputStream, UTF8<>, ASCII<> > writer(os);
+            return DUMP_INTO_INTERNAL_CALL;
+        } else {
+            Writer<BufferOutputStream> writer(os);
+            return DUMP_INTO_INTERNAL_CALL;
+        }
+    } else if (ensureAscii) {
+        PrettyWriter<BufferOutputStream, UTF8<>, ASCII<> > writer(os);
+        writer.SetIndent(indentChar, indentCount);
+        if (writeMode & WM_SINGLE_LINE_ARRAY) {
+            writer.SetFormatOptions(kFormatSingleLineArray);
+        }
+        return DUMP_INTO_INTERNAL_CALL;
+    } else {
+        PrettyWriter<BufferOutputStream> writer(os);
+        writer.SetIndent(indentChar, indentCount);
+        if (writeMode & WM_SINGLE_LINE_ARRAY) {
+            writer.SetFormatOptions(kFormatSingleLineArray);
+        }
+        return DUMP_INTO_INTERNAL_CALL;
+    }
+}
+
+
+// Return the initial capacity of the output of the next call, a bit more than the size
+// learned from the previous ones
+
+static size_t
+encoder_capacity(EncoderObject* e)
+{
+    size_t capacity = e->sizeHint + e->sizeHint / 4;
+
+    if (capacity < StringBuffer::kDefaultCapacity)
+        return StringBuffer::kDefaultCapacity;
+    if (capacity > kEncoderMaxBufferSize)
+        return kEncoderMaxBufferSize;
+    return capacity;
+}
+
+
+// Update the exponentially smoothed size of the outputs, weighting the last one by 1/4
+
+static void
+encoder_learn_size(EncoderObject* e, size_t size)
+{
+    if (e->sizeHint == 0)
+        e->sizeHint = size;
+    else
+        e->sizeHint = e->sizeHint - e->sizeHint / 4 + size / 4;
+}
+
+
 static PyObject*
 encoder_call(PyObject* self, PyObject* args, PyObject* kwargs)
 {
@@ -3539,11 +8915,137 @@ encoder_call(PyObject* self, PyObject* args, PyObject* kwargs)
             defaultFn = PyObject_GetAttr(self, default_name);
         }
 
-        result = do_encode(value, defaultFn, e->ensureAscii, e->writeMode, e->indentChar,
-                           e->indentCount, e->numberMode, e->datetimeMode, e->uuidMode,
-                           e->bytesMode, e->iterableMode, e->mappingMode);
+        size_t capacity = encoder_capacity(e);
+        StringBuffer* buffer = NULL;
+
+        if (!e->ensureAscii) {
+            // Take the kept buffer, unless it is already in use by an outer call, for
+            // example from the default() method: when a new one cannot be allocated,
+            // do_encode() falls back to a local one, not kept afterwards
+            buffer = e->buffer;
+            e->buffer = NULL;
+            if (buffer == NULL)
+                buffer = new (std::nothrow) StringBuffer(NULL, capacity);
+        }
+
+        result = do_encode(value, defaultFn, e->ensureAscii, false, e->writeMode,
+                           e->indentChar, e->indentCount, e->numberMode, e->datetimeMode,
+                           e->uuidMode, e->bytesMode, e->iterableMode, e->mappingMode,
+                           buffer, capacity);
+
+        if (buffer != NULL) {
+            if (result != NULL)
+                encoder_learn_size(e, buffer->GetSize());
+
+            if (buffer->stack_.GetCapacity() > kEncoderMaxBufferSize
+                || e->buffer != NULL) {
+                delete buffer;
+            } else {
+                buffer->Clear();
+                e->buffer = buffer;
+            }
+        } else if (result != NULL) {
+            encoder_learn_size(e, (size_t) PyUnicode_GET_LENGTH(result));
+        }
+    }
+
+    if (defaultFn != NULL)
+        Py_DECREF(defaultFn);
+
+    return result;
+}
+
+
+static PyObject*
+encoder_encode_bytes(PyObject* self, PyObject* value)
+{
+    PyObject* defaultFn = NULL;
+    PyObject* result;
+
+    EncoderObject* e = (EncoderObject*) self;
+
+    if (PyObject_HasAttr(self, default_name)) {
+        defaultFn = PyObject_GetAttr(self, default_name);
+    }
+
+    result = do_encode(value, defaultFn, e->ensureAscii, true, e->writeMode,
+                       e->indentChar, e->indentCount, e->numberMode, e->datetimeMode,
+                       e->uuidMode, e->bytesMode, e->iterableMode, e->mappingMode,
+                       NULL, encoder_capacity(e));
+
+    if (result != NULL)
+        encoder_learn_size(e, (size_t) PyBytes_GET_SIZE(result));
+
+    if (defaultFn != NULL)
+        Py_DECREF(defaultFn);
+
+    return result;
+}
+
+
+static PyObject*
+encoder_sizeof(PyObject* self, PyObject* Py_UNUSED(ignored))
+{
+    EncoderObject* e = (EncoderObject*) self;
+    size_t size = (size_t) Py_TYPE(self)->tp_basicsize;
+
+    if (e->buffer != NULL)
+        size += e->buffer->stack_.GetCapacity();
+
+    return PyLong_FromSize_t(size);
+}
+
+
+static PyObject*
+encoder_dump_into(PyObject* self, PyObject* args, PyObject* kwargs)
+{
+    static char const* kwlist[] = {
+        "obj",
+        "buffer",
+        "offset",
+        NULL
+    };
+    PyObject* value;
+    PyObject* buffer;
+    Py_ssize_t offset = 0;
+    PyObject* defaultFn = NULL;
+    PyObject* result;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|n",
+                                     (char**) kwlist,
+                                     &value,
+                                     &buffer,
+                                     &offset))
+        return NULL;
+
+    if (!PyByteArray_Check(buffer) && !PyMemoryView_Check(buffer)) {
+        PyErr_SetString(PyExc_TypeError,
+                        "Expected a bytearray or a writable memoryview");
+        return NULL;
+    }
+
+    Py_buffer view;
+
+    if (PyObject_GetBuffer(buffer, &view, PyBUF_WRITABLE) == -1)
+        return NULL;
+
+    if (offset < 0 || offset > view.len) {
+        PyBuffer_Release(&view);
+        PyErr_SetString(PyExc_ValueError, "Invalid offset, outside of the buffer");
+        return NULL;
+    }
+
+    EncoderObject* e = (EncoderObject*) self;
+
+    if (PyObject_HasAttr(self, default_name)) {
+        defaultFn = PyObject_GetAttr(self, default_name);
     }
 
+    result = do_encode_into(value, buffer, &view, (size_t) offset, defaultFn,
+                            e->ensureAscii, e->writeMode, e->indentChar, e->indentCount,
+                            e->numberMode, e->datetimeMode, e->uuidMode, e->bytesMode,
+                            e->iterableMode, e->mappingMode);
+
     if (defaultFn != NULL)
         Py_DECREF(defaultFn);
 
@@ -3649,11 +9151,23 @@ encoder_new(PyTypeObject* type, PyObject* args, PyObject* kwargs)
     e->bytesMode = bytesMode;
     e->iterableMode = iterableMode;
     e->mappingMode = mappingMode;
+    e->sizeHint = 0;
+    e->buffer = NULL;
 
     return (PyObject*) e;
 }
 
 
+static void
+encoder_dealloc(PyObject* self)
+{
+    EncoderObject* e = (EncoderObject*) self;
+
+    delete e->buffer;
+    Py_TYPE(self)->tp_free(self);
+}
+
+
 ///////////////
 // Validator //
 ///////////////
@@ -3866,6 +9380,14 @@ static PyMethodDef functions[] = {
      loads_docstring},
     {"load", (PyCFunction) load, METH_VARARGS | METH_KEYWORDS,
      load_docstring},
+    {"load_file", (PyCFunction) load_file, METH_VARARGS | METH_KEYWORDS,
+     load_file_docstring},
+    {"iterload", (PyCFunction) iterload, METH_VARARGS | METH_KEYWORDS,
+     iterload_docstring},
+    {"iterparse", (PyCFunction) iterparse, METH_VARARGS | METH_KEYWORDS,
+     iterparse_docstring},
+    {"loads_lines", (PyCFunction) loads_lines, METH_VARARGS | METH_KEYWORDS,
+     loads_lines_docstring},
     {"dumps", (PyCFunction) dumps, METH_VARARGS | METH_KEYWORDS,
      dumps_docstring},
     {"dump", (PyCFunction) dump, METH_VARARGS | METH_KEYWORDS,
@@ -3880,6 +9402,10 @@ module_exec(PyObject* m)
     PyObject* datetimeModule;
     PyObject* decimalModule;
     PyObject* uuidModule;
+    PyObject* ioModule;
+
+    init_powers_of_five();
+    init_ryu_tables();
 
     if (PyType_Ready(&Decoder_Type) < 0)
         return -1;
@@ -3893,10 +9419,25 @@ module_exec(PyObject* m)
     if (PyType_Ready(&RawJSON_Type) < 0)
         return -1;
 
+    if (PyType_Ready(&LazyDocument_Type) < 0)
+        return -1;
+
+    if (PyType_Ready(&DecoderIterator_Type) < 0)
+        return -1;
+
+    if (PyType_Ready(&LazyDocumentIterator_Type) < 0)
+        return -1;
+
+    if (PyType_Ready(&EventIterator_Type) < 0)
+        return -1;
+
     PyDateTime_IMPORT;
     if(!PyDateTimeAPI)
         return -1;
 
+    // Derived from the randomized hash of Python, so that PYTHONHASHSEED fixes it too
+    key_hash_seed = (uint64_t) hash_buffer("rapidjson", 9);
+
     datetimeModule = PyImport_ImportModule("datetime");
     if (datetimeModule == NULL)
         return -1;
@@ -3926,9 +9467,37 @@ module_exec(PyObject* m)
         return -1;
 
     uuid_type = PyObject_GetAttrString(uuidModule, "UUID");
+    if (uuid_type == NULL) {
+        Py_DECREF(uuidModule);
+        return -1;
+    }
+
+    // SafeUUID is new in Python 3.7
+
+    if (PyObject_HasAttrString(uuidModule, "SafeUUID")) {
+        PyObject* safeUuid = PyObject_GetAttrString(uuidModule, "SafeUUID");
+        if (safeUuid != NULL) {
+            safe_uuid_unknown = PyObject_GetAttrString(safeUuid, "unknown");
+            Py_DECREF(safeUuid);
+        }
+        if (safe_uuid_unknown == NULL) {
+            Py_DECREF(uuidModule);
+            return -1;
+        }
+    }
+
     Py_DECREF(uuidModule);
 
-    if (uuid_type == NULL)
+    ioModule = PyImport_ImportModule("io");
+    if (ioModule == NULL)
+        return -1;
+
+    fileio_type = PyObject_GetAttrString(ioModule, "FileIO");
+    buffered_io_base_type = PyObject_GetAttrString(ioModule, "BufferedIOBase");
+    raw_io_base_type = PyObject_GetAttrString(ioModule, "RawIOBase");
+    Py_DECREF(ioModule);
+
+    if (fileio_type == NULL || buffered_io_base_type == NULL || raw_io_base_type == NULL)
         return -1;
 
     astimezone_name = PyUnicode_InternFromString("astimezone");
@@ -3939,6 +9508,14 @@ module_exec(PyObject* m)
     if (hex_name == NULL)
         return -1;
 
+    int_name = PyUnicode_InternFromString("int");
+    if (int_name == NULL)
+        return -1;
+
+    is_safe_name = PyUnicode_InternFromString("is_safe");
+    if (is_safe_name == NULL)
+        return -1;
+
     timestamp_name = PyUnicode_InternFromString("timestamp");
     if (timestamp_name == NULL)
         return -1;
@@ -3995,6 +9572,10 @@ module_exec(PyObject* m)
     if (read_name == NULL)
         return -1;
 
+    readinto_name = PyUnicode_InternFromString("readinto");
+    if (readinto_name == NULL)
+        return -1;
+
     write_name = PyUnicode_InternFromString("write");
     if (write_name == NULL)
         return -1;
@@ -4003,6 +9584,42 @@ module_exec(PyObject* m)
     if (encoding_name == NULL)
         return -1;
 
+    null_event_name = PyUnicode_InternFromString("null");
+    if (null_event_name == NULL)
+        return -1;
+
+    boolean_event_name = PyUnicode_InternFromString("boolean");
+    if (boolean_event_name == NULL)
+        return -1;
+
+    number_event_name = PyUnicode_InternFromString("number");
+    if (number_event_name == NULL)
+        return -1;
+
+    string_event_name = PyUnicode_InternFromString("string");
+    if (string_event_name == NULL)
+        return -1;
+
+    map_key_event_name = PyUnicode_InternFromString("map_key");
+    if (map_key_event_name == NULL)
+        return -1;
+
+    start_map_event_name = PyUnicode_InternFromString("start_map");
+    if (start_map_event_name == NULL)
+        return -1;
+
+    end_map_event_name = PyUnicode_InternFromString("end_map");
+    if (end_map_event_name == NULL)
+        return -1;
+
+    start_array_event_name = PyUnicode_InternFromString("start_array");
+    if (start_array_event_name == NULL)
+        return -1;
+
+    end_array_event_name = PyUnicode_InternFromString("end_array");
+    if (end_array_event_name == NULL)
+        return -1;
+
 #define STRINGIFY(x) XSTRINGIFY(x)
 #define XSTRINGIFY(x) #x
 
@@ -4026,6 +9643,9 @@ module_exec(PyObject* m)
         || PyModule_AddIntConstant(m, "PM_NONE", PM_NONE)
         || PyModule_AddIntConstant(m, "PM_COMMENTS", PM_COMMENTS)
         || PyModule_AddIntConstant(m, "PM_TRAILING_COMMAS", PM_TRAILING_COMMAS)
+        || PyModule_AddIntConstant(m, "PM_FULL_PRECISION", PM_FULL_PRECISION)
+        || PyModule_AddIntConstant(m, "PM_VALIDATE_ENCODING", PM_VALIDATE_ENCODING)
+        || PyModule_AddIntConstant(m, "PM_STOP_WHEN_DONE", PM_STOP_WHEN_DONE)
 
         || PyModule_AddIntConstant(m, "BM_NONE", BM_NONE)
         || PyModule_AddIntConstant(m, "BM_UTF8", BM_UTF8)
@@ -4088,6 +9708,12 @@ module_exec(PyObject* m)
         return -1;
     }
 
+    Py_INCREF(&LazyDocument_Type);
+    if (PyModule_AddObject(m, "LazyDocument", (PyObject*) &LazyDocument_Type) < 0) {
+        Py_DECREF(&LazyDocument_Type);
+        return -1;
+    }
+
     validation_error = PyErr_NewException("rapidjson.ValidationError",
                                           PyExc_ValueError, NULL);
     if (validation_error == NULL)
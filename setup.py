@@ -79,7 +79,11 @@ if cxx and 'g++' in cxx:
     # error under C++ (see issue #69). C++11 is required since commit
     # https://github.com/Tencent/rapidjson/commit/9965ab37f6cfae3d58a0a6e34c76112866ace0b1
     extension_options['extra_compile_args'] = [
-        '-pedantic', '-Wno-long-long', '-std=c++11']
+        '-pedantic', '-Wno-long-long', '-std=c++11', '-pthread']
+
+    # loads_lines() uses std::thread, that requires the POSIX threads library on older
+    # systems
+    extension_options['extra_link_args'] = ['-pthread']
 
     # Up to Python 3.7, some structures use "char*" instead of "const char*",
     # and ISO C++ forbids assigning string literal constants
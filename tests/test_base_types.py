@@ -6,6 +6,8 @@
 # :Copyright: © 2016, 2017, 2018, 2019, 2020, 2021, 2024 Lele Gaifax
 #
 
+import array
+import mmap
 import random
 import sys
 
@@ -29,6 +31,22 @@ def test_base_values(value, dumps, loads):
     assert loaded == value and type(loaded) is type(value)
 
 
+@pytest.mark.parametrize(
+    'value', (
+        0, 7, -7, 10**18, 2**63 - 1, -2**63, 2**63, 2**64 - 1, 2**64, -2**63 - 1,
+        -2**64, 10**30,
+))
+def test_integer_values(value, dumps):
+    class MyInt(int):
+        def __repr__(self):
+            return 'MyInt(%s)' % int.__repr__(self)
+
+    assert dumps(value) == repr(value)
+    assert dumps([MyInt(value)]) == '[%s]' % int.__repr__(value)
+    assert dumps({'k': True, 'v': value}, sort_keys=True) == \
+        '{"k":true,"v":%s}' % repr(value)
+
+
 def test_float(dumps):
     value = 0.1 + 0.2
     dumped = dumps(value)
@@ -187,7 +205,7 @@ def test_decode_bytes_and_bytearray():
     j = f'"{s}"'
     utf32 = j.encode('utf-32')
     for loader in (rj.loads, rj.Decoder()):
-        pytest.raises(UnicodeDecodeError, loader, utf32)
+        pytest.raises(rj.JSONDecodeError, loader, utf32)
 
     utf8 = j.encode('utf-8')
     for loader in (rj.loads, rj.Decoder()):
@@ -195,6 +213,55 @@ def test_decode_bytes_and_bytearray():
             assert loader(data) == s
 
 
+def test_decode_buffer_protocol(tmp_path):
+    doc = {'FòBàr': ['€', 1, 2.5, None]}
+    utf8 = rj.dumps(doc, ensure_ascii=False).encode('utf-8')
+    path = tmp_path / 'doc.json'
+    path.write_bytes(utf8)
+    with open(path, 'rb') as f, mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ) as mm:
+        for loader in (rj.loads, rj.Decoder()):
+            assert loader(memoryview(utf8)) == doc
+            assert loader(memoryview(b'[' + utf8 + b']')[1:-1]) == doc
+            assert loader(array.array('B', utf8)) == doc
+            assert loader(mm) == doc
+
+    for loader in (rj.loads, rj.Decoder()):
+        with pytest.raises(rj.JSONDecodeError, match='Invalid encoding in string'):
+            loader(b'["foo", "\xff"]')
+        with pytest.raises(rj.JSONDecodeError, match='Invalid encoding in string'):
+            loader(bytearray(b'{"\xed\xa0\x80": 1}'))
+
+
+@pytest.mark.parametrize('release_gil', (False, True))
+def test_decode_destructive(release_gil):
+    doc = {'FòBàr': ['€\n"', 1, 2.5, None, {'nested': 'a\\b'}], 'empty': ''}
+    utf8 = rj.dumps(doc, ensure_ascii=False).encode('utf-8')
+    assert rj.loads(bytearray(utf8), destructive=True, release_gil=release_gil) == doc
+    # A view of a larger buffer is not NUL-terminated
+    buffer = bytearray(b'[' + utf8 + b']')
+    assert rj.loads(memoryview(buffer)[1:-1], destructive=True,
+                    release_gil=release_gil) == doc
+    assert rj.loads(memoryview(bytearray(b'123456'))[:3], destructive=True,
+                    release_gil=release_gil) == 123
+    assert rj.loads(bytearray(b'"abc"'), destructive=True,
+                    number_mode=rj.NM_DECIMAL, release_gil=release_gil) == 'abc'
+    assert rj.loads(bytearray(b'[1.5, 2]'), destructive=True,
+                    number_mode=rj.NM_DECIMAL, release_gil=release_gil) == [1.5, 2]
+
+    with pytest.raises(rj.JSONDecodeError, match='Invalid encoding in string'):
+        rj.loads(bytearray(b'["foo", "\xff"]'), destructive=True, release_gil=release_gil)
+    with pytest.raises(rj.JSONDecodeError, match='Missing a closing quotation mark'):
+        rj.loads(memoryview(bytearray(b'"abc"'))[:4], destructive=True,
+                 release_gil=release_gil)
+
+    for data in ('[]', b'[]', array.array('B', b'[]')):
+        with pytest.raises(TypeError):
+            rj.loads(data, destructive=True)
+    for data in (memoryview(b'[]'), memoryview(bytearray(b'[]')).toreadonly()):
+        with pytest.raises(BufferError):
+            rj.loads(data, destructive=True)
+
+
 def test_shared_keys(loads):
     res = loads('[{"key": "value1"}, {"key": "value2"}]')
     key1, = res[0].keys()
@@ -202,6 +269,23 @@ def test_shared_keys(loads):
     assert key1 is key2
 
 
+def test_shared_keys_nested_and_non_ascii(loads):
+    keys = [f'k{i}' for i in range(200)] + ['càfé', '€uro', '\U0001f600', '']
+    doc = [{k: {k: [k]} for k in keys}, {k: [] for k in keys}, {k: {} for k in keys}]
+    res = loads(rj.dumps(doc, ensure_ascii=False))
+    assert res == doc
+    for key1, key2, key3 in zip(res[0], res[1], res[2]):
+        assert key1 is key2 is key3
+        assert next(iter(res[0][key1])) is key1
+
+
+def test_large_containers(loads):
+    doc = {f'k{i}': [[j, {'v': j}] for j in range(i % 7)] for i in range(5000)}
+    doc['array'] = list(range(100000))
+    assert loads(rj.dumps(doc)) == doc
+    assert loads('{"a": 1, "b": [2], "a": 3}') == {'a': 3, 'b': [2]}
+
+
 # TODO: Figure out what we want to do here
 bad_tests = """
 def test_true_false():
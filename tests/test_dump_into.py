@@ -0,0 +1,117 @@
+# -*- coding: utf-8 -*-
+# :Project:   python-rapidjson -- Tests on Encoder.dump_into()
+# :Author:    Lele Gaifax <lele@metapensiero.it>
+# :License:   MIT License
+# :Copyright: © 2026 Lele Gaifax
+#
+
+import pytest
+
+import rapidjson as rj
+
+
+VALUES = [
+    {'id': 1, 'tags': ['a', 'b'], 'price': 1.5},
+    [1, 2, 3],
+    'çàfé' * 100,
+    {'nested': {'deep': [{'id': 4}] * 50}},
+]
+
+
+@pytest.mark.parametrize('ensure_ascii', (True, False))
+@pytest.mark.parametrize('indent', (None, 2))
+@pytest.mark.parametrize('value', VALUES)
+def test_dump_into_bytearray(value, ensure_ascii, indent):
+    encoder = rj.Encoder(ensure_ascii=ensure_ascii, indent=indent)
+    expected = encoder.encode_bytes(value)
+
+    buffer = bytearray()
+    assert encoder.dump_into(value, buffer) == len(expected)
+    assert buffer == expected
+
+    buffer = bytearray(b'#' * 10000)
+    assert encoder.dump_into(value, buffer, 3) == len(expected)
+    assert len(buffer) == 10000
+    assert buffer[:3] == b'###'
+    assert buffer[3:3 + len(expected)] == expected
+    assert buffer[3 + len(expected):] == b'#' * (10000 - 3 - len(expected))
+
+    buffer = bytearray(b'#' * 10)
+    assert encoder.dump_into(value, buffer, offset=5) == len(expected)
+    assert buffer == b'#####' + expected
+
+
+def test_dump_into_reuse():
+    encoder = rj.Encoder()
+    buffer = bytearray()
+    for value in VALUES * 3:
+        size = encoder.dump_into(value, buffer)
+        assert rj.loads(buffer[:size]) == value
+
+
+def test_dump_into_memoryview():
+    encoder = rj.Encoder()
+    buffer = bytearray(b'#' * 20)
+    view = memoryview(buffer)
+
+    assert encoder.dump_into([1, 2], view, 2) == 5
+    assert buffer == b'##[1,2]' + b'#' * 13
+
+    with pytest.raises(ValueError):
+        encoder.dump_into('x' * 20, view)
+    assert len(buffer) == 20
+
+    with pytest.raises(BufferError):
+        encoder.dump_into('x' * 20, buffer)
+    assert len(buffer) == 20
+
+    with pytest.raises(BufferError):
+        encoder.dump_into(1, memoryview(b'abc'))
+
+
+def test_dump_into_errors():
+    encoder = rj.Encoder()
+
+    with pytest.raises(TypeError):
+        encoder.dump_into(1, b'abc')
+
+    with pytest.raises(ValueError):
+        encoder.dump_into(1, bytearray(3), 4)
+
+    with pytest.raises(ValueError):
+        encoder.dump_into(1, bytearray(3), -1)
+
+    buffer = bytearray(b'abc')
+    with pytest.raises(TypeError):
+        encoder.dump_into(['x' * 1000, object()], buffer)
+    assert len(buffer) == 3
+
+
+def test_dump_into_failure_contents():
+    encoder = rj.Encoder()
+
+    # Only what precedes the offset is preserved, the rest is undefined
+
+    buffer = bytearray(b'xyz')
+    with pytest.raises(TypeError):
+        encoder.dump_into([1, object()], buffer, 1)
+    assert len(buffer) == 3
+    assert buffer[:1] == b'x'
+
+    buffer = bytearray(b'#' * 8)
+    with pytest.raises(ValueError):
+        encoder.dump_into(['x' * 20], memoryview(buffer), 2)
+    assert len(buffer) == 8
+    assert buffer[:2] == b'##'
+
+
+def test_dump_into_default():
+    class ClearingEncoder(rj.Encoder):
+        def default(self, obj):
+            buffer.clear()
+            return None
+
+    buffer = bytearray(100)
+    with pytest.raises(BufferError):
+        ClearingEncoder().dump_into([object()], buffer)
+    assert len(buffer) == 100
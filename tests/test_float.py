@@ -8,6 +8,8 @@
 
 from decimal import Decimal
 import math
+import random
+import struct
 
 import pytest
 
@@ -171,3 +173,59 @@ def test_issue_213():
     dumped = rj.dumps(f)
     loaded = rj.loads(dumped)
     assert loaded == 123.45
+
+
+@pytest.mark.parametrize('value', [
+    '0.0', '-0.0', '1e0', '1E+2', '0.1', '0.3', '-1.5e-7', '2.2250738585072014e-308',
+    '2.2250738585072011e-308', '4.9e-324', '5e-324', '1.7976931348623157e308',
+    '1.7976931348623159e308', '9007199254740993.0', '9007199254740992.0000000001',
+    '9007199254740993.0000000001', '123456789012345678901234567890.5',
+    '-65.613616999999977', '0.000000000000000000000000000000000001', '1e-400', '1e400',
+    '2.4703282292062327e-324', '2.4703282292062328e-324', '7.2057594037927933e16',
+])
+def test_loads_exact(value):
+    assert str(rj.loads(value)) == str(float(value))
+    assert str(rj.loads(f'[{value}]')[0]) == str(float(value))
+
+
+def test_loads_random_floats():
+    rnd = random.Random(42)
+    for _ in range(20000):
+        value = struct.unpack('d', struct.pack('Q', rnd.getrandbits(63)))[0]
+        if math.isfinite(value):
+            for text in (repr(value), f'{value:.19e}', f'{value:.25g}'):
+                assert rj.loads(text) == float(text)
+
+
+@pytest.mark.parametrize('value', [
+    '0', '-0', '7', '-123456789012345678', '999999999999999999', '1000000000000000000',
+    '-9223372036854775808', '18446744073709551616', '123456789012345678901234567890',
+])
+def test_loads_integers(value):
+    loaded = rj.loads(value)
+    assert type(loaded) is int
+    assert loaded == int(value)
+
+
+@pytest.mark.parametrize('value', [
+    0.0, -0.0, 1.0, -1.5, 0.1, 0.3, 1/3, 100.0, 1e15, 1e16, 9999999999999998.0,
+    123456789012345680.0, 1e22, 1e23, 0.0001, 0.00001, 1.5e-5, 5e-324, -5e-324,
+    2.2250738585072014e-308, 2.225073858507201e-308, 1.7976931348623157e308,
+    9007199254740993.0, 2.0**-1074 * 3, 2.0**63, 2.0**-20, 4.35, 5e-310, 1e-7,
+    -65.61361699999998,
+])
+def test_dumps_repr(value):
+    assert rj.dumps(value) == repr(value)
+    assert rj.dumps([value]) == f'[{value!r}]'
+    assert rj.Encoder()(value) == repr(value)
+
+
+def test_dumps_random_floats():
+    rnd = random.Random(42)
+    values = []
+    for _ in range(20000):
+        value = struct.unpack('d', struct.pack('Q', rnd.getrandbits(64)))[0]
+        if math.isfinite(value):
+            values.append(value)
+        values.append(float(f'{rnd.randrange(10**rnd.randint(1, 17))}e{rnd.randint(-30, 30)}'))
+    assert rj.dumps(values) == '[' + ','.join(map(repr, values)) + ']'
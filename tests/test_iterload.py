@@ -0,0 +1,169 @@
+# -*- coding: utf-8 -*-
+# :Project:   python-rapidjson -- Tests on iterload() and Decoder.iter()
+# :Author:    Lele Gaifax <lele@metapensiero.it>
+# :License:   MIT License
+# :Copyright: © 2026 Lele Gaifax
+#
+
+from decimal import Decimal
+import gc
+import io
+import tracemalloc
+import weakref
+
+import pytest
+
+import rapidjson as rj
+
+
+def iterload_str(json, **opts):
+    return rj.iterload(json, **opts)
+
+
+def iterload_bytes(json, **opts):
+    return rj.iterload(json.encode('utf-8'), **opts)
+
+
+def iterload_textstream(json, **opts):
+    return rj.iterload(io.StringIO(json), chunk_size=4, **opts)
+
+
+def iterload_binarystream(json, **opts):
+    return rj.iterload(io.BytesIO(json.encode('utf-8')), chunk_size=4, **opts)
+
+
+def decoder_iter_str(json, **opts):
+    return rj.Decoder(**opts).iter(json)
+
+
+def decoder_iter_binarystream(json, **opts):
+    return rj.Decoder(**opts).iter(io.BytesIO(json.encode('utf-8')), chunk_size=4)
+
+
+@pytest.fixture(params=(iterload_str, iterload_bytes, iterload_textstream,
+                        iterload_binarystream, decoder_iter_str,
+                        decoder_iter_binarystream))
+def iterload(request):
+    return request.param
+
+
+@pytest.mark.parametrize('json,expected', [
+    ('', []),
+    ('  \n\n', []),
+    ('1', [1]),
+    ('{"a": 1}\n{"b": [2]}\n', [{'a': 1}, {'b': [2]}]),
+    ('{"a": 1}{"a": 2}[3]"four" 5 null', [{'a': 1}, {'a': 2}, [3], 'four', 5, None]),
+    ('"çàfé"\r\n"€"', ['çàfé', '€']),
+])
+def test_values(iterload, json, expected):
+    assert list(iterload(json)) == expected
+
+
+def test_modes(iterload):
+    values = iterload('1.5 // first\n[2.5,]\n',
+                      number_mode=rj.NM_DECIMAL,
+                      parse_mode=rj.PM_COMMENTS | rj.PM_TRAILING_COMMAS)
+    assert list(values) == [Decimal('1.5'), [Decimal('2.5')]]
+
+
+def test_invalid(iterload):
+    values = iterload('[1]\n[2\n[3]')
+    assert next(values) == [1]
+    with pytest.raises(rj.JSONDecodeError, match='offset 7'):
+        next(values)
+    assert list(values) == []
+
+
+def test_shared_keys():
+    first, second = rj.iterload('{"key": 1}\n{"key": 2}')
+    assert next(iter(first)) is next(iter(second))
+
+
+def test_distinct_keys_memory():
+    json = '\n'.join('{"k%d": %d}' % (i, i) for i in range(200000))
+
+    tracemalloc.start()
+    try:
+        for value in rj.iterload(json):
+            pass
+        peak = tracemalloc.get_traced_memory()[1]
+    finally:
+        tracemalloc.stop()
+
+    # Only a bounded number of keys is kept interned across the values
+    assert peak < 5 * 1024 * 1024
+
+
+def test_object_hook():
+    values = rj.iterload('{"a": 1} {"b": 2}', object_hook=lambda d: sorted(d.items()))
+    assert list(values) == [[('a', 1)], [('b', 2)]]
+
+
+def test_decoder_hooks():
+    class PairsDecoder(rj.Decoder):
+        def start_object(self):
+            return []
+
+        def end_array(self, a):
+            return tuple(a)
+
+    values = PairsDecoder().iter('{"a": [1]}\n[{"b": 2}]')
+    assert list(values) == [[('a', (1,))], ([('b', 2)],)]
+
+
+def test_buffer_is_held():
+    data = bytearray(b'[1] [2]')
+    values = rj.iterload(data)
+    with pytest.raises(BufferError):
+        data.extend(b' [3]')
+    assert list(values) == [[1], [2]]
+    del values
+    data.extend(b' [3]')
+
+
+def test_reference_cycle():
+    class HoldingDecoder(rj.Decoder):
+        def start_object(self):
+            return {}
+
+    decoder = HoldingDecoder()
+    decoder.values = decoder.iter('{"a": 1} {"b": 2}')
+    assert next(decoder.values) == {'a': 1}
+    ref = weakref.ref(decoder)
+    del decoder
+    gc.collect()
+    assert ref() is None
+
+
+def test_reentrant_next():
+    class ReentrantDecoder(rj.Decoder):
+        def end_object(self, mapping):
+            next(self.values)
+            return mapping
+
+    decoder = ReentrantDecoder()
+    decoder.values = decoder.iter(io.StringIO('{"a": 1}\n{"b": 2}\n'), chunk_size=4)
+    with pytest.raises(ValueError, match='iterator already executing'):
+        next(decoder.values)
+    assert list(decoder.values) == []
+
+    class ReentrantStream(io.StringIO):
+        def read(self, size=-1):
+            next(self.values)
+            return super().read(size)
+
+    stream = ReentrantStream('[1] [2]')
+    stream.values = rj.iterload(stream)
+    with pytest.raises(ValueError, match='iterator already executing'):
+        next(stream.values)
+
+
+def test_invalid_args():
+    with pytest.raises(TypeError):
+        rj.iterload(1)
+    with pytest.raises(TypeError):
+        rj.Decoder().iter(None)
+    with pytest.raises(ValueError):
+        rj.iterload('1', chunk_size=0)
+    with pytest.raises(TypeError):
+        rj.iterload('1', object_hook=1)
@@ -0,0 +1,202 @@
+# -*- coding: utf-8 -*-
+# :Project:   python-rapidjson -- Tests on iterparse()
+# :Author:    Lele Gaifax <lele@metapensiero.it>
+# :License:   MIT License
+# :Copyright: © 2026 Lele Gaifax
+#
+
+from decimal import Decimal
+import gc
+import io
+import tracemalloc
+import weakref
+
+import pytest
+
+import rapidjson as rj
+
+
+@pytest.fixture(params=('text', 'binary'))
+def stream(request):
+    if request.param == 'text':
+        return lambda json: io.StringIO(json)
+    else:
+        return lambda json: io.BytesIO(json.encode('utf-8'))
+
+
+DOCUMENT = '{"a": [1, {"b": null}], "c": {"d": "e", "f": [true, 2.5]}}'
+
+
+def test_events(stream):
+    assert list(rj.iterparse(stream(DOCUMENT), chunk_size=4)) == [
+        ('', 'start_map', None),
+        ('', 'map_key', 'a'),
+        ('a', 'start_array', None),
+        ('a.item', 'number', 1),
+        ('a.item', 'start_map', None),
+        ('a.item', 'map_key', 'b'),
+        ('a.item.b', 'null', None),
+        ('a.item', 'end_map', None),
+        ('a', 'end_array', None),
+        ('', 'map_key', 'c'),
+        ('c', 'start_map', None),
+        ('c', 'map_key', 'd'),
+        ('c.d', 'string', 'e'),
+        ('c', 'map_key', 'f'),
+        ('c.f', 'start_array', None),
+        ('c.f.item', 'boolean', True),
+        ('c.f.item', 'number', 2.5),
+        ('c.f', 'end_array', None),
+        ('c', 'end_map', None),
+        ('', 'end_map', None),
+    ]
+
+
+@pytest.mark.parametrize('json,expected', [
+    ('1', [('', 'number', 1)]),
+    ('[]', [('', 'start_array', None), ('', 'end_array', None)]),
+    ('{}', [('', 'start_map', None), ('', 'end_map', None)]),
+    ('{"": [{"x.y": 0}]}', [
+        ('', 'start_map', None),
+        ('', 'map_key', ''),
+        ('', 'start_array', None),
+        ('.item', 'start_map', None),
+        ('.item', 'map_key', 'x.y'),
+        ('.item.x.y', 'number', 0),
+        ('.item', 'end_map', None),
+        ('', 'end_array', None),
+        ('', 'end_map', None),
+    ]),
+    ('{"": {"": [1]}}', [
+        ('', 'start_map', None),
+        ('', 'map_key', ''),
+        ('', 'start_map', None),
+        ('', 'map_key', ''),
+        ('.', 'start_array', None),
+        ('..item', 'number', 1),
+        ('.', 'end_array', None),
+        ('', 'end_map', None),
+        ('', 'end_map', None),
+    ]),
+    ('[[1]]', [
+        ('', 'start_array', None),
+        ('item', 'start_array', None),
+        ('item.item', 'number', 1),
+        ('item', 'end_array', None),
+        ('', 'end_array', None),
+    ]),
+])
+def test_simple_documents(stream, json, expected):
+    assert list(rj.iterparse(stream(json))) == expected
+
+
+@pytest.mark.parametrize('prefix,expected', [
+    ('', 20),
+    ('a', 7),
+    ('a.item', 5),
+    ('a.item.b', 1),
+    ('c.f.item', 2),
+    ('c.d', 1),
+    ('c.de', 0),
+    ('x', 0),
+])
+def test_prefix(stream, prefix, expected):
+    events = list(rj.iterparse(stream(DOCUMENT), prefix))
+    assert len(events) == expected
+    assert all(path == prefix or path.startswith(prefix + '.') or not prefix
+               for path, event, value in events)
+
+
+def test_modes(stream):
+    events = rj.iterparse(stream('[1.5, "2020-01-02", NaN] // comment'),
+                          number_mode=rj.NM_DECIMAL | rj.NM_NAN,
+                          datetime_mode=rj.DM_ISO8601,
+                          parse_mode=rj.PM_COMMENTS)
+    values = [value for path, event, value in events if event != 'start_array'
+              and event != 'end_array']
+    assert values[0] == Decimal('1.5')
+    assert values[1].year == 2020
+    assert values[2].is_nan()
+
+
+@pytest.mark.parametrize('json,offset', [
+    ('', 0),
+    ('[1, 2', 5),
+    ('{"a" 1}', 5),
+    ('[1] 2', 4),
+])
+def test_errors(stream, json, offset):
+    with pytest.raises(rj.JSONDecodeError) as exc:
+        list(rj.iterparse(stream(json)))
+    assert ('at offset %d' % offset) in str(exc.value)
+
+
+def test_error_after_events(stream):
+    events = rj.iterparse(stream('[1, 2 3]'))
+    assert next(events) == ('', 'start_array', None)
+    assert next(events) == ('item', 'number', 1)
+    assert next(events) == ('item', 'number', 2)
+    with pytest.raises(rj.JSONDecodeError):
+        next(events)
+    with pytest.raises(StopIteration):
+        next(events)
+
+
+def test_invalid_arguments():
+    with pytest.raises(TypeError):
+        rj.iterparse('[]')
+    with pytest.raises(TypeError):
+        rj.iterparse(io.StringIO('[]'), 1)
+    with pytest.raises(ValueError):
+        rj.iterparse(io.StringIO('[]'), number_mode=rj.NM_NATIVE | rj.NM_DECIMAL)
+    with pytest.raises(ValueError):
+        rj.iterparse(io.StringIO('[] []'), parse_mode=rj.PM_STOP_WHEN_DONE)
+
+
+def test_recursion_limit(stream):
+    with pytest.raises(RecursionError):
+        list(rj.iterparse(stream('[' * 100000)))
+
+
+def test_reentrant_next():
+    class ReentrantStream(io.StringIO):
+        def read(self, size=-1):
+            if self.tell():
+                next(self.events)
+            return super().read(size)
+
+    stream = ReentrantStream('{"a": [1, "two"], "b": null}')
+    stream.events = rj.iterparse(stream, chunk_size=4)
+    assert next(stream.events) == ('', 'start_map', None)
+    with pytest.raises(ValueError, match='iterator already executing'):
+        list(stream.events)
+
+
+def test_reference_cycle():
+    class Stream(io.StringIO):
+        pass
+
+    stream = Stream('{"a": [1, 2]}')
+    stream.events = rj.iterparse(stream)
+    assert next(stream.events) == ('', 'start_map', None)
+    ref = weakref.ref(stream)
+    del stream
+    gc.collect()
+    assert ref() is None
+
+
+def test_distinct_keys_memory():
+    json = '{' + ','.join('"k%d":%d' % (i, i) for i in range(200000)) + '}'
+    stream = io.StringIO(json)
+    del json
+
+    tracemalloc.start()
+    try:
+        for event in rj.iterparse(stream):
+            pass
+        peak = tracemalloc.get_traced_memory()[1]
+    finally:
+        tracemalloc.stop()
+
+    # Only a bounded number of keys is kept interned
+    assert peak < 5 * 1024 * 1024
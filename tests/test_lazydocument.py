@@ -0,0 +1,210 @@
+# -*- coding: utf-8 -*-
+# :Project:   python-rapidjson -- Tests on LazyDocument
+# :Author:    Lele Gaifax <lele@metapensiero.it>
+# :License:   MIT License
+# :Copyright: © 2026 Lele Gaifax
+#
+
+from decimal import Decimal
+
+import pytest
+
+import rapidjson as rj
+
+
+DOCUMENT = '{"a": [1, {"b": "x"}], "a~b/c": 2.5, "c": null, "a": [3], "ü": true}'
+
+
+@pytest.mark.parametrize('json', [DOCUMENT, DOCUMENT.encode('utf-8'),
+                                  bytearray(DOCUMENT.encode('utf-8')),
+                                  memoryview(DOCUMENT.encode('utf-8'))])
+def test_object(json):
+    doc = rj.LazyDocument(json)
+    assert doc['a'] == [3]
+    assert doc['ü'] is True
+    assert doc.get('c', 0) is None
+    assert doc.get('z') is None
+    assert doc.get('z', 0) == 0
+    assert doc.keys() == ['a', 'a~b/c', 'c', 'ü']
+    assert list(doc) == doc.keys()
+    assert len(doc) == 4
+    assert len(doc) == 4
+    assert 'c' in doc
+    assert 'z' not in doc
+    assert 1 not in doc
+    with pytest.raises(KeyError):
+        doc['z']
+    assert rj.loads(rj.dumps(doc)) == rj.loads(DOCUMENT)
+
+
+def test_array():
+    doc = rj.LazyDocument(b' [1, [2, {"x": 3}], "s"] ')
+    assert doc[0] == 1
+    assert doc[-2] == [2, {'x': 3}]
+    assert doc.get(2) == 's'
+    assert doc.get(3) is None
+    assert len(doc) == 3
+    assert list(doc) == [1, [2, {'x': 3}], 's']
+    assert 's' in doc
+    with pytest.raises(IndexError):
+        doc[3]
+    with pytest.raises(IndexError):
+        doc[-4]
+    with pytest.raises(TypeError):
+        doc['0']
+    with pytest.raises(TypeError):
+        doc.keys()
+
+
+def test_array_positions():
+    values = [[i, {'v': [i]}] if i % 3 else i for i in range(3000)]
+    doc = rj.LazyDocument(rj.dumps(values))
+    assert [doc[i] for i in range(len(doc))] == values
+    assert [doc[-i] for i in range(1, len(doc) + 1)] == values[::-1]
+    nested = doc[1]
+    assert [nested[i] for i in range(len(nested))] == [1, {'v': [1]}]
+
+
+def test_array_iteration():
+    doc = rj.LazyDocument('[1, "two", [3, 4], {"five": 5}, null]')
+    items = list(doc)
+    assert items == [1, 'two', [3, 4], {'five': 5}, None]
+    assert [type(item) for item in items[2:4]] == [rj.LazyDocument] * 2
+    assert [list(item) for item in items[2:4]] == [[3, 4], ['five']]
+    assert list(rj.LazyDocument('[]')) == []
+
+    iterator = iter(doc)
+    assert iter(iterator) is iterator
+    del doc
+    assert next(iterator) == 1
+
+
+def test_array_contains():
+    doc = rj.LazyDocument('[1, "two", [3, 4], {"five": 5}, null, 2.5]')
+    assert 1 in doc and 1.0 in doc and True in doc
+    assert 'two' in doc and None in doc and 2.5 in doc
+    assert [3, 4] in doc
+    assert {'five': 5} in doc
+    assert rj.LazyDocument('[3, 4]') in doc
+    assert 3 not in doc
+    assert [3] not in doc
+    assert 'five' not in doc
+
+
+def test_views():
+    doc = rj.LazyDocument(' {"a": {"b": [1,  {"c": "è"}], "x": 2, "x": 3}, "d": [] } ')
+    a = doc['a']
+    assert type(a) is rj.LazyDocument
+    assert len(a) == 2
+    assert a.keys() == ['b', 'x']
+    assert a['x'] == 3
+    assert a == {'b': [1, {'c': 'è'}], 'x': 3}
+    assert a != {'b': [1, {'c': 'è'}], 'x': 2}
+    assert a == rj.LazyDocument('{"x": 3, "b": [1, {"c": "è"}]}')
+    assert doc.get('d') == []
+    assert len(doc.get('d')) == 0
+    assert doc.resolve('/a') == a
+    assert doc.resolve('') is doc
+
+    inner = doc.resolve('/a/b/1')
+    assert type(inner) is rj.LazyDocument
+    assert inner['c'] == 'è'
+    assert rj.dumps(inner, ensure_ascii=False) == '{"c": "è"}'
+    assert rj.dumps(inner) == '{"c":"\\u00E8"}'
+    assert rj.dumps(rj.LazyDocument('[[1,  2], "è"]')[0]) == '[1,  2]'
+    assert rj.dumps([doc['d'], a], ensure_ascii=False) == \
+        '[[],{"b": [1,  {"c": "è"}], "x": 2, "x": 3}]'
+
+    # Views keep the tape alive
+    del doc, a
+    assert inner == {'c': 'è'}
+
+
+def test_scalar():
+    doc = rj.LazyDocument('"string"')
+    assert doc.resolve('') == 'string'
+    with pytest.raises(TypeError):
+        doc[0]
+    assert rj.dumps(doc) == '"string"'
+
+
+@pytest.mark.parametrize('pointer,expected', [
+    ('', rj.loads(DOCUMENT)),
+    ('/a', [3]),
+    ('/a/0', 3),
+    ('/a~0b~1c', 2.5),
+    ('/ü', True),
+])
+def test_resolve(pointer, expected):
+    assert rj.LazyDocument(DOCUMENT).resolve(pointer) == expected
+
+
+@pytest.mark.parametrize('pointer', ['/z', '/a/1', '/a/-', '/a/00', '/c/x', '/a/0/x',
+                                     '/a/4294967296', '/a/18446744073709551616',
+                                     '/a/99999999999999999999999999999999'])
+def test_resolve_missing(pointer):
+    with pytest.raises(KeyError):
+        rj.LazyDocument(DOCUMENT).resolve(pointer)
+
+
+@pytest.mark.parametrize('pointer', ['a', '/a~2'])
+def test_resolve_invalid(pointer):
+    with pytest.raises(ValueError):
+        rj.LazyDocument(DOCUMENT).resolve(pointer)
+
+
+def test_modes():
+    doc = rj.LazyDocument('[1.5, "2024-01-02", NaN] // comment',
+                          number_mode=rj.NM_DECIMAL | rj.NM_NAN,
+                          datetime_mode=rj.DM_ISO8601,
+                          parse_mode=rj.PM_COMMENTS)
+    assert doc[0] == Decimal('1.5')
+    assert doc[1].year == 2024
+    assert doc[2].is_nan()
+
+
+def test_invalid():
+    with pytest.raises(rj.JSONDecodeError, match='offset 3'):
+        rj.LazyDocument('[1,')
+    with pytest.raises(rj.JSONDecodeError):
+        rj.LazyDocument(b'["\xff"]')
+    with pytest.raises(rj.JSONDecodeError):
+        rj.LazyDocument('[NaN]', allow_nan=False)
+    with pytest.raises(TypeError):
+        rj.LazyDocument(1)
+    with pytest.raises(RecursionError):
+        rj.LazyDocument('[' * 100000 + ']' * 100000)
+
+
+def test_dumps_verbatim():
+    doc = rj.LazyDocument(' {"b": [1,  2], "a": "è"} ')
+    assert rj.dumps([doc], ensure_ascii=False) == '[{"b": [1,  2], "a": "è"}]'
+    assert rj.dumps([doc]) == '[{"b":[1,2],"a":"\\u00E8"}]'
+    assert rj.dumps(doc, sort_keys=True) == '{"a":"\\u00E8","b":[1,2]}'
+    assert rj.dumps(doc, indent=1) == rj.dumps({'b': [1, 2], 'a': 'è'}, indent=1)
+
+    ascii = rj.LazyDocument('[1,  2]')
+    assert rj.dumps(ascii) == '[1,  2]'
+
+
+@pytest.mark.parametrize('mapping_mode', (rj.MM_ONLY_DICTS,
+                                          rj.MM_COERCE_KEYS_TO_STRINGS,
+                                          rj.MM_SKIP_NON_STRING_KEYS))
+def test_dumps_mapping_mode(mapping_mode):
+    doc = rj.LazyDocument('{"b": [1,  2], "a": null}')
+    assert rj.dumps(doc, mapping_mode=mapping_mode) == '{"b":[1,2],"a":null}'
+    assert rj.dumps(doc) == '{"b": [1,  2], "a": null}'
+
+
+def test_dumps_extensions():
+    doc = rj.LazyDocument('[1, NaN, ] /* x */',
+                          parse_mode=rj.PM_COMMENTS | rj.PM_TRAILING_COMMAS)
+    assert rj.dumps(doc) == '[1,NaN]'
+    with pytest.raises(ValueError):
+        rj.dumps(doc, allow_nan=False)
+
+
+def test_dumps_stop_when_done():
+    doc = rj.LazyDocument(' [1,  2] [3]', parse_mode=rj.PM_STOP_WHEN_DONE)
+    assert len(doc) == 2
+    assert rj.dumps(doc) == '[1,  2]'
@@ -0,0 +1,88 @@
+# -*- coding: utf-8 -*-
+# :Project:   python-rapidjson -- Tests on load_file()
+# :Author:    Lele Gaifax <lele@metapensiero.it>
+# :License:   MIT License
+# :Copyright: © 2026 Lele Gaifax
+#
+
+import os
+import threading
+
+import pytest
+
+import rapidjson as rj
+
+
+DOCUMENT = '{"id": 1, "tags": ["a", "b"], "name": "çàfé", "nested": {"value": 1.5}}'
+
+
+@pytest.fixture
+def json_file(tmp_path):
+    path = tmp_path / 'document.json'
+    path.write_text(DOCUMENT, encoding='utf-8')
+    return path
+
+
+@pytest.mark.parametrize('release_gil', (False, True))
+def test_load_file(json_file, release_gil):
+    expected = rj.loads(DOCUMENT)
+
+    assert rj.load_file(json_file, release_gil=release_gil) == expected
+    assert rj.load_file(str(json_file), release_gil=release_gil) == expected
+    assert rj.load_file(os.fsencode(json_file), release_gil=release_gil) == expected
+
+
+def test_options(json_file):
+    assert rj.load_file(json_file, select='/nested/value') == {'nested': {'value': 1.5}}
+    assert rj.load_file(json_file, object_hook=len) == 4
+    assert rj.load_file(json_file, number_mode=rj.NM_DECIMAL)['nested']['value'] == 1.5
+
+
+def test_decoder(json_file):
+    decoder = rj.Decoder(select=['/id', '/tags/1'])
+
+    assert decoder.load_file(json_file) == {'id': 1, 'tags': ['b']}
+
+
+@pytest.mark.skipif(not hasattr(os, 'mkfifo'), reason='Named pipes not available')
+def test_fifo(tmp_path):
+    path = tmp_path / 'document.fifo'
+    os.mkfifo(path)
+    values = [rj.loads(DOCUMENT)] * 2000
+
+    def write():
+        with open(path, 'w', encoding='utf-8') as fifo:
+            fifo.write(rj.dumps(values))
+
+    writer = threading.Thread(target=write)
+    writer.start()
+    try:
+        assert rj.load_file(path) == values
+    finally:
+        writer.join()
+
+
+def test_errors(tmp_path):
+    with pytest.raises(FileNotFoundError):
+        rj.load_file(tmp_path / 'missing.json')
+
+    with pytest.raises(OSError):
+        rj.load_file(tmp_path)
+
+    with pytest.raises(TypeError):
+        rj.load_file(42)
+
+    empty = tmp_path / 'empty.json'
+    empty.write_bytes(b'')
+    with pytest.raises(rj.JSONDecodeError):
+        rj.load_file(empty)
+
+    invalid = tmp_path / 'invalid.json'
+    invalid.write_bytes(b'["\xff"]')
+    with pytest.raises(rj.JSONDecodeError):
+        rj.load_file(invalid)
+
+    truncated = tmp_path / 'truncated.json'
+    truncated.write_bytes(b'{"id": 1, ')
+    with pytest.raises(rj.JSONDecodeError):
+        rj.load_file(truncated)
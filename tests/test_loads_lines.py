@@ -0,0 +1,103 @@
+# -*- coding: utf-8 -*-
+# :Project:   python-rapidjson -- Tests on loads_lines()
+# :Author:    Lele Gaifax <lele@metapensiero.it>
+# :License:   MIT License
+# :Copyright: © 2026 Lele Gaifax
+#
+
+from decimal import Decimal
+import json
+
+import pytest
+
+import rapidjson as rj
+
+
+RECORDS = [{'id': i, 'name': 'çàfé %d' % i, 'values': [i / 4, None, i % 2 == 0]}
+           for i in range(20000)]
+LINES = ''.join(json.dumps(record) + '\n' for record in RECORDS)
+
+
+@pytest.mark.parametrize('threads', (None, 1, 2, 3, 16))
+@pytest.mark.parametrize('encode', (False, True))
+def test_loads_lines(threads, encode):
+    data = LINES.encode('utf-8') if encode else LINES
+    assert rj.loads_lines(data, threads=threads) == RECORDS
+
+
+@pytest.mark.parametrize('data,expected', [
+    ('', []),
+    ('\n\n', []),
+    ('1', [1]),
+    ('1\n[2]\n\n{"three": 3}', [1, [2], {'three': 3}]),
+    ('"a"\r\n"b"\r\n', ['a', 'b']),
+])
+def test_small_inputs(data, expected):
+    assert rj.loads_lines(data, threads=4) == expected
+
+
+def test_modes():
+    data = '1.5 // one\n[2.5,]\n' * 10000
+    result = rj.loads_lines(data, number_mode=rj.NM_DECIMAL,
+                            parse_mode=rj.PM_COMMENTS | rj.PM_TRAILING_COMMAS,
+                            threads=4)
+    assert result == [Decimal('1.5'), [Decimal('2.5')]] * 10000
+
+
+def test_object_hook():
+    result = rj.loads_lines(LINES, object_hook=lambda d: d['id'], threads=4)
+    assert result == list(range(len(RECORDS)))
+
+
+@pytest.mark.parametrize('threads', (1, 4))
+def test_errors(threads):
+    position = len(LINES) * 3 // 4
+    position = LINES.index('\n', position) + 1
+    data = LINES[:position] + '[1 2]\n' + LINES[position:]
+    with pytest.raises(rj.JSONDecodeError) as exc:
+        rj.loads_lines(data, threads=threads)
+    assert ('at offset %d' % (len(LINES[:position].encode('utf-8')) + 3)
+            in str(exc.value))
+
+    def hook(d):
+        if d['id'] == len(RECORDS) - 1:
+            raise ZeroDivisionError
+        return d
+
+    with pytest.raises(ZeroDivisionError):
+        rj.loads_lines(LINES, object_hook=hook, threads=threads)
+
+    with pytest.raises(RecursionError):
+        rj.loads_lines(LINES + '[' * 100000, threads=threads)
+
+
+@pytest.mark.parametrize('lines', (1, 20000))
+@pytest.mark.parametrize('threads', (1, 4))
+def test_multiline_values(lines, threads):
+    data = '[1]\n' * lines + '{"a":\n 1}\n' + '[2]\n' * lines
+    with pytest.raises(rj.JSONDecodeError) as exc:
+        rj.loads_lines(data, threads=threads)
+    assert ('at offset %d: Each value must be on a single line' % (lines * 4 + 5)
+            in str(exc.value))
+
+
+@pytest.mark.parametrize('lines', (1, 20000))
+@pytest.mark.parametrize('threads', (1, 4))
+def test_several_values_on_a_line(lines, threads):
+    data = '[1]\n' * lines + '[1] [2]\n' + '[2]\n' * lines
+    with pytest.raises(rj.JSONDecodeError) as exc:
+        rj.loads_lines(data, threads=threads)
+    assert ('at offset %d: Each line must contain a single value' % (lines * 4 + 4)
+            in str(exc.value))
+
+    with pytest.raises(rj.JSONDecodeError):
+        rj.loads_lines('1 2\n3')
+
+
+def test_invalid_arguments():
+    with pytest.raises(TypeError):
+        rj.loads_lines(42)
+    with pytest.raises(ValueError):
+        rj.loads_lines('1', threads=0)
+    with pytest.raises(TypeError):
+        rj.loads_lines('1', threads='4')
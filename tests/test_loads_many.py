@@ -0,0 +1,78 @@
+# -*- coding: utf-8 -*-
+# :Project:   python-rapidjson -- Tests on Decoder.loads_many()
+# :Author:    Lele Gaifax <lele@metapensiero.it>
+# :License:   MIT License
+# :Copyright: © 2026 Lele Gaifax
+#
+
+from decimal import Decimal
+
+import pytest
+
+import rapidjson as rj
+
+
+DOCUMENTS = [
+    '{"id": 1, "tags": ["a", "b"], "price": 1.5}',
+    '{"id": 2, "tags": [], "price": null}',
+    '[1, 2, 3]',
+    '"çàfé"',
+    '{"id": 3, "nested": {"deep": [{"id": 4}]}}',
+]
+
+
+@pytest.mark.parametrize('release_gil', (False, True))
+def test_loads_many(release_gil):
+    decoder = rj.Decoder(release_gil=release_gil)
+    expected = [rj.loads(doc) for doc in DOCUMENTS]
+
+    assert decoder.loads_many(DOCUMENTS) == expected
+    assert decoder.loads_many(doc.encode('utf-8') for doc in DOCUMENTS) == expected
+    assert decoder.loads_many(bytearray(doc.encode('utf-8'))
+                              for doc in DOCUMENTS) == expected
+    assert decoder.loads_many([]) == []
+
+
+def test_shorter_after_longer():
+    decoder = rj.Decoder()
+    assert decoder.loads_many(['"' + 'x' * 1000 + '"', '1', '[]']) == ['x' * 1000, 1, []]
+
+
+def test_modes_and_hooks():
+    class MyDecoder(rj.Decoder):
+        def end_array(self, sequence):
+            return tuple(sequence)
+
+        def end_object(self, mapping):
+            return sorted(mapping.items())
+
+    decoder = MyDecoder(number_mode=rj.NM_DECIMAL, parse_mode=rj.PM_COMMENTS,
+                        select=('/a', '/c'))
+    assert decoder.loads_many(['{"a": 1.5, "b": 2} // one', '{"c": [1], "a": 2}']) == [
+        [('a', Decimal('1.5'))], [('a', 2), ('c', (1,))]]
+
+
+def test_shared_keys():
+    first, second = rj.Decoder().loads_many(['{"name": 1}', '{"name": 2}'])
+    assert list(first)[0] is list(second)[0]
+
+
+@pytest.mark.parametrize('jsons,exception', [
+    (['1', '[1,', '2'], rj.JSONDecodeError),
+    (['1', 2], TypeError),
+    (['1', b'"\xff"'], rj.JSONDecodeError),
+    (['1', '[' * 100000], RecursionError),
+    (42, TypeError),
+])
+def test_errors(jsons, exception):
+    with pytest.raises(exception):
+        rj.Decoder().loads_many(jsons)
+
+
+def test_error_in_iterable():
+    def documents():
+        yield '1'
+        raise ZeroDivisionError
+
+    with pytest.raises(ZeroDivisionError):
+        rj.Decoder().loads_many(documents())
@@ -10,6 +10,10 @@ from calendar import timegm
 from datetime import date, datetime, time, timezone, timedelta
 import io
 import math
+import os
+import subprocess
+import sys
+import threading
 import uuid
 
 import pytest
@@ -57,6 +61,48 @@ def test_ensure_ascii(dumps):
     assert dumps(s, ensure_ascii=False) == '"%s"' % s
 
 
+@pytest.mark.parametrize('size', [0, 1, 200, 255, 256, 257, 1000, 100000])
+@pytest.mark.parametrize('indent', [None, 2])
+def test_ensure_ascii_sizes(dumps, size, indent):
+    doc = ['x' * size, {'k': 'è' * (size // 10), 'n': list(range(size // 100))}]
+    result = dumps(doc, ensure_ascii=True, indent=indent)
+    assert result.isascii()
+    assert len(result) == len(result.encode('ascii'))
+    assert result == dumps(doc, ensure_ascii=False, indent=indent).replace('è', '\\u00E8')
+    assert rj.loads(result) == doc
+
+
+@pytest.mark.parametrize('indent', [None, 2])
+def test_ensure_ascii_raw_json(indent):
+    doc = ['x' * 300, rj.RawJSON('"è€"'), {'k': 'è'}]
+    result = rj.dumps(doc, ensure_ascii=True, indent=indent)
+    assert result == rj.dumps(doc, ensure_ascii=False, indent=indent).replace(
+        '"è"', '"\\u00E8"')
+    assert [ord(c) for c in result].count(0x20AC) == 1
+    assert rj.loads(result) == ['x' * 300, 'è€', {'k': 'è'}]
+
+
+@pytest.mark.parametrize('ensure_ascii', [True, False])
+@pytest.mark.parametrize('indent', [None, 2])
+def test_return_bytes(ensure_ascii, indent):
+    doc = ['x' * 1000, {'€': 'è' * 300, 'n': [1, 2.5, None, True]}]
+    expected = rj.dumps(doc, ensure_ascii=ensure_ascii, indent=indent).encode('utf-8')
+    result = rj.dumps(doc, ensure_ascii=ensure_ascii, indent=indent, return_bytes=True)
+    assert type(result) is bytes
+    assert result == expected
+    encoder = rj.Encoder(ensure_ascii=ensure_ascii, indent=indent)
+    assert encoder.encode_bytes(doc) == expected
+    assert rj.dumps('', return_bytes=True) == b'""'
+
+    class ComplexEncoder(rj.Encoder):
+        def default(self, obj):
+            return [obj.real, obj.imag]
+
+    assert ComplexEncoder().encode_bytes(1j) == b'[0.0,1.0]'
+    with pytest.raises(TypeError):
+        rj.Encoder().encode_bytes(object())
+
+
 def test_allow_nan():
     f = [1.1, float("inf"), 2.2, float("nan"), 3.3, float("-inf"), 4.4]
     expected = '[1.1,Infinity,2.2,NaN,3.3,-Infinity,4.4]'
@@ -156,6 +202,48 @@ def test_parse_mode(dumps, loads):
     assert loads(c_and_tc, parse_mode=rj.PM_COMMENTS | rj.PM_TRAILING_COMMAS) == expected
 
 
+def test_parse_mode_flags(loads):
+    pytest.raises(ValueError, loads, '[1, 2] [3]')
+    assert loads('[1, 2] [3]', parse_mode=rj.PM_STOP_WHEN_DONE) == [1, 2]
+    assert loads('{"a": 1} garbage', parse_mode=rj.PM_STOP_WHEN_DONE) == {'a': 1}
+    assert loads('[1, /* x */ 2,] [', parse_mode=(rj.PM_STOP_WHEN_DONE
+                                                | rj.PM_COMMENTS
+                                                | rj.PM_TRAILING_COMMAS)) == [1, 2]
+
+    for number_mode in (None, rj.NM_NATIVE, rj.NM_DECIMAL):
+        loaded = loads('[0.1, 1e300, 2.2250738585072014e-308]', number_mode=number_mode,
+                       parse_mode=rj.PM_FULL_PRECISION | rj.PM_VALIDATE_ENCODING)
+        assert [float(f) for f in loaded] == [0.1, 1e300, 2.2250738585072014e-308]
+
+    # Full precision matches the native conversion, bounds included
+    for json in ('[18446744073709551615, -9223372036854775808]',
+                 '[18446744073709551616, -9223372036854775809]'):
+        assert (loads(json, number_mode=rj.NM_NATIVE, parse_mode=rj.PM_FULL_PRECISION)
+                == loads(json, number_mode=rj.NM_NATIVE))
+    with pytest.raises(rj.JSONDecodeError, match='Number too big'):
+        loads('[1e400]', number_mode=rj.NM_NATIVE, parse_mode=rj.PM_FULL_PRECISION)
+
+    # The content after the document is checked as in the reader
+    assert loads('[1] // x', parse_mode=rj.PM_COMMENTS) == [1]
+    assert loads('[1] /* x */ ', parse_mode=rj.PM_COMMENTS) == [1]
+    with pytest.raises(rj.JSONDecodeError, match='offset 4: The document root'):
+        loads('[1] /* x */')
+    with pytest.raises(rj.JSONDecodeError, match='offset 8: Unspecific'):
+        loads('[1] /* x', parse_mode=rj.PM_COMMENTS)
+    with pytest.raises(rj.JSONDecodeError, match='offset 5: Unspecific'):
+        loads('[1] /x', parse_mode=rj.PM_COMMENTS)
+
+    with pytest.raises(ValueError, match='Invalid parse_mode'):
+        loads('[]', parse_mode=rj.PM_STOP_WHEN_DONE << 1)
+
+
+def test_parse_mode_validate_encoding():
+    with pytest.raises(UnicodeDecodeError):
+        rj.load(io.BytesIO(b'["\xff"]'))
+    with pytest.raises(rj.JSONDecodeError, match='Invalid encoding'):
+        rj.load(io.BytesIO(b'["\xff"]'), parse_mode=rj.PM_VALIDATE_ENCODING)
+
+
 def test_indent(dumps):
     o = {"a": 1, "z": 2, "b": 3}
     expected1 = '{\n    "a": 1,\n    "z": 2,\n    "b": 3\n}'
@@ -374,6 +462,51 @@ def test_datetime_mode_loads(dumps, loads):
     assert load_as_naive == local.replace(tzinfo=None)
 
 
+@pytest.mark.parametrize('value', [
+    '2024-02-29T23:30:00+01:00',
+    '2024-02-29T22:30:00-01:30',
+    '2023-02-28T23:59:59.999999-00:01',
+    '2023-12-31T23:00:00-23:59',
+    '2024-01-01T00:15:00+23:59',
+    '2000-03-01T00:00:00+00:01',
+    '1900-03-01T00:00:00+05:00',
+    '2024-06-15T12:00:00-00:00',
+    '9999-12-31T23:59:59+00:01',
+    '0001-01-01T00:01:00+00:01',
+])
+def test_datetime_mode_shift_to_utc(value, loads):
+    expected = datetime.fromisoformat(value)
+    jsond = '"%s"' % value
+
+    loaded = loads(jsond, datetime_mode=rj.DM_ISO8601)
+    assert loaded == expected
+    assert loaded.utcoffset() == expected.utcoffset()
+
+    as_utc = loads(jsond, datetime_mode=rj.DM_ISO8601 | rj.DM_SHIFT_TO_UTC)
+    assert as_utc == expected
+    assert as_utc.tzinfo is timezone.utc
+    assert as_utc.replace(tzinfo=None) == expected.astimezone(timezone.utc).replace(
+        tzinfo=None)
+
+
+@pytest.mark.parametrize('value', [
+    '0001-01-01T00:00:00+00:01',
+    '9999-12-31T23:59:00-00:01',
+])
+def test_datetime_mode_shift_to_utc_overflow(value, loads):
+    with pytest.raises(OverflowError):
+        loads('"%s"' % value, datetime_mode=rj.DM_ISO8601 | rj.DM_SHIFT_TO_UTC)
+
+
+def test_datetime_mode_shared_timezones(loads):
+    res = loads('["2024-01-01T10:00:00+02:00", "10:00:00+02:00",'
+                ' "2024-01-02T10:00:00+02:00", "2024-01-02T10:00:00-02:00"]',
+                datetime_mode=rj.DM_ISO8601)
+    assert res[0].tzinfo is res[1].tzinfo is res[2].tzinfo
+    assert res[0].tzinfo is not res[3].tzinfo
+    assert res[3].utcoffset() == timedelta(hours=-2)
+
+
 @pytest.mark.parametrize(
     'value', [date.today(), datetime.now(), time(10,20,30)])
 def test_datetime_values(value, dumps, loads):
@@ -558,6 +691,27 @@ def test_uuid_hex(value, cls, loads):
     assert isinstance(result, cls), type(result)
 
 
+@pytest.mark.parametrize(
+    'value', [
+        '00000000-0000-0000-0000-000000000000',
+        'ffffffff-ffff-ffff-ffff-ffffffffffff',
+        '7A683DA4-9AA0-11E5-972E-3085A99CCAC7',
+        '7a683da49aa011e5972e3085a99ccac7',
+        '0123456789abcdefFEDCBA9876543210',
+    ])
+def test_uuid_value(value, loads):
+    expected = uuid.UUID(value)
+    result = loads('["%s"]' % value, uuid_mode=rj.UM_HEX)[0]
+    assert type(result) is uuid.UUID
+    assert result == expected
+    assert result.int == expected.int
+    assert result.is_safe is expected.is_safe
+    assert str(result) == str(expected)
+    assert hash(result) == hash(expected)
+    with pytest.raises(TypeError):
+        result.int = 0
+
+
 def test_object_hook():
     class Foo:
         def __init__(self, foo):
@@ -738,6 +892,62 @@ def test_encoder_call():
     assert stream.getvalue() == result
 
 
+@pytest.mark.parametrize('ensure_ascii', [True, False])
+def test_encoder_reuse(ensure_ascii):
+    encoder = rj.Encoder(ensure_ascii=ensure_ascii)
+    # The 9M one exceeds the maximum size of the buffer kept by the encoder
+    values = [['è' * size, list(range(size % 100000))]
+              for size in (10, 100000, 3, 5000, 0, 5000, 9000000, 7)]
+    for value in values:
+        expected = rj.dumps(value, ensure_ascii=ensure_ascii)
+        assert encoder(value) == expected
+        assert encoder.encode_bytes(value) == expected.encode('utf-8')
+
+
+def test_encoder_kept_buffer():
+    encoder = rj.Encoder(ensure_ascii=False)
+    empty = sys.getsizeof(encoder)
+    value = ['è' * 100000]
+    expected = rj.dumps(value, ensure_ascii=False)
+    size = len(expected.encode('utf-8'))
+
+    # The buffer holding the UTF-8 output is kept, and reused by the next calls
+    assert encoder(value) == expected
+    kept = sys.getsizeof(encoder)
+    assert kept - empty >= size
+    assert encoder(value) == expected
+    assert encoder([1]) == '[1]'
+    assert sys.getsizeof(encoder) == kept
+
+    # but not when it grew beyond 16MB
+    assert encoder(['è' * 9000000]) == rj.dumps(['è' * 9000000], ensure_ascii=False)
+    assert sys.getsizeof(encoder) == empty
+
+    # A new buffer is presized from the size of the previous outputs
+    assert encoder([1]) == '[1]'
+    assert sys.getsizeof(encoder) - empty > size
+
+    # With ensure_ascii the output is built directly in the resulting str
+    encoder = rj.Encoder()
+    empty = sys.getsizeof(encoder)
+    assert encoder(value) == rj.dumps(value)
+    assert sys.getsizeof(encoder) == empty
+
+
+@pytest.mark.parametrize('ensure_ascii', [True, False])
+def test_encoder_reentrant(ensure_ascii):
+    class NestingEncoder(rj.Encoder):
+        def default(self, obj):
+            return self(list(obj))
+
+    encoder = NestingEncoder(ensure_ascii=ensure_ascii)
+    value = ['è', {'è'}]
+    expected = rj.dumps(['è', rj.dumps(['è'], ensure_ascii=ensure_ascii)],
+                        ensure_ascii=ensure_ascii)
+    assert encoder(value) == expected
+    assert encoder(value) == expected
+
+
 def test_decoder_attrs():
     d = rj.Decoder(
         number_mode=rj.NM_NAN,
@@ -748,6 +958,95 @@ def test_decoder_attrs():
     assert d.datetime_mode == rj.DM_ISO8601
     assert d.uuid_mode == rj.UM_CANONICAL
     assert d.parse_mode == rj.PM_COMMENTS
+    assert d.key_cache_size == 0
+
+    d = rj.Decoder(key_cache_size=100)
+    assert d.key_cache_size == 100
+    assert not d.release_gil
+
+    d = rj.Decoder(release_gil=True)
+    assert d.release_gil
+
+
+def test_release_gil():
+    doc = [{'id': i, 'name': f'item{i}', 'tags': ['a', 'b'], 'price': i / 3,
+            'when': '2024-02-29T12:34:56Z'} for i in range(1000)]
+    asjson = rj.dumps(doc)
+    expected = rj.loads(asjson, datetime_mode=rj.DM_ISO8601)
+
+    class PairsDecoder(rj.Decoder):
+        def end_object(self, obj):
+            return sorted(obj.items())
+
+    decoders = [
+        lambda j: rj.loads(j, release_gil=True, datetime_mode=rj.DM_ISO8601),
+        lambda j: rj.Decoder(datetime_mode=rj.DM_ISO8601, release_gil=True)(
+            j.encode('utf-8')),
+    ]
+    results = []
+
+    def worker(decode):
+        for _ in range(10):
+            results.append(decode(asjson))
+
+    threads = [threading.Thread(target=worker, args=(decoders[i % 2],))
+               for i in range(8)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+
+    assert len(results) == 80
+    assert all(result == expected for result in results)
+
+    result = PairsDecoder(release_gil=True)('{"b": [1, {"d": 2, "c": 3}], "a": null}')
+    assert result == [('a', None), ('b', [1, [('c', 3), ('d', 2)]])]
+
+    with pytest.raises(rj.JSONDecodeError, match='Parse error at offset 9'):
+        rj.loads('[1, 2, 3,]', release_gil=True)
+
+
+@pytest.mark.skipif(not sys.platform.startswith('linux'), reason='Linux only')
+def test_release_gil_out_of_memory():
+    # The tape is built with the GIL released: running out of memory there must raise a
+    # MemoryError instead of aborting the process
+    script = """
+import resource
+import rapidjson
+doc = '[' + '1,' * 10000000 + '1]'
+with open('/proc/self/statm') as f:
+    size = int(f.read().split()[0]) * resource.getpagesize()
+resource.setrlimit(resource.RLIMIT_AS, (size + 100 * 1024 * 1024,) * 2)
+try:
+    rapidjson.loads(doc, release_gil=True)
+except MemoryError:
+    print('MemoryError')
+"""
+    env = dict(os.environ, PYTHONPATH=os.pathsep.join(sys.path))
+    result = subprocess.run([sys.executable, '-c', script], capture_output=True,
+                            text=True, env=env)
+    assert result.returncode == 0
+    assert result.stdout == 'MemoryError\n'
+
+
+def test_decoder_key_cache_size():
+    pytest.raises(ValueError, rj.Decoder, key_cache_size=-1)
+    pytest.raises(TypeError, rj.Decoder, key_cache_size='foo')
+
+    d = rj.Decoder(key_cache_size=10)
+    first = d('{"a": 1, "b": 2}')
+    second = d('{"b": 3, "a": 4}')
+    assert second == {'a': 4, 'b': 3}
+    for key1, key2 in zip(sorted(first), sorted(second)):
+        assert key1 is key2
+
+    # Evictions must not affect the results
+    keys = [f'key{i}' for i in range(100)]
+    doc = [{k: i} for i, k in enumerate(keys)] * 3
+    for _ in range(3):
+        assert d(rj.dumps(doc)) == doc
+    hot = d('{"key0": 0}')
+    assert next(iter(d('{"key0": 1}'))) is next(iter(hot))
 
 
 def test_encoder_attrs():
@@ -139,6 +139,18 @@ def test_decoder_call_leaks():
     assert (rc1 - rc0) < THRESHOLD
 
 
+@pytest.mark.skipif(not hasattr(sys, 'gettotalrefcount'), reason='Non-debug Python')
+def test_decoder_key_cache_leaks():
+    decoder = rj.Decoder(key_cache_size=10)
+    decoder('{"warm": "up"}')
+    rc0 = sys.gettotalrefcount()
+    for i in range(1000):
+        value = decoder('[{"foo": "bar"}, {"key%d": "value"}]' % i)
+        del value
+    rc1 = sys.gettotalrefcount()
+    assert (rc1 - rc0) < THRESHOLD
+
+
 @pytest.mark.parametrize('value', ['Foo', rj.RawJSON('Foo')])
 @pytest.mark.skipif(not hasattr(sys, 'gettotalrefcount'), reason='Non-debug Python')
 def test_encoder_call_leaks(value):
@@ -0,0 +1,120 @@
+# -*- coding: utf-8 -*-
+# :Project:   python-rapidjson -- Tests on the select option
+# :Author:    Lele Gaifax <lele@metapensiero.it>
+# :License:   MIT License
+# :Copyright: © 2026 Lele Gaifax
+#
+
+import io
+
+import pytest
+
+import rapidjson as rj
+
+
+DOCUMENT = '''
+{"id": 7,
+ "user": {"name": "Bob", "age": 42, "tags": ["a", "b"]},
+ "rows": [{"id": 1, "x": 2.5}, {"id": 2, "x": [3]}, null],
+ "*": "star",
+ "a/b": {"~": true}}
+'''
+
+
+def loads(json, select, **opts):
+    return rj.loads(json, select=select, **opts)
+
+
+def loads_without_gil(json, select, **opts):
+    return rj.loads(json, select=select, release_gil=True, **opts)
+
+
+def load(json, select, **opts):
+    return rj.load(io.StringIO(json), select=select, chunk_size=4, **opts)
+
+
+def decoder(json, select, **opts):
+    return rj.Decoder(select=select, **opts)(json)
+
+
+@pytest.fixture(params=(loads, loads_without_gil, load, decoder))
+def select(request):
+    return request.param
+
+
+@pytest.mark.parametrize('paths,expected', [
+    (None, rj.loads(DOCUMENT)),
+    ('', rj.loads(DOCUMENT)),
+    ([''], rj.loads(DOCUMENT)),
+    ([], {}),
+    ('/id', {'id': 7}),
+    (['/id', '/user/name'], {'id': 7, 'user': {'name': 'Bob'}}),
+    (['/user', '/user/name'], {'user': {'name': 'Bob', 'age': 42, 'tags': ['a', 'b']}}),
+    ('/user/tags/1', {'user': {'tags': ['b']}}),
+    ('/user/tags/01', {'user': {'tags': []}}),
+    ('/user/nickname', {'user': {}}),
+    ('/id/foo', {}),
+    ('/rows/*/id', {'rows': [{'id': 1}, {'id': 2}]}),
+    (['/rows/*/id', '/rows/1/x'], {'rows': [{'id': 1}, {'id': 2, 'x': [3]}]}),
+    ('/rows/*', {'rows': [{'id': 1, 'x': 2.5}, {'id': 2, 'x': [3]}, None]}),
+    ('/*', rj.loads(DOCUMENT)),
+    ('/a~1b/~0', {'a/b': {'~': True}}),
+    ([('*',)], {'*': 'star'}),
+    ([('rows', 0, 'x'), ['rows', ..., 'id']], {'rows': [{'id': 1, 'x': 2.5},
+                                                        {'id': 2}]}),
+    ([('rows', '0')], {'rows': []}),
+    ([()], rj.loads(DOCUMENT)),
+])
+def test_select(select, paths, expected):
+    assert select(DOCUMENT, paths) == expected
+
+
+@pytest.mark.parametrize('json', ['1', '"foo"', 'null'])
+def test_scalar_document(select, json):
+    assert select(json, '/foo') == rj.loads(json)
+
+
+def test_skipped_values_are_validated(select):
+    with pytest.raises(rj.JSONDecodeError):
+        select('{"a": 1, "b": [1, 2, }', '/a')
+    with pytest.raises(ValueError):
+        select('{"a": 1, "b": NaN}', '/a', number_mode=rj.NM_NONE)
+
+
+def test_hooks():
+    class KeyValuePairs(rj.Decoder):
+        def start_object(self):
+            return []
+
+        def end_object(self, pairs):
+            return dict(pairs)
+
+    decoder = KeyValuePairs(select=['/user/name', '/rows/0'])
+    assert decoder(DOCUMENT) == {'user': {'name': 'Bob'},
+                                 'rows': [{'id': 1, 'x': 2.5}]}
+
+    assert rj.loads(DOCUMENT, select='/user/age',
+                    object_hook=lambda d: sorted(d)) == ['user']
+
+
+def test_decoder_iter():
+    decoder = rj.Decoder(select='/id')
+    assert list(decoder.iter('{"id": 1, "x": 2}\n{"id": 2, "x": 3}')) == [
+        {'id': 1}, {'id': 2}]
+
+
+@pytest.mark.parametrize('paths,exception', [
+    ('foo', ValueError),
+    ('/foo~2', ValueError),
+    ('/foo~', ValueError),
+    ([('foo', -1)], ValueError),
+    ([('foo', 1.5)], TypeError),
+    ([('foo', True)], TypeError),
+    ([42], TypeError),
+    (42, TypeError),
+])
+def test_invalid_select(paths, exception):
+    with pytest.raises(exception):
+        rj.loads(DOCUMENT, select=paths)
+    with pytest.raises(exception):
+        rj.Decoder(select=paths)
@@ -83,3 +83,75 @@ def test_file_object():
             rj.dump(datum, stream)
             stream.seek(0)
             assert rj.load(stream) == datum
+
+
+class CattyBinaryStream(io.BytesIO):
+    def readinto(self, *args, **kwargs):
+        raise CattyError('No real reason')
+
+
+class LyingBinaryStream(io.BytesIO):
+    def readinto(self, buffer):
+        return len(buffer) + 1
+
+
+class NonBlockingBinaryStream(io.BytesIO):
+    def readinto(self, buffer):
+        return None
+
+
+@pytest.mark.parametrize('stream,exception', [
+    (CattyBinaryStream(b'"foo"'), CattyError),
+    (LyingBinaryStream(b'"foo"'), ValueError),
+    (NonBlockingBinaryStream(b'"foo"'), BlockingIOError),
+])
+def test_underlying_stream_readinto_error(stream, exception):
+    with pytest.raises(exception):
+        rj.load(stream)
+
+
+class ReadIntoCountingStream(io.BytesIO):
+    def __init__(self, data):
+        super().__init__(data)
+        self.calls = 0
+
+    def readinto(self, buffer):
+        self.calls += 1
+        return super().readinto(buffer)
+
+
+def test_readinto():
+    datum = {'a': ['1234567890', 1234, 3.14, '~𓆙~'] * 10}
+    stream = ReadIntoCountingStream(rj.dumps(datum).encode('utf-8'))
+    assert rj.load(stream, chunk_size=4) == datum
+    assert stream.calls > 1
+
+
+class ReplacingStream(io.BytesIO):
+    def read(self, size=-1):
+        return super().read(size).replace(b'1', b'2')
+
+
+def test_overridden_read():
+    stream = ReplacingStream(b'[1, 1]')
+    assert rj.load(stream, chunk_size=4) == [2, 2]
+    stream.seek(0)
+    assert list(rj.iterload(stream)) == [[2, 2]]
+
+
+@pytest.mark.parametrize('chunk_size', (4, 7, 65536))
+def test_binary_files(tmp_path, chunk_size):
+    datum = ['1234567890', 1234, 3.14, '~𓆙~'] * 100
+    path = tmp_path / 'datum.json'
+    path.write_text(rj.dumps(datum), encoding='utf-8')
+
+    with io.FileIO(path) as stream:
+        assert rj.load(stream, chunk_size=chunk_size) == datum
+    with open(path, 'rb') as stream:
+        assert rj.load(stream, chunk_size=chunk_size) == datum
+    with open(path, 'rb', buffering=0) as stream:
+        assert list(rj.iterload(stream, chunk_size=chunk_size)) == [datum]
+    with io.FileIO(path) as stream:
+        stream.close()
+        with pytest.raises(ValueError):
+            rj.load(stream)
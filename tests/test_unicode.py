@@ -6,6 +6,7 @@
 # :Copyright: © 2016, 2017, 2018, 2020 Lele Gaifax
 #
 
+import io
 import json
 
 import pytest
@@ -61,3 +62,33 @@ def test_non_utf8_bytes(dumps):
     value = b'\xff\xf0'
     with pytest.raises(UnicodeDecodeError, match="'utf-8' codec can't decode byte"):
         dumps(value)
+
+
+@pytest.mark.parametrize('u', [
+    '',
+    'plain ascii, longer than a single word',
+    'café \u0080ÿ',
+    'Ā ߿ ࠀ ￿ and some ascii',
+    'abcdefgh\U0001f600\U0010ffffé€',
+    'a' * 7 + 'é' + 'b' * 9,
+])
+def test_decode_kinds(u, loads):
+    doc = {u: [u, {u: u}]}
+    assert loads(json.dumps(doc)) == doc
+    assert loads(json.dumps(doc, ensure_ascii=False)) == doc
+    decoded = loads(json.dumps(u, ensure_ascii=False))
+    assert decoded == u
+    assert decoded.isascii() == u.isascii()
+
+
+@pytest.mark.parametrize('b', [
+    b'"\xff"',
+    b'"abcdefgh\xc3"',
+    b'"\xc0\x80"',
+    b'"\xed\xa0\x80"',
+    b'"\xf4\x90\x80\x80"',
+    b'"\x80abc"',
+])
+def test_load_invalid_utf8_stream(b):
+    with pytest.raises(UnicodeDecodeError):
+        rapidjson.load(io.BytesIO(b))
@@ -6,8 +6,15 @@
 # :Copyright: © 2024 Lele Gaifax
 #
 
+import os
+import sys
 import typing as t
 
+if sys.version_info >= (3, 12):
+    from collections.abc import Buffer as _Buffer
+else:
+    _Buffer = t.Union[bytes, bytearray, memoryview]
+
 
 __rapidjson_exact_version__: str
 __rapidjson_version__: str
@@ -24,6 +31,12 @@ _JSONType = t.Union[
 ]
 
 
+_Selection = t.Union[
+    str,
+    t.Iterable[t.Union[str, t.Sequence[t.Union[str, int, "ellipsis"]]]],
+]
+
+
 # Const types
 _BM_NONE_TYPE = t.Literal[0]
 _BM_UTF8_TYPE = t.Literal[1]
@@ -46,8 +59,11 @@ _NM_NAN_TYPE = t.Literal[1]
 _NM_NATIVE_TYPE = t.Literal[4]
 _NM_NONE_TYPE = t.Literal[0]
 _PM_COMMENTS_TYPE = t.Literal[1]
+_PM_FULL_PRECISION_TYPE = t.Literal[4]
 _PM_NONE_TYPE = t.Literal[0]
+_PM_STOP_WHEN_DONE_TYPE = t.Literal[16]
 _PM_TRAILING_COMMAS_TYPE = t.Literal[2]
+_PM_VALIDATE_ENCODING_TYPE = t.Literal[8]
 _UM_CANONICAL_TYPE = t.Literal[1]
 _UM_HEX_TYPE = t.Literal[2]
 _UM_NONE_TYPE = t.Literal[0]
@@ -78,8 +94,11 @@ NM_NAN: _NM_NAN_TYPE = 1
 NM_NATIVE: _NM_NATIVE_TYPE = 4
 NM_NONE: _NM_NONE_TYPE = 0
 PM_COMMENTS: _PM_COMMENTS_TYPE = 1
+PM_FULL_PRECISION: _PM_FULL_PRECISION_TYPE = 4
 PM_NONE: _PM_NONE_TYPE = 0
+PM_STOP_WHEN_DONE: _PM_STOP_WHEN_DONE_TYPE = 16
 PM_TRAILING_COMMAS: _PM_TRAILING_COMMAS_TYPE = 2
+PM_VALIDATE_ENCODING: _PM_VALIDATE_ENCODING_TYPE = 8
 UM_CANONICAL: _UM_CANONICAL_TYPE = 1
 UM_HEX: _UM_HEX_TYPE = 2
 UM_NONE: _UM_NONE_TYPE = 0
@@ -100,6 +119,7 @@ _MappingMode = int
 
 
 # Functions
+@t.overload
 def dumps(
     obj: t.Any,
     *,
@@ -116,7 +136,46 @@ def dumps(
     iterable_mode: t.Optional[_IterableMode] = IM_ANY_ITERABLE,
     mapping_mode: t.Optional[_MappingMode] = MM_ANY_MAPPING,
     allow_nan: t.Optional[bool] = True,
+    return_bytes: t.Literal[False] = ...,
 ) -> str: ...
+@t.overload
+def dumps(
+    obj: t.Any,
+    *,
+    skipkeys: t.Optional[bool] = False,
+    ensure_ascii: t.Optional[bool] = True,
+    write_mode: t.Optional[_WriteMode] = WM_COMPACT,
+    indent: t.Optional[t.Union[int, str]] = 4,
+    default: t.Optional[t.Callable[[t.Any], _JSONType]] = None,
+    sort_keys: t.Optional[bool] = False,
+    number_mode: t.Optional[_NumberMode] = NM_NAN,
+    datetime_mode: t.Optional[_DatetimeMode] = DM_NONE,
+    uuid_mode: t.Optional[_UUIDMode] = UM_NONE,
+    bytes_mode: t.Optional[_BytesMode] = BM_UTF8,
+    iterable_mode: t.Optional[_IterableMode] = IM_ANY_ITERABLE,
+    mapping_mode: t.Optional[_MappingMode] = MM_ANY_MAPPING,
+    allow_nan: t.Optional[bool] = True,
+    return_bytes: t.Literal[True],
+) -> bytes: ...
+@t.overload
+def dumps(
+    obj: t.Any,
+    *,
+    skipkeys: t.Optional[bool] = False,
+    ensure_ascii: t.Optional[bool] = True,
+    write_mode: t.Optional[_WriteMode] = WM_COMPACT,
+    indent: t.Optional[t.Union[int, str]] = 4,
+    default: t.Optional[t.Callable[[t.Any], _JSONType]] = None,
+    sort_keys: t.Optional[bool] = False,
+    number_mode: t.Optional[_NumberMode] = NM_NAN,
+    datetime_mode: t.Optional[_DatetimeMode] = DM_NONE,
+    uuid_mode: t.Optional[_UUIDMode] = UM_NONE,
+    bytes_mode: t.Optional[_BytesMode] = BM_UTF8,
+    iterable_mode: t.Optional[_IterableMode] = IM_ANY_ITERABLE,
+    mapping_mode: t.Optional[_MappingMode] = MM_ANY_MAPPING,
+    allow_nan: t.Optional[bool] = True,
+    return_bytes: bool,
+) -> t.Union[str, bytes]: ...
 def dump(
     obj: t.Any,
     stream: t.IO,
@@ -145,20 +204,75 @@ def load(
     uuid_mode: t.Optional[_UUIDMode] = UM_NONE,
     parse_mode: t.Optional[_ParseMode] = PM_NONE,
     chunk_size: t.Optional[int] = 65536,
+    select: t.Optional[_Selection] = None,
     allow_nan: t.Optional[bool] = True,
 ) -> t.Any: ...
 def loads(
-    string: t.Union[str, bytes, bytearray],
+    string: t.Union[str, _Buffer],
     *,
     object_hook: t.Optional[t.Callable[[t.Dict[str, t.Any]], t.Any]] = None,
     number_mode: t.Optional[_NumberMode] = NM_NAN,
     datetime_mode: t.Optional[_DatetimeMode] = DM_NONE,
     uuid_mode: t.Optional[_UUIDMode] = UM_NONE,
     parse_mode: t.Optional[_ParseMode] = PM_NONE,
+    release_gil: bool = False,
+    select: t.Optional[_Selection] = None,
+    destructive: bool = False,
+    allow_nan: t.Optional[bool] = True,
+) -> t.Any: ...
+def load_file(
+    path: t.Union[str, bytes, os.PathLike],
+    *,
+    object_hook: t.Optional[t.Callable[[t.Dict[str, t.Any]], t.Any]] = None,
+    number_mode: t.Optional[_NumberMode] = NM_NAN,
+    datetime_mode: t.Optional[_DatetimeMode] = DM_NONE,
+    uuid_mode: t.Optional[_UUIDMode] = UM_NONE,
+    parse_mode: t.Optional[_ParseMode] = PM_NONE,
+    release_gil: bool = False,
+    select: t.Optional[_Selection] = None,
     allow_nan: t.Optional[bool] = True,
 ) -> t.Any: ...
 
 
+def iterload(
+    json: t.Union[str, _Buffer, t.IO],
+    *,
+    object_hook: t.Optional[t.Callable[[t.Dict[str, t.Any]], t.Any]] = None,
+    number_mode: t.Optional[_NumberMode] = NM_NAN,
+    datetime_mode: t.Optional[_DatetimeMode] = DM_NONE,
+    uuid_mode: t.Optional[_UUIDMode] = UM_NONE,
+    parse_mode: t.Optional[_ParseMode] = PM_NONE,
+    chunk_size: t.Optional[int] = 65536,
+    allow_nan: t.Optional[bool] = True,
+) -> t.Iterator[t.Any]: ...
+
+
+def iterparse(
+    stream: t.IO,
+    prefix: t.Optional[str] = None,
+    *,
+    number_mode: t.Optional[_NumberMode] = NM_NAN,
+    datetime_mode: t.Optional[_DatetimeMode] = DM_NONE,
+    uuid_mode: t.Optional[_UUIDMode] = UM_NONE,
+    parse_mode: t.Optional[_ParseMode] = PM_NONE,
+    chunk_size: t.Optional[int] = 65536,
+    allow_nan: t.Optional[bool] = True,
+) -> t.Iterator[t.Tuple[str, str, t.Any]]: ...
+
+
+def loads_lines(
+    string: t.Union[str, _Buffer],
+    *,
+    object_hook: t.Optional[t.Callable[[t.Dict[str, t.Any]], t.Any]] = None,
+    number_mode: t.Optional[_NumberMode] = NM_NAN,
+    datetime_mode: t.Optional[_DatetimeMode] = DM_NONE,
+    uuid_mode: t.Optional[_UUIDMode] = UM_NONE,
+    parse_mode: t.Optional[_ParseMode] = PM_NONE,
+    threads: t.Optional[int] = None,
+    allow_nan: t.Optional[bool] = True,
+) -> t.List[t.Any]: ...
+
+
 # Classes
 class JSONDecodeError(Exception): ...
 class ValidationError(Exception): ...
@@ -166,8 +280,10 @@ class ValidationError(Exception): ...
 
 class Decoder:
     datetime_mode: _DatetimeMode
+    key_cache_size: int
     number_mode: _NumberMode
     parse_mode: _ParseMode
+    release_gil: bool
     uuid_mode: _UUIDMode
 
     def __init__(
@@ -176,12 +292,29 @@ class Decoder:
         number_mode: t.Optional[_NumberMode] = NM_NAN,
         parse_mode: t.Optional[_ParseMode] = PM_NONE,
         uuid_mode: t.Optional[_UUIDMode] = UM_NONE,
+        key_cache_size: t.Optional[int] = None,
+        release_gil: bool = False,
+        select: t.Optional[_Selection] = None,
     ) -> None: ...
     def __call__(
         self,
-        json: t.Union[str, bytes, bytearray, t.IO],
+        json: t.Union[str, _Buffer, t.IO],
         chunk_size: t.Optional[int] = 65536,
     ) -> t.Any: ...
+    def iter(
+        self,
+        json: t.Union[str, _Buffer, t.IO],
+        *,
+        chunk_size: t.Optional[int] = 65536,
+    ) -> t.Iterator[t.Any]: ...
+    def loads_many(
+        self,
+        jsons: t.Iterable[t.Union[str, _Buffer]],
+    ) -> t.List[t.Any]: ...
+    def load_file(
+        self,
+        path: t.Union[str, bytes, os.PathLike],
+    ) -> t.Any: ...
 
 
 class Encoder:
@@ -218,6 +351,13 @@ class Encoder:
         stream: t.Optional[t.IO] = None,
         chunk_size: t.Optional[int] = 65536,
     ) -> t.Optional[str]: ...
+    def dump_into(
+        self,
+        obj: t.Any,
+        buffer: t.Union[bytearray, memoryview],
+        offset: int = 0,
+    ) -> int: ...
+    def encode_bytes(self, obj: t.Any) -> bytes: ...
 
 
 @t.final
@@ -226,6 +366,28 @@ class RawJSON:
     def __init__(self, value: str) -> None: ...
 
 
+@t.final
+class LazyDocument:
+    def __init__(
+        self,
+        json: t.Union[str, _Buffer],
+        *,
+        number_mode: t.Optional[_NumberMode] = NM_NAN,
+        datetime_mode: t.Optional[_DatetimeMode] = DM_NONE,
+        uuid_mode: t.Optional[_UUIDMode] = UM_NONE,
+        parse_mode: t.Optional[_ParseMode] = PM_NONE,
+        allow_nan: t.Optional[bool] = True,
+    ) -> None: ...
+    def __getitem__(self, key: t.Union[str, int]) -> t.Any: ...
+    def __contains__(self, key: t.Any) -> bool: ...
+    def __eq__(self, other: object) -> bool: ...
+    def __iter__(self) -> t.Iterator[t.Any]: ...
+    def __len__(self) -> int: ...
+    def get(self, key: t.Union[str, int], default: t.Any = None) -> t.Any: ...
+    def keys(self) -> t.List[str]: ...
+    def resolve(self, pointer: str) -> t.Any: ...
+
+
 @t.final
 class Validator:
     def __init__(self, json_schema: t.Union[str, bytes, bytearray]) -> None: ...